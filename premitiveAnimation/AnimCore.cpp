@@ -0,0 +1,764 @@
+//-----------------------------------------------------------------------------
+// File: AnimCore.cpp
+//
+// Desc: C interface of the animation core (see AnimCore.h). The public types
+//       share their layout with the internal ones, so state is handed out
+//       without copying. A frame is built as a render graph:
+//
+//           clear -> stamps -> cubes -> pyramid levels -> thumbnail
+//                                    -> YUV conversion
+//
+//       The depth buffer, the pyramid levels and (when only YUV or the
+//       thumbnail is wanted) the color image are transient, so the depth
+//       buffer's memory is reused by the pyramid once the cubes are drawn.
+//
+//       With a logo cache, a frame of the hold whose stamps are those of
+//       the cached layer starts from a copy of the layer instead of a clear,
+//       and the stamps pass draws nothing. A baked distance field is used
+//       the same way and needs nothing per resolution, so it goes first.
+//
+//       The caller's steps advance a clock of their own; the animation time
+//       is taken from it through the play control, which the queued inputs
+//       change at the start of a step. The sound is placed on that clock
+//       too, so it keeps up with the frames the caller shows.
+//-----------------------------------------------------------------------------
+#define ANIMCORE_EXPORTS
+#include "AnimCore.h"
+#include "AnimSim.h"
+#include "AnimRaster.h"
+#include "RenderGraph.h"
+#include "YuvConvert.h"
+#include "MemStats.h"
+#include "LogoCache.h"
+#include "InputQueue.h"
+#include "AudioMix.h"
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+
+static_assert(ANIMCORE_TRACK_NUM == TRACK_NUM, "track count mismatch");
+static_assert(sizeof(ANIMCORE_TRACK) == sizeof(TRACKPARAM), "track layout mismatch");
+static_assert(sizeof(ANIMCORE_STAMP) == sizeof(ANIMSTAMP), "stamp layout mismatch");
+static_assert(sizeof(ANIMCORE_MATRIX) == sizeof(ANIMMATRIX), "matrix layout mismatch");
+static_assert(ANIMCORE_INPUT_SKIP == INPUT_SKIP && ANIMCORE_INPUT_RESTART == INPUT_RESTART &&
+	ANIMCORE_INPUT_PAUSE == INPUT_PAUSE && ANIMCORE_INPUT_SPEED == INPUT_SPEED, "input command mismatch");
+
+
+struct ANIMCORE
+{
+	ANIMSTATE state;
+	ANIMTICK clock;      // Aj[V̎ (state.time  ANIM_STEP_MS ݂Ȃ̂Œ[)
+	ANIMTICK wall;       // Step ɓnꂽԂ̍v
+	PLAYCONTROL play;    // wall  clock ߂
+	RENDERGRAPH graph;   // \tgEFA`̃pXƓr̃obt@
+	const MESH* pCube;   // `̃CX^X MeshCache ̓bVw
+	const MESH* pSquare;
+	bool gouraud;        // AnimCoreSetShading
+	unsigned long long drawUs;  // Ō̃t[Ŏlp`ƃL[u`
+
+	// S̑w (AnimCoreSetLogoCache)
+	bool layerEnabled;
+	char layerDir[1024];      // Ȃ烁ɂ
+	LOGOLAYER* pLayer;
+	uint64_t layerFailKey;    // ȂL[ (t[蒼Ȃ)
+	LOGOSDF* pSdf;            // AnimCoreSetLogoSdf
+
+	// state ̎lp`̃nbVB1 ̃[v̒ł͒uȂςȂ
+	bool holdHashed;
+	unsigned int holdLoop;
+	int holdStamps;
+	uint64_t holdHash;
+
+	//  (AnimCoreInjectInput)
+	INPUTQUEUE input;
+	INPUTFRAME inputFrame;   // fĂ܂`ĂȂ
+	INPUTSTATS inputStats;
+
+	//  (AnimCoreSetAudioWav)
+	AUDIOMIXER* pAudio;
+	ANIMTICK audioWall;  // WAV ̐擪 wall
+};
+
+// pXɓn 1 t[̏
+struct FRAMEPASS
+{
+	ANIMCORE* pCore;
+	const ANIMCORE_FRAME* pFrame;
+	const unsigned int* pLayer;  // NULL łȂΏ̑ɎʂĎlp`͕`Ȃ
+	const LOGOSDF* pSdf;         // ꂩ`
+	int color, colorPitch;  // colorPitch ̓sNZ
+	int depth;
+	int yuv;
+	int level[ANIMCORE_THUMB_LEVEL_MAX + 1];  // [0]  color, Ō thumb
+	int levelPitch[ANIMCORE_THUMB_LEVEL_MAX + 1];
+	int levelWidth[ANIMCORE_THUMB_LEVEL_MAX + 1];
+	int levelHeight[ANIMCORE_THUMB_LEVEL_MAX + 1];
+};
+
+struct LEVELPASS
+{
+	FRAMEPASS* pPass;
+	int level;  // i
+};
+
+
+
+
+int ANIMCORE_CALL AnimCoreGetVersion(void)
+{
+	return ANIMCORE_VERSION;
+}
+
+
+ANIMCORE* ANIMCORE_CALL AnimCoreCreate(const ANIMCORE_TRACK* pTracks)
+{
+	ANIMCORE* pCore = new (std::nothrow) ANIMCORE;
+	if (pCore == NULL)
+		return NULL;
+	MemStatAdd(MEMSYS_TRACKS, sizeof(ANIMCORE));
+
+	SCENEPARAM scene = g_defaultScene;
+	if (pTracks != NULL)
+		memcpy(scene.track, pTracks, sizeof(scene.track));
+	memset(&pCore->state, 0, sizeof(pCore->state));
+	if (!AnimInit(&pCore->state, &scene, 0)) {
+		MemStatAdd(MEMSYS_TRACKS, -(long long)sizeof(ANIMCORE));
+		delete pCore;
+		return NULL;
+	}
+	pCore->clock = 0;
+	pCore->wall = 0;
+	InitPlayControl(&pCore->play, 0, 0, 1.0);
+	InitInputQueue(&pCore->input);
+	memset(&pCore->inputFrame, 0, sizeof(pCore->inputFrame));
+	memset(&pCore->inputStats, 0, sizeof(pCore->inputStats));
+	pCore->pAudio = NULL;
+	pCore->audioWall = 0;
+	RenderGraphInit(&pCore->graph);
+	MESHKEY cube = DefaultMeshKey(MESH_CUBE), square = DefaultMeshKey(MESH_SQUARE);
+	pCore->pCube = AcquireMesh(&cube);
+	pCore->pSquare = AcquireMesh(&square);
+	pCore->gouraud = false;
+	pCore->drawUs = 0;
+	pCore->layerEnabled = false;
+	pCore->layerDir[0] = '\0';
+	pCore->pLayer = NULL;
+	pCore->layerFailKey = 0;
+	pCore->pSdf = NULL;
+	pCore->holdHashed = false;
+	return pCore;
+}
+
+
+void ANIMCORE_CALL AnimCoreDestroy(ANIMCORE* pCore)
+{
+	if (pCore == NULL)
+		return;
+	CloseAudio(pCore->pAudio);
+	RenderGraphFree(&pCore->graph);
+	CloseLogoLayer(pCore->pLayer);
+	CloseLogoSdf(pCore->pSdf);
+	ReleaseMesh(pCore->pCube);
+	ReleaseMesh(pCore->pSquare);
+	AnimFree(&pCore->state);
+	MemStatAdd(MEMSYS_TRACKS, -(long long)sizeof(ANIMCORE));
+	delete pCore;
+}
+
+
+
+
+int ANIMCORE_CALL AnimCoreSetScene(ANIMCORE* pCore, const ANIMCORE_TRACK* pTracks)
+{
+	if (pCore == NULL || pTracks == NULL)
+		return ANIMCORE_E_INVALIDARG;
+
+	//S̕ו͍̂܂
+	SCENEPARAM scene = pCore->state.scene;
+	memcpy(scene.track, pTracks, sizeof(scene.track));
+	AnimApplyScene(&pCore->state, &scene);
+	return ANIMCORE_OK;
+}
+
+
+int ANIMCORE_CALL AnimCoreLoadScene(ANIMCORE* pCore, const char* pPath)
+{
+	if (pCore == NULL || pPath == NULL)
+		return ANIMCORE_E_INVALIDARG;
+
+	//ĂȂL[͊l
+	SCENEPARAM scene = g_defaultScene;
+	if (!LoadSceneUtf8(pPath, &scene))
+		return ANIMCORE_E_FILE;
+	AnimApplyScene(&pCore->state, &scene);
+	//וςȂΑÕV[̂܂
+	const SCENEPARAM* pNow = &pCore->state.scene;
+	if (pNow->cols != scene.cols || pNow->rows != scene.rows || pNow->dx != scene.dx || pNow->dy != scene.dy)
+		return ANIMCORE_E_OUTOFMEMORY;
+	return ANIMCORE_OK;
+}
+
+
+
+
+int ANIMCORE_CALL AnimCoreSetMeshStyle(ANIMCORE* pCore, float size, float bevel, int subdiv)
+{
+	if (pCore == NULL || !(size > 0) || !(bevel >= 0) || subdiv < 1)
+		return ANIMCORE_E_INVALIDARG;
+
+	//V`ɎĂÂ𗣂 (`Ȃ蒼Ȃ)
+	MESHKEY cube = { MESH_CUBE, size, bevel, subdiv };
+	MESHKEY square = { MESH_SQUARE, size, 0, 1 };
+	const MESH* pCube = AcquireMesh(&cube);
+	const MESH* pSquare = AcquireMesh(&square);
+	if (pCube == NULL || pSquare == NULL) {
+		ReleaseMesh(pCube);
+		ReleaseMesh(pSquare);
+		return ANIMCORE_E_OUTOFMEMORY;
+	}
+	ReleaseMesh(pCore->pCube);
+	ReleaseMesh(pCore->pSquare);
+	pCore->pCube = pCube;
+	pCore->pSquare = pSquare;
+	return ANIMCORE_OK;
+}
+
+
+
+
+int ANIMCORE_CALL AnimCoreSetShading(ANIMCORE* pCore, int gouraud)
+{
+	if (pCore == NULL)
+		return ANIMCORE_E_INVALIDARG;
+	pCore->gouraud = gouraud != 0;
+	return ANIMCORE_OK;
+}
+
+
+
+
+int ANIMCORE_CALL AnimCoreSetLogoCache(ANIMCORE* pCore, const char* pDir)
+{
+	if (pCore == NULL || (pDir != NULL && strlen(pDir) >= sizeof(pCore->layerDir)))
+		return ANIMCORE_E_INVALIDARG;
+	CloseLogoLayer(pCore->pLayer);
+	pCore->pLayer = NULL;
+	pCore->layerFailKey = 0;
+	pCore->layerEnabled = (pDir != NULL);
+	const char* pSrc = pDir != NULL ? pDir : "";
+	memcpy(pCore->layerDir, pSrc, strlen(pSrc) + 1);
+	return ANIMCORE_OK;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: CoreLayer()
+// Desc: The layer of the current scene, style and size, opened or baked on
+//       first use. A key that could not be baked is not tried again.
+//-----------------------------------------------------------------------------
+static const LOGOLAYER* CoreLayer(ANIMCORE* pCore, int width, int height)
+{
+	uint64_t key = LogoLayerKey(&pCore->state.scene, pCore->pCube, pCore->pSquare, width, height);
+	if (pCore->pLayer != NULL && LogoLayerHeader(pCore->pLayer)->key == key)
+		return pCore->pLayer;
+	if (key == pCore->layerFailKey)
+		return NULL;
+
+	CloseLogoLayer(pCore->pLayer);
+	pCore->pLayer = OpenLogoLayer(pCore->layerDir[0] != '\0' ? pCore->layerDir : NULL,
+		&pCore->state.scene, pCore->pCube, pCore->pSquare, width, height);
+	if (pCore->pLayer == NULL)
+		pCore->layerFailKey = key;
+	return pCore->pLayer;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: CoreSdf()
+// Desc: The distance field if it was baked for the current scene and style
+//-----------------------------------------------------------------------------
+static const LOGOSDF* CoreSdf(const ANIMCORE* pCore)
+{
+	if (pCore->pSdf == NULL)
+		return NULL;
+	const LOGOSDFHEADER* h = LogoSdfHeader(pCore->pSdf);
+	if (h->key != LogoSdfKey(&pCore->state.scene, pCore->pSquare, h->width, h->height))
+		return NULL;
+	return pCore->pSdf;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: HoldMatches()
+// Desc: Whether the state is in the hold with exactly the stamps of a fresh
+//       run. The stamps do not change within a loop, so they are hashed once.
+//-----------------------------------------------------------------------------
+static bool HoldMatches(ANIMCORE* pCore, uint32_t stampCount, uint64_t stampHash)
+{
+	const ANIMSTATE* a = &pCore->state;
+	if (!a->endGet || a->cubeCount != 0 || (uint32_t)a->stampCount != stampCount)
+		return false;
+	if (!pCore->holdHashed || pCore->holdLoop != a->loopCount || pCore->holdStamps != a->stampCount) {
+		pCore->holdHash = LogoStampHash(a);
+		pCore->holdHashed = true;
+		pCore->holdLoop = a->loopCount;
+		pCore->holdStamps = a->stampCount;
+	}
+	return pCore->holdHash == stampHash;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: HoldLayer(), HoldSdf()
+// Desc: The cached logo when the state shows exactly that picture
+//-----------------------------------------------------------------------------
+static const unsigned int* HoldLayer(ANIMCORE* pCore, int width, int height)
+{
+	if (!pCore->layerEnabled || !pCore->state.endGet || pCore->state.cubeCount != 0)
+		return NULL;
+	const LOGOLAYER* pLayer = CoreLayer(pCore, width, height);
+	if (pLayer == NULL)
+		return NULL;
+	const LOGOLAYERHEADER* h = LogoLayerHeader(pLayer);
+	return HoldMatches(pCore, h->stampCount, h->stampHash) ? LogoLayerPixels(pLayer) : NULL;
+}
+
+
+static const LOGOSDF* HoldSdf(ANIMCORE* pCore)
+{
+	const LOGOSDF* pSdf = CoreSdf(pCore);
+	if (pSdf == NULL)
+		return NULL;
+	const LOGOSDFHEADER* h = LogoSdfHeader(pSdf);
+	return HoldMatches(pCore, h->stampCount, h->stampHash) ? pSdf : NULL;
+}
+
+
+
+
+int ANIMCORE_CALL AnimCoreSetLogoSdf(ANIMCORE* pCore, int width, int height)
+{
+	if (pCore == NULL || width < 0 || height < 0 || (width == 0) != (height == 0) ||
+		width > ANIMCORE_SDF_SIZE_MAX || height > ANIMCORE_SDF_SIZE_MAX)
+		return ANIMCORE_E_INVALIDARG;
+	CloseLogoSdf(pCore->pSdf);
+	pCore->pSdf = NULL;
+	if (width == 0)
+		return ANIMCORE_OK;
+
+	const char* pDir = (pCore->layerEnabled && pCore->layerDir[0] != '\0') ? pCore->layerDir : NULL;
+	pCore->pSdf = OpenLogoSdf(pDir, &pCore->state.scene, pCore->pSquare, width, height);
+	return pCore->pSdf != NULL ? ANIMCORE_OK : ANIMCORE_E_OUTOFMEMORY;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: CoreStep()
+// Desc: Applies the queued inputs at the current clock, then advances. A
+//       restart may leave the state behind clock; AnimUpdate catches up.
+//       The events of the step are scheduled for the sound at its wall time.
+//-----------------------------------------------------------------------------
+static void CoreStep(ANIMCORE* pCore, unsigned int dtMs)
+{
+	DrainInput(&pCore->input, &pCore->play, &pCore->state, pCore->wall, &pCore->inputFrame);
+	pCore->wall += dtMs;
+	pCore->clock = PlayControlTime(&pCore->play, pCore->wall);
+	AnimUpdate(&pCore->state, pCore->clock);
+	if (pCore->pAudio != NULL)
+		ScheduleAudio(pCore->pAudio, &pCore->state, pCore->clock, (double)(pCore->wall - pCore->audioWall));
+}
+
+
+int ANIMCORE_CALL AnimCoreStep(ANIMCORE* pCore, unsigned int dtMs)
+{
+	if (pCore == NULL)
+		return ANIMCORE_E_INVALIDARG;
+	CoreStep(pCore, dtMs);
+	return ANIMCORE_OK;
+}
+
+
+int ANIMCORE_CALL AnimCoreStepMany(ANIMCORE* const* ppCores, int count, unsigned int dtMs)
+{
+	if (ppCores == NULL || count < 0)
+		return ANIMCORE_E_INVALIDARG;
+	for (int i = 0; i < count; i++) {
+		if (ppCores[i] != NULL)
+			CoreStep(ppCores[i], dtMs);
+	}
+	return ANIMCORE_OK;
+}
+
+
+int ANIMCORE_CALL AnimCoreSeek(ANIMCORE* pCore, unsigned int timeMs)
+{
+	return AnimCoreSeek64(pCore, timeMs);
+}
+
+
+int ANIMCORE_CALL AnimCoreSeek64(ANIMCORE* pCore, unsigned long long timeMs)
+{
+	if (pCore == NULL)
+		return ANIMCORE_E_INVALIDARG;
+	pCore->clock = timeMs;
+	pCore->play.base = timeMs;
+	pCore->play.baseClock = pCore->wall;
+	if (!AnimSeek(&pCore->state, timeMs))
+		return ANIMCORE_E_OUTOFMEMORY;
+	//΂Ԃ̎lp`͖炳Ȃ
+	if (pCore->pAudio != NULL)
+		SyncAudio(pCore->pAudio, &pCore->state, pCore->clock, (double)(pCore->wall - pCore->audioWall));
+	return ANIMCORE_OK;
+}
+
+
+unsigned int ANIMCORE_CALL AnimCoreGetTime(const ANIMCORE* pCore)
+{
+	return pCore != NULL ? (unsigned int)pCore->clock : 0;
+}
+
+
+unsigned long long ANIMCORE_CALL AnimCoreGetTime64(const ANIMCORE* pCore)
+{
+	return pCore != NULL ? pCore->clock : 0;
+}
+
+
+
+
+int ANIMCORE_CALL AnimCoreGetStamps(const ANIMCORE* pCore, const ANIMCORE_STAMP** ppStamps)
+{
+	if (pCore == NULL || ppStamps == NULL)
+		return ANIMCORE_E_INVALIDARG;
+	*ppStamps = (const ANIMCORE_STAMP*)pCore->state.stamp;
+	return pCore->state.stampCount;
+}
+
+
+int ANIMCORE_CALL AnimCoreGetCubes(const ANIMCORE* pCore, const ANIMCORE_MATRIX** ppCubes)
+{
+	if (pCore == NULL || ppCubes == NULL)
+		return ANIMCORE_E_INVALIDARG;
+	*ppCubes = (const ANIMCORE_MATRIX*)pCore->state.cube;
+	return pCore->state.cubeCount;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: Pass*()
+// Desc: The passes of a frame (see AnimCoreRenderFrame)
+//-----------------------------------------------------------------------------
+static RASTERTARGET FrameTarget(RENDERGRAPH* g, const FRAMEPASS* f)
+{
+	RASTERTARGET target;
+	target.pColor = (unsigned int*)RenderGraphGet(g, f->color);
+	target.pitch = f->colorPitch;
+	target.pDepth = (float*)RenderGraphGet(g, f->depth);
+	target.width = f->pFrame->width;
+	target.height = f->pFrame->height;
+	target.gouraud = f->pCore->gouraud;  //L[u̖ʂ͕Ȃ̂ŕi 1 Fő
+	target.pCube = f->pCore->pCube;
+	target.pSquare = f->pCore->pSquare;
+	return target;
+}
+
+static void PassClear(RENDERGRAPH* g, void* pContext)
+{
+	FRAMEPASS* f = (FRAMEPASS*)pContext;
+	RASTERTARGET target = FrameTarget(g, f);
+	bool drawn = false;
+	if (f->pSdf != NULL)
+		drawn = DrawLogoSdf(f->pSdf, target.pColor, target.pitch, target.width, target.height);
+	else if (f->pLayer != NULL) {
+		for (int y = 0; y < target.height; y++)
+			memcpy(target.pColor + (size_t)y * target.pitch, f->pLayer + (size_t)y * target.width, target.width * 4);
+		drawn = true;
+	}
+	//`ȂΕʂɏĎlp``
+	if (!drawn) {
+		f->pSdf = NULL;
+		f->pLayer = NULL;
+		RasterClear(&target);
+		return;
+	}
+	for (int y = 0; y < target.height; y++) {
+		float* pDepth = target.pDepth + (size_t)y * target.width;
+		for (int x = 0; x < target.width; x++)
+			pDepth[x] = 1.0f;
+	}
+}
+
+static void PassStamps(RENDERGRAPH* g, void* pContext)
+{
+	FRAMEPASS* f = (FRAMEPASS*)pContext;
+	if (f->pLayer != NULL || f->pSdf != NULL)
+		return;
+	RASTERTARGET target = FrameTarget(g, f);
+	unsigned long long start = InputClockUs();
+	RasterDrawStamps(&f->pCore->state, &target);
+	f->pCore->drawUs += InputClockUs() - start;
+}
+
+static void PassCubes(RENDERGRAPH* g, void* pContext)
+{
+	FRAMEPASS* f = (FRAMEPASS*)pContext;
+	RASTERTARGET target = FrameTarget(g, f);
+	unsigned long long start = InputClockUs();
+	RasterDrawCubes(&f->pCore->state, &target);
+	f->pCore->drawUs += InputClockUs() - start;
+}
+
+static void PassPyramid(RENDERGRAPH* g, void* pContext)
+{
+	const LEVELPASS* l = (const LEVELPASS*)pContext;
+	const FRAMEPASS* f = l->pPass;
+	int src = l->level - 1;
+	RasterHalve((const unsigned int*)RenderGraphGet(g, f->level[src]), f->levelPitch[src],
+		f->levelWidth[src], f->levelHeight[src],
+		(unsigned int*)RenderGraphGet(g, f->level[l->level]), f->levelPitch[l->level]);
+}
+
+static void PassYUV(RENDERGRAPH* g, void* pContext)
+{
+	const FRAMEPASS* f = (const FRAMEPASS*)pContext;
+	const ANIMCORE_FRAME* p = f->pFrame;
+	YUV420FRAME dst = { p->pY, p->pU, p->pV, p->width, p->height, p->pitchY, p->pitchUV };
+	ConvertTileToYUV420((const unsigned char*)RenderGraphGet(g, f->color), f->colorPitch * 4,
+		0, 0, p->width, p->height, &dst);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimCoreRenderFrame()
+// Desc: Declares the frame as a render graph and runs it. An output that is
+//       not requested becomes a transient buffer that nobody reads, so
+//       RenderGraphCompile drops the passes leading to it and gives it no
+//       memory. The pyramid has as many levels as the thumbnail asks for.
+//-----------------------------------------------------------------------------
+int ANIMCORE_CALL AnimCoreRenderFrame(ANIMCORE* pCore, const ANIMCORE_FRAME* pFrame)
+{
+	if (pCore == NULL || pFrame == NULL || pFrame->width <= 0 || pFrame->height <= 0)
+		return ANIMCORE_E_INVALIDARG;
+	const ANIMCORE_FRAME* p = pFrame;
+	if (p->pColor != NULL && (p->colorPitch < p->width * 4 || (p->colorPitch & 3) != 0))
+		return ANIMCORE_E_INVALIDARG;
+	if (p->pY != NULL && (p->pU == NULL || p->pV == NULL ||
+		p->pitchY < p->width || p->pitchUV < (p->width + 1) / 2))
+		return ANIMCORE_E_INVALIDARG;
+	int levels = p->pThumb != NULL ? p->thumbLevel : 0;
+	if (p->pThumb != NULL && (levels < 1 || levels > ANIMCORE_THUMB_LEVEL_MAX || (p->thumbPitch & 3) != 0))
+		return ANIMCORE_E_INVALIDARG;
+
+	FRAMEPASS f;
+	LEVELPASS level[ANIMCORE_THUMB_LEVEL_MAX + 1];
+	RENDERGRAPH* g = &pCore->graph;
+	size_t pixels = (size_t)p->width * p->height;
+	f.pCore = pCore;
+	f.pFrame = p;
+	f.pSdf = HoldSdf(pCore);
+	f.pLayer = f.pSdf == NULL ? HoldLayer(pCore, p->width, p->height) : NULL;
+	RenderGraphReset(g);
+
+	//`GԂȂƂ͓r̃obt@ɂ
+	if (p->pColor != NULL) {
+		f.color = RenderGraphImport(g, "color", p->pColor);
+		f.colorPitch = p->colorPitch / 4;
+	}
+	else {
+		f.color = RenderGraphCreate(g, "color", pixels * 4);
+		f.colorPitch = p->width;
+	}
+	f.depth = RenderGraphCreate(g, "depth", pixels * sizeof(float));
+	if (p->pY != NULL)
+		f.yuv = RenderGraphImport(g, "yuv", p->pY);
+	else
+		f.yuv = RenderGraphCreate(g, "yuv", pixels * 3 / 2);
+
+	f.level[0] = f.color;
+	f.levelPitch[0] = f.colorPitch;
+	f.levelWidth[0] = p->width;
+	f.levelHeight[0] = p->height;
+	for (int i = 1; i <= levels; i++) {
+		f.levelWidth[i] = (f.levelWidth[i - 1] + 1) / 2;
+		f.levelHeight[i] = (f.levelHeight[i - 1] + 1) / 2;
+		if (i == levels) {
+			if (p->thumbPitch < f.levelWidth[i] * 4)
+				return ANIMCORE_E_INVALIDARG;
+			f.level[i] = RenderGraphImport(g, "thumb", p->pThumb);
+			f.levelPitch[i] = p->thumbPitch / 4;
+		}
+		else {
+			f.level[i] = RenderGraphCreate(g, "pyramid", (size_t)f.levelWidth[i] * f.levelHeight[i] * 4);
+			f.levelPitch[i] = f.levelWidth[i];
+		}
+	}
+
+	unsigned int color = RG_BIT(f.color), depth = RG_BIT(f.depth);
+	RenderGraphAddPass(g, "clear", 0, color | depth, PassClear, &f);
+	RenderGraphAddPass(g, "stamps", color | depth, color | depth, PassStamps, &f);
+	RenderGraphAddPass(g, "cubes", color | depth, color | depth, PassCubes, &f);
+	for (int i = 1; i <= levels; i++) {
+		level[i].pPass = &f;
+		level[i].level = i;
+		RenderGraphAddPass(g, "pyramid", RG_BIT(f.level[i - 1]), RG_BIT(f.level[i]), PassPyramid, &level[i]);
+	}
+	RenderGraphAddPass(g, "yuv", color, RG_BIT(f.yuv), PassYUV, &f);
+
+	if (!RenderGraphCompile(g))
+		return ANIMCORE_E_OUTOFMEMORY;
+	pCore->drawUs = 0;
+	RenderGraphExecute(g);
+	RecordInputLatency(&pCore->inputStats, &pCore->inputFrame, InputClockUs());
+	return ANIMCORE_OK;
+}
+
+
+int ANIMCORE_CALL AnimCoreGetRenderStats(const ANIMCORE* pCore, ANIMCORE_RENDERSTATS* pStats)
+{
+	if (pCore == NULL || pStats == NULL)
+		return ANIMCORE_E_INVALIDARG;
+	pStats->passCount = pCore->graph.passCount;
+	pStats->culledCount = pCore->graph.culledCount;
+	pStats->transientBytes = pCore->graph.transientBytes;
+	pStats->heapBytes = pCore->graph.heapUsed;
+	pStats->drawMs = pCore->drawUs / 1000.0;
+	return ANIMCORE_OK;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimCoreRender()
+// Desc: Draws the current state into the caller's buffer, i.e. a frame with
+//       only the color output
+//-----------------------------------------------------------------------------
+int ANIMCORE_CALL AnimCoreRender(ANIMCORE* pCore, const ANIMCORE_BUFFER* pBuffer)
+{
+	if (pCore == NULL || pBuffer == NULL || pBuffer->pPixels == NULL)
+		return ANIMCORE_E_INVALIDARG;
+
+	ANIMCORE_FRAME frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.width = pBuffer->width;
+	frame.height = pBuffer->height;
+	frame.pColor = pBuffer->pPixels;
+	frame.colorPitch = pBuffer->pitch;
+	return AnimCoreRenderFrame(pCore, &frame);
+}
+
+
+int ANIMCORE_CALL AnimCoreRenderMany(ANIMCORE* const* ppCores, const ANIMCORE_BUFFER* pBuffers, int count)
+{
+	if (ppCores == NULL || pBuffers == NULL || count < 0)
+		return ANIMCORE_E_INVALIDARG;
+	for (int i = 0; i < count; i++) {
+		int hr = AnimCoreRender(ppCores[i], &pBuffers[i]);
+		if (hr != ANIMCORE_OK)
+			return hr;
+	}
+	return ANIMCORE_OK;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimCoreRenderFinal()
+// Desc: Draws the finished logo of the current scene without touching the
+//       animation, from the distance field if one was baked for it and
+//       otherwise from the layer of this size
+//-----------------------------------------------------------------------------
+int ANIMCORE_CALL AnimCoreRenderFinal(ANIMCORE* pCore, const ANIMCORE_BUFFER* pBuffer)
+{
+	if (pCore == NULL || pBuffer == NULL || pBuffer->pPixels == NULL ||
+		pBuffer->width <= 0 || pBuffer->height <= 0 ||
+		pBuffer->pitch < pBuffer->width * 4 || (pBuffer->pitch & 3) != 0)
+		return ANIMCORE_E_INVALIDARG;
+	const LOGOSDF* pSdf = CoreSdf(pCore);
+	if (pSdf != NULL && DrawLogoSdf(pSdf, (unsigned int*)pBuffer->pPixels, pBuffer->pitch / 4, pBuffer->width, pBuffer->height))
+		return ANIMCORE_OK;
+
+	const LOGOLAYER* pLayer = CoreLayer(pCore, pBuffer->width, pBuffer->height);
+	if (pLayer == NULL)
+		return ANIMCORE_E_OUTOFMEMORY;
+
+	const unsigned int* pSrc = LogoLayerPixels(pLayer);
+	for (int y = 0; y < pBuffer->height; y++)
+		memcpy((unsigned char*)pBuffer->pPixels + (size_t)y * pBuffer->pitch,
+			pSrc + (size_t)y * pBuffer->width, pBuffer->width * 4);
+	return ANIMCORE_OK;
+}
+
+
+
+
+int ANIMCORE_CALL AnimCoreInjectInput(ANIMCORE* pCore, int command, float value)
+{
+	if (pCore == NULL || command < 0 || command >= INPUT_COMMAND_NUM)
+		return ANIMCORE_E_INVALIDARG;
+	return PushInput(&pCore->input, command, value) ? ANIMCORE_OK : ANIMCORE_E_FULL;
+}
+
+
+int ANIMCORE_CALL AnimCoreGetInputStats(const ANIMCORE* pCore, ANIMCORE_INPUTSTATS* pStats)
+{
+	if (pCore == NULL || pStats == NULL)
+		return ANIMCORE_E_INVALIDARG;
+	const INPUTSTATS* s = &pCore->inputStats;
+	pStats->count = s->count;
+	pStats->dropped = pCore->input.dropped.load(std::memory_order_relaxed);
+	pStats->latencyAvgMs = s->count > 0 ? s->sumUs / 1000.0 / s->count : 0.0;
+	pStats->latencyMaxMs = s->maxUs / 1000.0;
+	return ANIMCORE_OK;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimCoreSetAudioWav()
+// Desc: Closes the previous file, if any, after mixing it to the last step.
+//       The new file starts at the current state, which is not sounded.
+//-----------------------------------------------------------------------------
+int ANIMCORE_CALL AnimCoreSetAudioWav(ANIMCORE* pCore, const char* pPath)
+{
+	if (pCore == NULL)
+		return ANIMCORE_E_INVALIDARG;
+	CloseAudio(pCore->pAudio);
+	pCore->pAudio = NULL;
+	if (pPath == NULL)
+		return ANIMCORE_OK;
+
+	pCore->pAudio = OpenAudioWav(pPath, ANIMCORE_AUDIO_RATE);
+	if (pCore->pAudio == NULL)
+		return ANIMCORE_E_FILE;
+	pCore->audioWall = pCore->wall;
+	SyncAudio(pCore->pAudio, &pCore->state, pCore->clock, 0);
+	return ANIMCORE_OK;
+}
+
+
+int ANIMCORE_CALL AnimCoreGetAudioStats(const ANIMCORE* pCore, ANIMCORE_AUDIOSTATS* pStats)
+{
+	if (pCore == NULL || pStats == NULL)
+		return ANIMCORE_E_INVALIDARG;
+	AUDIOSTATS stats = {};
+	if (pCore->pAudio != NULL)
+		GetAudioStats(pCore->pAudio, &stats);
+	pStats->cues = stats.cues;
+	pStats->dropped = stats.dropped;
+	pStats->samples = stats.samples;
+	return ANIMCORE_OK;
+}
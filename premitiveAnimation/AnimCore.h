@@ -0,0 +1,221 @@
+//-----------------------------------------------------------------------------
+// File: AnimCore.h
+//
+// Desc: C interface of the headless animation core (AnimCore.dll). An
+//       instance holds one logo animation. It is advanced by explicit time
+//       steps and can be drawn by the software rasterizer directly into a
+//       buffer owned by the caller. Instances are independent of each other,
+//       so different instances may be used from different threads at once.
+//       This header is plain C.
+//
+//       AnimCoreRenderFrame produces any combination of the color image, an
+//       I420 copy and a downscaled thumbnail in one call. Stages for outputs
+//       that are not requested are skipped and cost no memory.
+//
+//       AnimCoreSetMeshStyle changes the size and shape of the cubes and
+//       squares. Instances with the same style share one set of vertices.
+//
+//       AnimCoreSetLogoCache keeps the finished logo per scene, style and
+//       size in memory-mapped files. AnimCoreRenderFinal then shows it
+//       without simulating, and frames of the hold copy it instead of
+//       drawing every square. AnimCoreSetLogoSdf bakes the squares once into
+//       a distance field that serves every output size (and aspect ratio
+//       up to the one it was baked for).
+//
+//       AnimCoreInjectInput queues an operator control (skip, restart,
+//       pause, speed). It is the one call that may come from another thread
+//       while the instance is in use; the next AnimCoreStep applies what is
+//       queued before it advances, and AnimCoreGetInputStats reports the
+//       time from the call to the end of the frame that showed it.
+//
+//       AnimCoreSetAudioWav writes the sound of the animation (a click per
+//       square, a chime per track, a chord for the logo) to a WAV file,
+//       each cue at the sample of the step it happened in. The file is
+//       mixed on a thread of its own and is complete when it is closed.
+//-----------------------------------------------------------------------------
+#ifndef ANIMCORE_H
+#define ANIMCORE_H
+
+#if defined(_WIN32)
+#if defined(ANIMCORE_EXPORTS)
+#define ANIMCORE_API __declspec(dllexport)
+#elif defined(ANIMCORE_STATIC)
+#define ANIMCORE_API
+#else
+#define ANIMCORE_API __declspec(dllimport)
+#endif
+#define ANIMCORE_CALL __cdecl
+#else
+#define ANIMCORE_API __attribute__((visibility("default")))
+#define ANIMCORE_CALL
+#endif
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define ANIMCORE_VERSION 9
+
+// ߂l
+#define ANIMCORE_OK             0
+#define ANIMCORE_E_INVALIDARG   (-1)
+#define ANIMCORE_E_OUTOFMEMORY  (-2)
+#define ANIMCORE_E_FILE         (-3)
+#define ANIMCORE_E_FULL         (-4)  // ͂̃L[t
+
+//  (AnimCoreInjectInput)
+#define ANIMCORE_INPUT_SKIP     0  // ĂԂȂ烍S܂, ƂȂŏɖ߂܂Ői߂
+#define ANIMCORE_INPUT_RESTART  1  // ŏ蒼
+#define ANIMCORE_INPUT_PAUSE    2  // ꎞ~ƍĊJ؂ւ
+#define ANIMCORE_INPUT_SPEED    3  // Đx value {ɂ (0 .. 64)
+
+// gbN̕ (scene.txt Ɠ): I1 I2 I3 K1 K2 K3 E1 E234 P1 P2
+#define ANIMCORE_TRACK_NUM 10
+
+typedef struct ANIMCORE ANIMCORE;
+
+typedef struct ANIMCORE_TRACK
+{
+	float x, y;    // Jnʒu
+	float end;     // ~W
+	float speed;   // ړx [/s]
+	float radius;  // P2 ̉~ʂ̔a
+} ANIMCORE_TRACK;
+
+typedef struct ANIMCORE_STAMP
+{
+	float x, y;
+	float angle;   // Z ܂̉]
+} ANIMCORE_STAMP;
+
+// D3DMATRIX Ɠ (sxNg)
+typedef struct ANIMCORE_MATRIX
+{
+	float m[4][4];
+} ANIMCORE_MATRIX;
+
+// `BX8R8G8B8, pitch  1 s̃oCg (4 ̔{)
+typedef struct ANIMCORE_BUFFER
+{
+	void* pPixels;
+	int width;
+	int height;
+	int pitch;
+} ANIMCORE_BUFFER;
+
+#define ANIMCORE_THUMB_LEVEL_MAX 8
+#define ANIMCORE_SDF_SIZE_MAX 4096
+
+// 1 t[̏o͐BvȂo͂ NULL ɂ (̒i͎sȂ)
+typedef struct ANIMCORE_FRAME
+{
+	int width;
+	int height;
+	void* pColor;          // X8R8G8B8
+	int colorPitch;        // oCg
+	unsigned char* pY;     // I420 (BT.601 limited range)BU, V  (width + 1) / 2 x (height + 1) / 2
+	unsigned char* pU;
+	unsigned char* pV;
+	int pitchY;
+	int pitchUV;
+	void* pThumb;          // X8R8G8B8 ̏k摜B傫 width, height  thumbLevel  (n + 1) / 2 
+	int thumbPitch;
+	int thumbLevel;        // 1 .. ANIMCORE_THUMB_LEVEL_MAX
+} ANIMCORE_FRAME;
+
+// Ō AnimCoreRenderFrame ̓
+typedef struct ANIMCORE_RENDERSTATS
+{
+	int passCount;
+	int culledCount;        // o͂ɓ͂Ȃ̂ŎsȂpX
+	size_t transientBytes;  // r̃obt@̍v
+	size_t heapBytes;       // dȂȂobt@d˂Ƃ̑傫
+	double drawMs;          // lp`ƃL[u`
+} ANIMCORE_RENDERSTATS;
+
+// ͂, 𔽉ft[`I܂
+typedef struct ANIMCORE_INPUTSTATS
+{
+	unsigned int count;     // `܂œ͂
+	unsigned int dropped;   // L[tŎ̂Ă
+	double latencyAvgMs;
+	double latencyMaxMs;
+} ANIMCORE_INPUTSTATS;
+
+#define ANIMCORE_AUDIO_RATE 48000
+
+typedef struct ANIMCORE_AUDIOSTATS
+{
+	unsigned int cues;           // 炵
+	unsigned int dropped;        // ɖ鉹Ď̂Ă
+	unsigned long long samples;  // ot[ (XeI 16bit)
+} ANIMCORE_AUDIOSTATS;
+
+
+ANIMCORE_API int ANIMCORE_CALL AnimCoreGetVersion(void);
+
+// pTracks  NULL Ȃ̃V[B 0 n܂
+ANIMCORE_API ANIMCORE* ANIMCORE_CALL AnimCoreCreate(const ANIMCORE_TRACK* pTracks);
+ANIMCORE_API void ANIMCORE_CALL AnimCoreDestroy(ANIMCORE* pCore);
+
+// ςgbN蒼BpPath  UTF-8 ̃V[t@CB
+// V[t@C grid ŃSׂ (ׂSׂ͂ pTracks ̃p[^œ)
+ANIMCORE_API int ANIMCORE_CALL AnimCoreSetScene(ANIMCORE* pCore, const ANIMCORE_TRACK* pTracks);
+ANIMCORE_API int ANIMCORE_CALL AnimCoreLoadScene(ANIMCORE* pCore, const char* pPath);
+
+// L[ȗ傫 (ӂ̔,  0.1), ӂ̊ۂ, 1 ӂ̕ (3 ȏŊۂ߂)B
+// ̃L[u͕炵`ŕ`
+ANIMCORE_API int ANIMCORE_CALL AnimCoreSetMeshStyle(ANIMCORE* pCore, float size, float bevel, int subdiv);
+// 0 () ȂOp`Ƃ 1 Fœh, 1 Ȃ璸_̐FԂB
+// ʂ͂قړȂ̂, AnimCoreGetRenderStats  drawMs őׂ邽߂̂
+ANIMCORE_API int ANIMCORE_CALL AnimCoreSetShading(ANIMCORE* pCore, int gouraud);
+
+// S pDir (UTF-8) ̃t@CɏĂĂ, ͎ʑĎgB
+// "" Ȃt@Cɒuɂ, NULL ȂgȂ ()
+ANIMCORE_API int ANIMCORE_CALL AnimCoreSetLogoCache(ANIMCORE* pCore, const char* pDir);
+// ̃V[ƌ`őS̋ width x height (c͏o͂ɍ킹) ŏĂB0, 0 ŊOB
+// SLbVΓfBNgɒuBV[`ςĂ
+ANIMCORE_API int ANIMCORE_CALL AnimCoreSetLogoSdf(ANIMCORE* pCore, int width, int height);
+
+// ł 5ms ݂Őiނ̂, dtMs ̕ɂ炸ʂ͓
+ANIMCORE_API int ANIMCORE_CALL AnimCoreStep(ANIMCORE* pCore, unsigned int dtMs);
+ANIMCORE_API int ANIMCORE_CALL AnimCoreStepMany(ANIMCORE* const* ppCores, int count, unsigned int dtMs);
+//  timeMs ̏Ԃ, ܂ł̃t[ǂ킸ɍ (܂ Step ̂Ɠ)
+ANIMCORE_API int ANIMCORE_CALL AnimCoreSeek(ANIMCORE* pCore, unsigned int timeMs);
+ANIMCORE_API int ANIMCORE_CALL AnimCoreSeek64(ANIMCORE* pCore, unsigned long long timeMs);
+// ͓ł 64bitBAnimCoreGetTime ͉ 32bit (49.7 ň)
+ANIMCORE_API unsigned int ANIMCORE_CALL AnimCoreGetTime(const ANIMCORE* pCore);
+ANIMCORE_API unsigned long long ANIMCORE_CALL AnimCoreGetTime64(const ANIMCORE* pCore);
+
+// ̔zw|C^Ԃ ( Step ܂ŗL)B߂l͌
+ANIMCORE_API int ANIMCORE_CALL AnimCoreGetStamps(const ANIMCORE* pCore, const ANIMCORE_STAMP** ppStamps);
+ANIMCORE_API int ANIMCORE_CALL AnimCoreGetCubes(const ANIMCORE* pCore, const ANIMCORE_MATRIX** ppCubes);
+
+// Ăяõobt@ɒڕ`
+ANIMCORE_API int ANIMCORE_CALL AnimCoreRender(ANIMCORE* pCore, const ANIMCORE_BUFFER* pBuffer);
+ANIMCORE_API int ANIMCORE_CALL AnimCoreRenderMany(ANIMCORE* const* ppCores, const ANIMCORE_BUFFER* pBuffers, int count);
+ANIMCORE_API int ANIMCORE_CALL AnimCoreRenderFrame(ANIMCORE* pCore, const ANIMCORE_FRAME* pFrame);
+// ̃V[̑S` (Aj[V̏Ԃ͕ςȂ)
+ANIMCORE_API int ANIMCORE_CALL AnimCoreRenderFinal(ANIMCORE* pCore, const ANIMCORE_BUFFER* pBuffer);
+ANIMCORE_API int ANIMCORE_CALL AnimCoreGetRenderStats(const ANIMCORE* pCore, ANIMCORE_RENDERSTATS* pStats);
+
+// tăL[ɓ (ǂ̃Xbhł悢)B Step ̓ŔfB
+// Step ɓnԂ͈ꎞ~͐i܂, x|ĐiށBL[tȂ ANIMCORE_E_FULL
+ANIMCORE_API int ANIMCORE_CALL AnimCoreInjectInput(ANIMCORE* pCore, int command, float value);
+ANIMCORE_API int ANIMCORE_CALL AnimCoreGetInputStats(const ANIMCORE* pCore, ANIMCORE_INPUTSTATS* pStats);
+
+//  pPath (UTF-8)  WAV ɏoBt@C̐擪͌Ă񂾎_,  Step ɓnԂŕ
+// (삪Ȃ΃Aj[V̎ t ̉ (t - Ă񂾎) * 48 t[)B
+// NULL ŏIĕ (AnimCoreDestroy ł)
+ANIMCORE_API int ANIMCORE_CALL AnimCoreSetAudioWav(ANIMCORE* pCore, const char* pPath);
+ANIMCORE_API int ANIMCORE_CALL AnimCoreGetAudioStats(const ANIMCORE* pCore, ANIMCORE_AUDIOSTATS* pStats);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,125 @@
+//-----------------------------------------------------------------------------
+// File: AnimMath.h
+//
+// Desc: The few matrix helpers the animation core needs, so that it builds
+//       without D3DX. Matrices use the D3D conventions (row vectors, left
+//       handed) and the same memory layout as D3DMATRIX.
+//-----------------------------------------------------------------------------
+#pragma once
+#include <math.h>
+
+
+#define ANIM_PI 3.141592654f  // D3DX_PI Ɠl
+
+struct ANIMMATRIX
+{
+	float m[4][4];
+};
+
+struct ANIMVECTOR4
+{
+	float x, y, z, w;
+};
+
+
+inline void AnimMatrixIdentity(ANIMMATRIX* pOut)
+{
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			pOut->m[i][j] = (i == j) ? 1.0f : 0.0f;
+}
+
+inline void AnimMatrixTranslation(ANIMMATRIX* pOut, float x, float y, float z)
+{
+	AnimMatrixIdentity(pOut);
+	pOut->m[3][0] = x;
+	pOut->m[3][1] = y;
+	pOut->m[3][2] = z;
+}
+
+inline void AnimMatrixRotationX(ANIMMATRIX* pOut, float angle)
+{
+	float c = cosf(angle), s = sinf(angle);
+	AnimMatrixIdentity(pOut);
+	pOut->m[1][1] = c;  pOut->m[1][2] = s;
+	pOut->m[2][1] = -s; pOut->m[2][2] = c;
+}
+
+inline void AnimMatrixRotationY(ANIMMATRIX* pOut, float angle)
+{
+	float c = cosf(angle), s = sinf(angle);
+	AnimMatrixIdentity(pOut);
+	pOut->m[0][0] = c; pOut->m[0][2] = -s;
+	pOut->m[2][0] = s; pOut->m[2][2] = c;
+}
+
+inline void AnimMatrixRotationZ(ANIMMATRIX* pOut, float angle)
+{
+	float c = cosf(angle), s = sinf(angle);
+	AnimMatrixIdentity(pOut);
+	pOut->m[0][0] = c;  pOut->m[0][1] = s;
+	pOut->m[1][0] = -s; pOut->m[1][1] = c;
+}
+
+inline ANIMMATRIX operator*(const ANIMMATRIX& a, const ANIMMATRIX& b)
+{
+	ANIMMATRIX r;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] +
+				a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+	return r;
+}
+
+// (x, y, z, 1) * m
+inline ANIMVECTOR4 AnimTransform(const ANIMMATRIX* pM, float x, float y, float z)
+{
+	ANIMVECTOR4 v;
+	v.x = x * pM->m[0][0] + y * pM->m[1][0] + z * pM->m[2][0] + pM->m[3][0];
+	v.y = x * pM->m[0][1] + y * pM->m[1][1] + z * pM->m[2][1] + pM->m[3][1];
+	v.z = x * pM->m[0][2] + y * pM->m[1][2] + z * pM->m[2][2] + pM->m[3][2];
+	v.w = x * pM->m[0][3] + y * pM->m[1][3] + z * pM->m[2][3] + pM->m[3][3];
+	return v;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimMatrixLookAtLH() / AnimMatrixPerspectiveFovLH()
+// Desc: Same results as the D3DX functions of the same name
+//-----------------------------------------------------------------------------
+inline void AnimMatrixLookAtLH(ANIMMATRIX* pOut, const float eye[3], const float at[3], const float up[3])
+{
+	float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+	float len = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+	z[0] /= len; z[1] /= len; z[2] /= len;
+
+	float x[3] = { up[1] * z[2] - up[2] * z[1], up[2] * z[0] - up[0] * z[2], up[0] * z[1] - up[1] * z[0] };
+	len = sqrtf(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+	x[0] /= len; x[1] /= len; x[2] /= len;
+
+	float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+	for (int i = 0; i < 3; i++) {
+		pOut->m[i][0] = x[i];
+		pOut->m[i][1] = y[i];
+		pOut->m[i][2] = z[i];
+		pOut->m[i][3] = 0.0f;
+	}
+	pOut->m[3][0] = -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]);
+	pOut->m[3][1] = -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]);
+	pOut->m[3][2] = -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]);
+	pOut->m[3][3] = 1.0f;
+}
+
+inline void AnimMatrixPerspectiveFovLH(ANIMMATRIX* pOut, float fovY, float aspect, float zn, float zf)
+{
+	float yScale = 1.0f / tanf(fovY / 2);
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			pOut->m[i][j] = 0.0f;
+	pOut->m[0][0] = yScale / aspect;
+	pOut->m[1][1] = yScale;
+	pOut->m[2][2] = zf / (zf - zn);
+	pOut->m[2][3] = 1.0f;
+	pOut->m[3][2] = -zn * zf / (zf - zn);
+}
@@ -0,0 +1,46 @@
+//-----------------------------------------------------------------------------
+// File: AnimMesh.h
+//
+// Desc: Vertex tables of the cube and the square. They are fixed at compile
+//       time; the D3D path copies them into vertex buffers and the software
+//       rasterizer reads them in place.
+//-----------------------------------------------------------------------------
+#pragma once
+
+
+struct ANIMVERTEX
+{
+	float x, y, z;
+};
+
+constexpr float ANIM_CUBE_LEN = 0.1f;
+
+// L[u (Op`Xgbv 18 , 20 _g)
+#define ANIM_CUBE_PRIMS 18
+constexpr ANIMVERTEX g_cubeVertices[] =
+{
+	{ -ANIM_CUBE_LEN, -ANIM_CUBE_LEN, -ANIM_CUBE_LEN }, { -ANIM_CUBE_LEN, ANIM_CUBE_LEN, -ANIM_CUBE_LEN },
+	{ ANIM_CUBE_LEN, -ANIM_CUBE_LEN, -ANIM_CUBE_LEN },  { ANIM_CUBE_LEN, ANIM_CUBE_LEN, -ANIM_CUBE_LEN },
+	{ ANIM_CUBE_LEN, -ANIM_CUBE_LEN, ANIM_CUBE_LEN },   { ANIM_CUBE_LEN, ANIM_CUBE_LEN, ANIM_CUBE_LEN },
+	{ -ANIM_CUBE_LEN, -ANIM_CUBE_LEN, ANIM_CUBE_LEN },  { -ANIM_CUBE_LEN, ANIM_CUBE_LEN, ANIM_CUBE_LEN },
+	{ -ANIM_CUBE_LEN, -ANIM_CUBE_LEN, -ANIM_CUBE_LEN }, { -ANIM_CUBE_LEN, ANIM_CUBE_LEN, -ANIM_CUBE_LEN },
+	{ ANIM_CUBE_LEN, ANIM_CUBE_LEN, -ANIM_CUBE_LEN },   { ANIM_CUBE_LEN, ANIM_CUBE_LEN, ANIM_CUBE_LEN },
+	{ -ANIM_CUBE_LEN, ANIM_CUBE_LEN, ANIM_CUBE_LEN },   { -ANIM_CUBE_LEN, ANIM_CUBE_LEN, -ANIM_CUBE_LEN },
+	{ -ANIM_CUBE_LEN, -ANIM_CUBE_LEN, -ANIM_CUBE_LEN }, { ANIM_CUBE_LEN, -ANIM_CUBE_LEN, -ANIM_CUBE_LEN },
+	{ ANIM_CUBE_LEN, -ANIM_CUBE_LEN, ANIM_CUBE_LEN },   { -ANIM_CUBE_LEN, -ANIM_CUBE_LEN, ANIM_CUBE_LEN },
+	{ -ANIM_CUBE_LEN, -ANIM_CUBE_LEN, -ANIM_CUBE_LEN },
+
+	{ -ANIM_CUBE_LEN, -ANIM_CUBE_LEN, 0 }, { -ANIM_CUBE_LEN, ANIM_CUBE_LEN, 0 }, { ANIM_CUBE_LEN, ANIM_CUBE_LEN, 0 },
+	{ ANIM_CUBE_LEN, -ANIM_CUBE_LEN, 0 },  { -ANIM_CUBE_LEN, -ANIM_CUBE_LEN, 0 },
+};
+
+// lp` (Op`Xgbv 4 BŌ 1 ͒Sŕ)
+#define ANIM_SQUARE_PRIMS 4
+constexpr ANIMVERTEX g_squareVertices[] =
+{
+	{ -ANIM_CUBE_LEN, -ANIM_CUBE_LEN, 0 }, { -ANIM_CUBE_LEN, ANIM_CUBE_LEN, 0 }, { ANIM_CUBE_LEN, ANIM_CUBE_LEN, 0 },
+	{ ANIM_CUBE_LEN, -ANIM_CUBE_LEN, 0 },  { -ANIM_CUBE_LEN, -ANIM_CUBE_LEN, 0 }, { 0, 0, 0 },
+};
+
+static_assert(sizeof(g_cubeVertices) / sizeof(ANIMVERTEX) >= ANIM_CUBE_PRIMS + 2, "cube strip is too short");
+static_assert(sizeof(g_squareVertices) / sizeof(ANIMVERTEX) >= ANIM_SQUARE_PRIMS + 2, "square strip is too short");
@@ -0,0 +1,705 @@
+//-----------------------------------------------------------------------------
+// File: AnimRaster.cpp
+//
+// Desc: See AnimRaster.h. Triangles are set up in screen space with edge
+//       functions and the D3D top-left fill rule; depth and color are
+//       interpolated per pixel (color with perspective correction) and the
+//       depth test is D3DCMP_LESSEQUAL. Lighting is done per vertex from the
+//       face normal, the way the fixed function pipeline would for a flat
+//       cube face.
+//
+//       Clipping uses a guard band: the rasterizer only touches pixels inside
+//       the viewport anyway, so a triangle that pokes out of the screen is
+//       drawn as it is. Only triangles that cross the near plane, or reach so
+//       far out that the screen coordinates lose precision, are clipped in
+//       homogeneous space. Outcodes are classified four vertices at a time
+//       with SSE2, and the per-triangle AND/OR codes of a whole strip are
+//       combined the same way.
+//
+//       Back faces are removed in a pre-pass too: the strip is projected and
+//       the winding of four triangles is computed at once, then only the
+//       triangles that survive are compacted into a list for setup. Half of
+//       a closed cube faces away, so half of its strip never reaches the
+//       triangle setup.
+//-----------------------------------------------------------------------------
+#include "AnimRaster.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RASTER_SSE2
+#endif
+
+
+// SetupMatrices() ƓJ
+static const float s_eye[3] = { 0.0f, -5.0f, -5.0f };
+static const float s_at[3] = { 0.0f, 0.0f, 0.0f };
+static const float s_up[3] = { 0.0f, 1.0f, 0.0f };
+#define RASTER_NEAR 1.0f
+#define RASTER_FAR 100.0f
+
+// SetupLights() Ɠ}eAƃCg (Cǧ (0, -0.5, 1) 𐳋K)
+static const float s_material[3] = { 0.3f, 0.1f, 0.5f };  // Diffuse = Ambient = Emissive
+static const float s_ambient = 32 / 255.0f;                // D3DRS_AMBIENT 0x00202020
+static const float s_lightDir[3] = { 0.0f, -0.4472136f, 0.8944272f };
+
+#define RASTER_STRIP_MAX 64
+
+// _̃AEgR[h
+#define OUT_LEFT    0x01
+#define OUT_RIGHT   0x02
+#define OUT_BOTTOM  0x04
+#define OUT_TOP     0x08
+#define OUT_NEAR    0x10
+#define OUT_FAR     0x20
+#define OUT_GUARD_L 0x40  // K[hoh̊O
+#define OUT_GUARD_R 0x80
+#define OUT_GUARD_B 0x100
+#define OUT_GUARD_T 0x200
+#define OUT_FRUSTUM (OUT_LEFT | OUT_RIGHT | OUT_BOTTOM | OUT_TOP | OUT_NEAR | OUT_FAR)
+#define OUT_CLIP    (OUT_NEAR | OUT_GUARD_L | OUT_GUARD_R | OUT_GUARD_B | OUT_GUARD_T)
+
+// K[hoh: ʂ̒S炱̃sNZ܂ł͐؂炸ɂ̂܂ܕ`
+// (float ̕ӊ֐ 1/16 sNZ̐xc͈)
+#define RASTER_GUARD_PX 8192.0f
+#define RASTER_CLIP_MAX 12  // 3 _ 5 ʂŐ؂Ƃ̍ő咸_ + ]T
+
+// ϊ̃Xgbv (SIMD œǂނ̂ SoA, 4 ̔{ + 2 ̗])
+struct RASTERSTRIP
+{
+	float x[RASTER_STRIP_MAX + 8];
+	float y[RASTER_STRIP_MAX + 8];
+	float z[RASTER_STRIP_MAX + 8];
+	float w[RASTER_STRIP_MAX + 8];
+	int code[RASTER_STRIP_MAX + 8];     // _̃AEgR[h
+	int triAnd[RASTER_STRIP_MAX + 8];   // Op` 3 _ AND
+	int triOr[RASTER_STRIP_MAX + 8];    // Op` 3 _ OR
+
+	// ʍW (w <= 0 ̒_̒l͎gȂ)
+	float sx[RASTER_STRIP_MAX + 8];
+	float sy[RASTER_STRIP_MAX + 8];
+	float sz[RASTER_STRIP_MAX + 8];
+	float invW[RASTER_STRIP_MAX + 8];
+
+	int triCount;                       // cOp`
+	int tri[RASTER_STRIP_MAX];
+};
+
+struct RASTERVERTEX
+{
+	float x, y;   // sNZW
+	float z;      // z / w
+	float invW;   // 1 / w
+	float c[3];   // F
+};
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RasterClear()
+// Desc: Black color and far depth, like Clear() in Render()
+//-----------------------------------------------------------------------------
+void RasterClear(const RASTERTARGET* pT)
+{
+	for (int y = 0; y < pT->height; y++) {
+		unsigned int* pColor = pT->pColor + (size_t)y * pT->pitch;
+		float* pDepth = pT->pDepth + (size_t)y * pT->width;
+		for (int x = 0; x < pT->width; x++) {
+			pColor[x] = 0xFF000000;
+			pDepth[x] = 1.0f;
+		}
+	}
+}
+
+
+
+
+static inline float Edge(const RASTERVERTEX* a, const RASTERVERTEX* b, float px, float py)
+{
+	return (b->x - a->x) * (py - a->y) - (b->y - a->y) * (px - a->x);
+}
+
+//̕ӂƍ̕ӂẼsNZ (v, y ͉)
+static inline bool IsTopLeft(const RASTERVERTEX* a, const RASTERVERTEX* b)
+{
+	return (a->y == b->y && b->x > a->x) || b->y < a->y;
+}
+
+static inline unsigned int PackColor(float r, float g, float b)
+{
+	int ir = (int)(r * 255.0f + 0.5f);
+	int ig = (int)(g * 255.0f + 0.5f);
+	int ib = (int)(b * 255.0f + 0.5f);
+	ir = ir < 0 ? 0 : (ir > 255 ? 255 : ir);
+	ig = ig < 0 ? 0 : (ig > 255 ? 255 : ig);
+	ib = ib < 0 ? 0 : (ib > 255 ? 255 : ib);
+	return 0xFF000000 | (ir << 16) | (ig << 8) | ib;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RasterTriangle()
+// Desc: Fills one clockwise screen space triangle
+//-----------------------------------------------------------------------------
+static void RasterTriangle(const RASTERTARGET* pT, const RASTERVERTEX* v0,
+	const RASTERVERTEX* v1, const RASTERVERTEX* v2)
+{
+	float area = Edge(v0, v1, v2->x, v2->y);
+	if (area <= 0)
+		return;
+
+	float fx0 = fminf(v0->x, fminf(v1->x, v2->x));
+	float fx1 = fmaxf(v0->x, fmaxf(v1->x, v2->x));
+	float fy0 = fminf(v0->y, fminf(v1->y, v2->y));
+	float fy1 = fmaxf(v0->y, fmaxf(v1->y, v2->y));
+	int x0 = fx0 < 0 ? 0 : (int)fx0;
+	int y0 = fy0 < 0 ? 0 : (int)fy0;
+	int x1 = fx1 >= pT->width ? pT->width - 1 : (int)fx1;
+	int y1 = fy1 >= pT->height ? pT->height - 1 : (int)fy1;
+	if (x0 > x1 || y0 > y1)
+		return;
+
+	bool tl0 = IsTopLeft(v1, v2), tl1 = IsTopLeft(v2, v0), tl2 = IsTopLeft(v0, v1);
+	float invArea = 1.0f / area;
+
+	//F 1/w |ĕԂ, Ō w ߂
+	float c0[3], c1[3], c2[3];
+	for (int k = 0; k < 3; k++) {
+		c0[k] = v0->c[k] * v0->invW;
+		c1[k] = v1->c[k] * v1->invW;
+		c2[k] = v2->c[k] * v2->invW;
+	}
+
+	for (int y = y0; y <= y1; y++) {
+		float py = y + 0.5f;
+		unsigned int* pColor = pT->pColor + (size_t)y * pT->pitch;
+		float* pDepth = pT->pDepth + (size_t)y * pT->width;
+		for (int x = x0; x <= x1; x++) {
+			float px = x + 0.5f;
+			float w0 = Edge(v1, v2, px, py);
+			float w1 = Edge(v2, v0, px, py);
+			float w2 = Edge(v0, v1, px, py);
+			if (w0 < 0 || w1 < 0 || w2 < 0)
+				continue;
+			if ((w0 == 0 && !tl0) || (w1 == 0 && !tl1) || (w2 == 0 && !tl2))
+				continue;
+
+			w0 *= invArea;
+			w1 *= invArea;
+			w2 *= invArea;
+			float z = w0 * v0->z + w1 * v1->z + w2 * v2->z;
+			if (z > pDepth[x])
+				continue;
+
+			float w = 1.0f / (w0 * v0->invW + w1 * v1->invW + w2 * v2->invW);
+			pDepth[x] = z;
+			pColor[x] = PackColor((w0 * c0[0] + w1 * c1[0] + w2 * c2[0]) * w,
+				(w0 * c0[1] + w1 * c1[1] + w2 * c2[1]) * w,
+				(w0 * c0[2] + w1 * c1[2] + w2 * c2[2]) * w);
+		}
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RasterTriangleFlat()
+// Desc: Same coverage and depth as RasterTriangle, but with one color for
+//       the whole triangle. Nothing but the depth is interpolated, the parts
+//       of the edge functions that only depend on the row are computed once
+//       per row, and since a triangle is convex a row ends at the first
+//       pixel that falls outside after the span has started.
+//-----------------------------------------------------------------------------
+static void RasterTriangleFlat(const RASTERTARGET* pT, const RASTERVERTEX* v0,
+	const RASTERVERTEX* v1, const RASTERVERTEX* v2, unsigned int color)
+{
+	float area = Edge(v0, v1, v2->x, v2->y);
+	if (area <= 0)
+		return;
+
+	float fx0 = fminf(v0->x, fminf(v1->x, v2->x));
+	float fx1 = fmaxf(v0->x, fmaxf(v1->x, v2->x));
+	float fy0 = fminf(v0->y, fminf(v1->y, v2->y));
+	float fy1 = fmaxf(v0->y, fmaxf(v1->y, v2->y));
+	int x0 = fx0 < 0 ? 0 : (int)fx0;
+	int y0 = fy0 < 0 ? 0 : (int)fy0;
+	int x1 = fx1 >= pT->width ? pT->width - 1 : (int)fx1;
+	int y1 = fy1 >= pT->height ? pT->height - 1 : (int)fy1;
+	if (x0 > x1 || y0 > y1)
+		return;
+
+	bool tl0 = IsTopLeft(v1, v2), tl1 = IsTopLeft(v2, v0), tl2 = IsTopLeft(v0, v1);
+	float invArea = 1.0f / area;
+
+	for (int y = y0; y <= y1; y++) {
+		float py = y + 0.5f;
+		unsigned int* pColor = pT->pColor + (size_t)y * pT->pitch;
+		float* pDepth = pT->pDepth + (size_t)y * pT->width;
+
+		//Edge() ̑O͍sŌ܂
+		float r0 = (v2->x - v1->x) * (py - v1->y);
+		float r1 = (v0->x - v2->x) * (py - v2->y);
+		float r2 = (v1->x - v0->x) * (py - v0->y);
+		bool inside = false;
+		for (int x = x0; x <= x1; x++) {
+			float px = x + 0.5f;
+			float w0 = r0 - (v2->y - v1->y) * (px - v1->x);
+			float w1 = r1 - (v0->y - v2->y) * (px - v2->x);
+			float w2 = r2 - (v1->y - v0->y) * (px - v0->x);
+			if (w0 < 0 || w1 < 0 || w2 < 0 ||
+				(w0 == 0 && !tl0) || (w1 == 0 && !tl1) || (w2 == 0 && !tl2)) {
+				if (inside)
+					break;
+				continue;
+			}
+			inside = true;
+
+			float z = w0 * invArea * v0->z + w1 * invArea * v1->z + w2 * invArea * v2->z;
+			if (z > pDepth[x])
+				continue;
+			pDepth[x] = z;
+			pColor[x] = color;
+		}
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ClassifyStrip()
+// Desc: Outcodes of count vertices, then the AND and OR of every run of three
+//       consecutive vertices, i.e. of every triangle of the strip. The AND
+//       says a triangle is completely outside one plane, the OR whether it
+//       needs clipping at all.
+//-----------------------------------------------------------------------------
+static void ClassifyStrip(RASTERSTRIP* s, int count, float guardX, float guardY)
+{
+#if defined(RASTER_SSE2)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 gx = _mm_set1_ps(guardX), gy = _mm_set1_ps(guardY);
+	//Op`̒i 2 ܂œǂނ̂ŗ]̒_ނĂ
+	for (int i = 0; i < count + 2; i += 4) {
+		__m128 x = _mm_load_ps(s->x + i), y = _mm_load_ps(s->y + i);
+		__m128 z = _mm_load_ps(s->z + i), w = _mm_load_ps(s->w + i);
+		__m128 nw = _mm_sub_ps(zero, w);
+		__m128 gw = _mm_mul_ps(gx, w), ngw = _mm_sub_ps(zero, gw);
+		__m128 hw = _mm_mul_ps(gy, w), nhw = _mm_sub_ps(zero, hw);
+		__m128i c = _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(x, nw)), _mm_set1_epi32(OUT_LEFT));
+		c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(x, w)), _mm_set1_epi32(OUT_RIGHT)));
+		c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(y, nw)), _mm_set1_epi32(OUT_BOTTOM)));
+		c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(y, w)), _mm_set1_epi32(OUT_TOP)));
+		c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(z, zero)), _mm_set1_epi32(OUT_NEAR)));
+		c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(z, w)), _mm_set1_epi32(OUT_FAR)));
+		c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(x, ngw)), _mm_set1_epi32(OUT_GUARD_L)));
+		c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(x, gw)), _mm_set1_epi32(OUT_GUARD_R)));
+		c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(y, nhw)), _mm_set1_epi32(OUT_GUARD_B)));
+		c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(y, hw)), _mm_set1_epi32(OUT_GUARD_T)));
+		_mm_storeu_si128((__m128i*)(s->code + i), c);
+	}
+	for (int i = 0; i < count - 2; i += 4) {
+		__m128i c0 = _mm_loadu_si128((const __m128i*)(s->code + i));
+		__m128i c1 = _mm_loadu_si128((const __m128i*)(s->code + i + 1));
+		__m128i c2 = _mm_loadu_si128((const __m128i*)(s->code + i + 2));
+		_mm_storeu_si128((__m128i*)(s->triAnd + i), _mm_and_si128(c0, _mm_and_si128(c1, c2)));
+		_mm_storeu_si128((__m128i*)(s->triOr + i), _mm_or_si128(c0, _mm_or_si128(c1, c2)));
+	}
+#else
+	for (int i = 0; i < count; i++) {
+		float x = s->x[i], y = s->y[i], z = s->z[i], w = s->w[i];
+		int c = 0;
+		if (x < -w) c |= OUT_LEFT;
+		if (x > w) c |= OUT_RIGHT;
+		if (y < -w) c |= OUT_BOTTOM;
+		if (y > w) c |= OUT_TOP;
+		if (z < 0) c |= OUT_NEAR;
+		if (z > w) c |= OUT_FAR;
+		if (x < -guardX * w) c |= OUT_GUARD_L;
+		if (x > guardX * w) c |= OUT_GUARD_R;
+		if (y < -guardY * w) c |= OUT_GUARD_B;
+		if (y > guardY * w) c |= OUT_GUARD_T;
+		s->code[i] = c;
+	}
+	for (int i = 0; i < count - 2; i++) {
+		s->triAnd[i] = s->code[i] & s->code[i + 1] & s->code[i + 2];
+		s->triOr[i] = s->code[i] | s->code[i + 1] | s->code[i + 2];
+	}
+#endif
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: CullStrip()
+// Desc: Projects the strip and keeps the triangles that are inside the
+//       frustum and face the camera (clockwise on screen, D3DCULL_CCW). The
+//       winding of a triangle that crosses the near plane is only known after
+//       clipping, so those are kept and culled later. Every odd triangle of a
+//       strip has its winding flipped.
+//-----------------------------------------------------------------------------
+static void CullStrip(const RASTERTARGET* pT, RASTERSTRIP* s, int count)
+{
+	int primCount = count - 2;
+	s->triCount = 0;
+#if defined(RASTER_SSE2)
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 width = _mm_set1_ps((float)pT->width), height = _mm_set1_ps((float)pT->height);
+	for (int i = 0; i < count + 4; i += 4) {
+		__m128 invW = _mm_div_ps(one, _mm_load_ps(s->w + i));
+		_mm_store_ps(s->invW + i, invW);
+		_mm_store_ps(s->sx + i, _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(s->x + i), invW), one), half), width));
+		_mm_store_ps(s->sy + i, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(_mm_load_ps(s->y + i), invW)), half), height));
+		_mm_store_ps(s->sz + i, _mm_mul_ps(_mm_load_ps(s->z + i), invW));
+	}
+	const __m128 flip = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+	const __m128i frustum = _mm_set1_epi32(OUT_FRUSTUM), nearBit = _mm_set1_epi32(OUT_NEAR);
+	for (int i = 0; i < primCount; i += 4) {
+		__m128 x0 = _mm_loadu_ps(s->sx + i), x1 = _mm_loadu_ps(s->sx + i + 1), x2 = _mm_loadu_ps(s->sx + i + 2);
+		__m128 y0 = _mm_loadu_ps(s->sy + i), y1 = _mm_loadu_ps(s->sy + i + 1), y2 = _mm_loadu_ps(s->sy + i + 2);
+		__m128 area = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(x1, x0), _mm_sub_ps(y2, y0)),
+			_mm_mul_ps(_mm_sub_ps(y1, y0), _mm_sub_ps(x2, x0)));
+		area = _mm_mul_ps(area, flip);
+
+		__m128i andCode = _mm_loadu_si128((const __m128i*)(s->triAnd + i));
+		__m128i orCode = _mm_loadu_si128((const __m128i*)(s->triOr + i));
+		__m128i inside = _mm_cmpeq_epi32(_mm_and_si128(andCode, frustum), _mm_setzero_si128());
+		__m128i crossNear = _mm_cmpeq_epi32(_mm_and_si128(orCode, nearBit), nearBit);
+		__m128i front = _mm_castps_si128(_mm_cmpgt_ps(area, _mm_setzero_ps()));
+		__m128i keep = _mm_and_si128(inside, _mm_or_si128(crossNear, front));
+
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(keep));
+		if (primCount - i < 4)
+			mask &= (1 << (primCount - i)) - 1;
+		while (mask != 0) {
+			int bit = 0;
+			while (!(mask & (1 << bit)))
+				bit++;
+			s->tri[s->triCount++] = i + bit;
+			mask &= mask - 1;
+		}
+	}
+#else
+	for (int i = 0; i < count; i++) {
+		s->invW[i] = 1.0f / s->w[i];
+		s->sx[i] = (s->x[i] * s->invW[i] + 1.0f) * 0.5f * pT->width;
+		s->sy[i] = (1.0f - s->y[i] * s->invW[i]) * 0.5f * pT->height;
+		s->sz[i] = s->z[i] * s->invW[i];
+	}
+	for (int i = 0; i < primCount; i++) {
+		if (s->triAnd[i] & OUT_FRUSTUM)
+			continue;
+		float area = (s->sx[i + 1] - s->sx[i]) * (s->sy[i + 2] - s->sy[i]) -
+			(s->sy[i + 1] - s->sy[i]) * (s->sx[i + 2] - s->sx[i]);
+		if (i & 1)
+			area = -area;
+		if ((s->triOr[i] & OUT_NEAR) || area > 0)
+			s->tri[s->triCount++] = i;
+	}
+#endif
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ClipPolygon()
+// Desc: Sutherland-Hodgman against the planes in mask, in homogeneous space.
+//       Returns the vertex count of the clipped polygon in pIn.
+//-----------------------------------------------------------------------------
+static inline float PlaneDist(const ANIMVECTOR4* v, int plane, float guardX, float guardY)
+{
+	switch (plane)
+	{
+	case OUT_NEAR:    return v->z;
+	case OUT_GUARD_L: return guardX * v->w + v->x;
+	case OUT_GUARD_R: return guardX * v->w - v->x;
+	case OUT_GUARD_B: return guardY * v->w + v->y;
+	default:          return guardY * v->w - v->y;
+	}
+}
+
+static int ClipPolygon(ANIMVECTOR4* pIn, int n, int mask, float guardX, float guardY)
+{
+	static const int planes[] = { OUT_NEAR, OUT_GUARD_L, OUT_GUARD_R, OUT_GUARD_B, OUT_GUARD_T };
+	ANIMVECTOR4 out[RASTER_CLIP_MAX];
+	for (int p = 0; p < 5 && n >= 3; p++) {
+		if (!(mask & planes[p]))
+			continue;
+		int m = 0;
+		for (int i = 0; i < n; i++) {
+			const ANIMVECTOR4* a = &pIn[i];
+			const ANIMVECTOR4* b = &pIn[(i + 1) % n];
+			float da = PlaneDist(a, planes[p], guardX, guardY);
+			float db = PlaneDist(b, planes[p], guardX, guardY);
+			if (da >= 0)
+				out[m++] = *a;
+			if ((da >= 0) != (db >= 0) && m < RASTER_CLIP_MAX) {
+				float t = da / (da - db);
+				out[m].x = a->x + (b->x - a->x) * t;
+				out[m].y = a->y + (b->y - a->y) * t;
+				out[m].z = a->z + (b->z - a->z) * t;
+				out[m].w = a->w + (b->w - a->w) * t;
+				m++;
+			}
+		}
+		for (int i = 0; i < m; i++)
+			pIn[i] = out[i];
+		n = m;
+	}
+	return n;
+}
+
+
+
+
+static inline void Project(const RASTERTARGET* pT, const ANIMVECTOR4* c, RASTERVERTEX* v)
+{
+	v->invW = 1.0f / c->w;
+	v->x = (c->x * v->invW + 1.0f) * 0.5f * pT->width;
+	v->y = (1.0f - c->y * v->invW) * 0.5f * pT->height;
+	v->z = c->z * v->invW;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: DrawStripPart()
+// Desc: Transforms, classifies and culls the strip as a whole, then sets up
+//       only the surviving triangles: the few that need it are clipped, and
+//       the rest go straight to the rasterizer with the projected vertices
+//-----------------------------------------------------------------------------
+static void DrawStripPart(const RASTERTARGET* pT, const ANIMMATRIX* pWorld,
+	const ANIMMATRIX& wvp, const ANIMVERTEX* pVertices, int primCount)
+{
+	int count = primCount + 2;
+	ANIMVECTOR4 world[RASTER_STRIP_MAX];
+	alignas(16) RASTERSTRIP strip;
+	for (int i = 0; i < count; i++) {
+		world[i] = AnimTransform(pWorld, pVertices[i].x, pVertices[i].y, pVertices[i].z);
+		ANIMVECTOR4 c = AnimTransform(&wvp, pVertices[i].x, pVertices[i].y, pVertices[i].z);
+		strip.x[i] = c.x;
+		strip.y[i] = c.y;
+		strip.z[i] = c.z;
+		strip.w[i] = c.w;
+	}
+	for (int i = count; i < ((count + 3) & ~3) + 4; i++) {
+		strip.x[i] = strip.y[i] = strip.z[i] = 0;
+		strip.w[i] = 1;
+	}
+	float guardX = RASTER_GUARD_PX / (0.5f * pT->width);
+	float guardY = RASTER_GUARD_PX / (0.5f * pT->height);
+	ClassifyStrip(&strip, count, guardX, guardY);
+	CullStrip(pT, &strip, count);
+
+	for (int t = 0; t < strip.triCount; t++) {
+		int i = strip.tri[t];
+
+		//Xgbv̊Ԗڂ͌tɂȂ
+		int idx[3] = { i, i + 1, i + 2 };
+		if (i & 1) {
+			idx[0] = i + 1;
+			idx[1] = i;
+		}
+		RASTERVERTEX v[RASTER_CLIP_MAX];
+		int n = 3;
+		if (strip.triOr[i] & OUT_CLIP) {
+			//ߕʂ܂K[hoh͂ݏô؂
+			ANIMVECTOR4 poly[RASTER_CLIP_MAX];
+			for (int k = 0; k < 3; k++) {
+				poly[k].x = strip.x[idx[k]];
+				poly[k].y = strip.y[idx[k]];
+				poly[k].z = strip.z[idx[k]];
+				poly[k].w = strip.w[idx[k]];
+			}
+			n = ClipPolygon(poly, 3, strip.triOr[i] & OUT_CLIP, guardX, guardY);
+			if (n < 3)
+				continue;
+			for (int k = 0; k < n; k++)
+				Project(pT, &poly[k], &v[k]);
+			if (n == 3 && Edge(&v[0], &v[1], v[2].x, v[2].y) <= 0)
+				continue;
+		}
+		else {
+			for (int k = 0; k < 3; k++) {
+				v[k].x = strip.sx[idx[k]];
+				v[k].y = strip.sy[idx[k]];
+				v[k].z = strip.sz[idx[k]];
+				v[k].invW = strip.invW[idx[k]];
+			}
+		}
+
+		//ʂ̖@ŃCeBO
+		const ANIMVECTOR4* p[3] = { &world[idx[0]], &world[idx[1]], &world[idx[2]] };
+		float e1[3] = { p[1]->x - p[0]->x, p[1]->y - p[0]->y, p[1]->z - p[0]->z };
+		float e2[3] = { p[2]->x - p[0]->x, p[2]->y - p[0]->y, p[2]->z - p[0]->z };
+		float nrm[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float len = sqrtf(nrm[0] * nrm[0] + nrm[1] * nrm[1] + nrm[2] * nrm[2]);
+		float diffuse = 0;
+		if (len > 0) {
+			diffuse = -(nrm[0] * s_lightDir[0] + nrm[1] * s_lightDir[1] + nrm[2] * s_lightDir[2]) / len;
+			if (diffuse < 0)
+				diffuse = 0;
+		}
+		float c[3];
+		for (int j = 0; j < 3; j++)
+			c[j] = s_material[j] * (1.0f + s_ambient + diffuse);
+
+		//؂p`͐`ɕ ( RasterTriangle ̂Ă)
+		if (pT->gouraud) {
+			for (int k = 0; k < n; k++) {
+				for (int j = 0; j < 3; j++)
+					v[k].c[j] = c[j];
+			}
+			for (int k = 1; k + 1 < n; k++)
+				RasterTriangle(pT, &v[0], &v[k], &v[k + 1]);
+		}
+		else {
+			unsigned int color = PackColor(c[0], c[1], c[2]);
+			for (int k = 1; k + 1 < n; k++)
+				RasterTriangleFlat(pT, &v[0], &v[k], &v[k + 1], color);
+		}
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RasterDrawStrip()
+// Desc: Longer strips (subdivided meshes) are drawn in pieces that share two
+//       vertices
+//-----------------------------------------------------------------------------
+void RasterDrawStrip(const RASTERTARGET* pT, const ANIMMATRIX* pWorld,
+	const ANIMMATRIX* pViewProj, const ANIMVERTEX* pVertices, int primCount)
+{
+	ANIMMATRIX wvp = *pWorld * *pViewProj;
+	//RASTER_STRIP_MAX _؂B؂͋Ԗڂ̒_Ȃ̂ŎOp`͕̌ςȂ
+	const int step = RASTER_STRIP_MAX - 2;
+	for (int first = 0; first < primCount; first += step)
+		DrawStripPart(pT, pWorld, wvp, pVertices + first, primCount - first < step ? primCount - first : step);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RasterViewProj()
+// Desc: Same camera as SetupMatrices()
+//-----------------------------------------------------------------------------
+static void RasterViewProj(const RASTERTARGET* pT, ANIMMATRIX* pViewProj)
+{
+	ANIMMATRIX view, proj;
+	AnimMatrixLookAtLH(&view, s_eye, s_at, s_up);
+	AnimMatrixPerspectiveFovLH(&proj, ANIM_PI / 4, (float)pT->width / pT->height, RASTER_NEAR, RASTER_FAR);
+	*pViewProj = view * proj;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RasterDrawStamps()
+// Desc: The squares at the start positions and every placed stamp
+//-----------------------------------------------------------------------------
+void RasterDrawStamps(const ANIMSTATE* a, const RASTERTARGET* pT)
+{
+	ANIMMATRIX viewProj, world, rotateMat, moveMat;
+	RasterViewProj(pT, &viewProj);
+	const ANIMVERTEX* pSquare = g_squareVertices;
+	int squarePrims = ANIM_SQUARE_PRIMS;
+	if (pT->pSquare != NULL) {
+		pSquare = pT->pSquare->lod[0].pVertices;
+		squarePrims = pT->pSquare->lod[0].primCount;
+	}
+
+	//ŏ̈ʒu̎lp`
+	static const int startTrack[] = { TRACK_I1, TRACK_I3, TRACK_K1, TRACK_E1, TRACK_P1 };
+	for (int i = 0; i < (int)(sizeof(startTrack) / sizeof(startTrack[0])); i++) {
+		const TRACKPARAM* t = &a->scene.track[startTrack[i]];
+		AnimMatrixTranslation(&moveMat, t->x, t->y, 0.0f);
+		RasterDrawStrip(pT, &moveMat, &viewProj, pSquare, squarePrims);
+	}
+
+	for (int i = 0; i < a->stampCount; i++) {
+		AnimMatrixRotationZ(&rotateMat, a->stamp[i].angle);
+		AnimMatrixTranslation(&moveMat, a->stamp[i].x, a->stamp[i].y, 0.0f);
+		world = rotateMat * moveMat;
+		RasterDrawStrip(pT, &world, &viewProj, pSquare, squarePrims);
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RasterDrawCubes()
+// Desc: The moving cubes. With a mesh from the cache, each cube uses the
+//       level of detail that fits its size on screen.
+//-----------------------------------------------------------------------------
+void RasterDrawCubes(const ANIMSTATE* a, const RASTERTARGET* pT)
+{
+	ANIMMATRIX viewProj;
+	RasterViewProj(pT, &viewProj);
+	for (int i = 0; i < a->cubeCount; i++) {
+		const ANIMMATRIX* pWorld = &a->cube[i];
+		if (pT->pCube == NULL) {
+			RasterDrawStrip(pT, pWorld, &viewProj, g_cubeVertices, ANIM_CUBE_PRIMS);
+			continue;
+		}
+		//S w Ɠȅc̔{ʏ̕ς
+		ANIMVECTOR4 c = AnimTransform(&viewProj, pWorld->m[3][0], pWorld->m[3][1], pWorld->m[3][2]);
+		float pixels = (c.w > RASTER_NEAR) ? pT->pCube->key.size * viewProj.m[1][1] * pT->height / c.w : 1e9f;
+		const MESHLOD* pLod = &pT->pCube->lod[SelectMeshLod(pT->pCube, pixels)];
+		RasterDrawStrip(pT, pWorld, &viewProj, pLod->pVertices, pLod->primCount);
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RasterDrawScene()
+// Desc: Same draw order as Render()
+//-----------------------------------------------------------------------------
+void RasterDrawScene(const ANIMSTATE* a, const RASTERTARGET* pT)
+{
+	RasterClear(pT);
+	RasterDrawStamps(a, pT);
+	RasterDrawCubes(a, pT);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RasterHalve()
+// Desc: One level of the image pyramid: every destination pixel is the
+//       rounded average of a 2x2 block. An odd last row or column is
+//       repeated.
+//-----------------------------------------------------------------------------
+void RasterHalve(const unsigned int* pSrc, int srcPitch, int srcWidth, int srcHeight,
+	unsigned int* pDst, int dstPitch)
+{
+	int w = (srcWidth + 1) / 2, h = (srcHeight + 1) / 2;
+	for (int y = 0; y < h; y++) {
+		const unsigned int* r0 = pSrc + (size_t)(2 * y) * srcPitch;
+		const unsigned int* r1 = (2 * y + 1 < srcHeight) ? r0 + srcPitch : r0;
+		unsigned int* pOut = pDst + (size_t)y * dstPitch;
+		for (int x = 0; x < w; x++) {
+			int x0 = 2 * x, x1 = (2 * x + 1 < srcWidth) ? 2 * x + 1 : 2 * x;
+			unsigned int p[4] = { r0[x0], r0[x1], r1[x0], r1[x1] };
+			unsigned int out = 0xFF000000;
+			for (int c = 0; c < 24; c += 8) {
+				unsigned int sum = ((p[0] >> c) & 0xFF) + ((p[1] >> c) & 0xFF) + ((p[2] >> c) & 0xFF) + ((p[3] >> c) & 0xFF);
+				out |= ((sum + 2) >> 2) << c;
+			}
+			pOut[x] = out;
+		}
+	}
+}
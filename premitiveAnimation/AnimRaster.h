@@ -0,0 +1,39 @@
+//-----------------------------------------------------------------------------
+// File: AnimRaster.h
+//
+// Desc: Software rasterizer for the animation core. It draws the same scene
+//       as Render() in Source1.cpp (camera, light, material, culling) into a
+//       32bit X8R8G8B8 buffer owned by the caller, plus a float depth buffer.
+//-----------------------------------------------------------------------------
+#pragma once
+#include "AnimMath.h"
+#include "MeshCache.h"
+#include "AnimSim.h"
+
+
+struct RASTERTARGET
+{
+	unsigned int* pColor;  // X8R8G8B8
+	int pitch;             // 1 s̃sNZ
+	float* pDepth;         // width * height
+	int width, height;
+	bool gouraud;          // _̐FԂ (false ȂOp`Ƃ 1 Fœh)
+	const MESH* pCube;     // L[uƎlp`̌` (NULL Ȃ AnimMesh.h ̕\)
+	const MESH* pSquare;
+};
+
+
+void RasterClear(const RASTERTARGET* pTarget);
+// Op`Xgbv` (D3DPT_TRIANGLESTRIP ƓсB̐͂Ȃ)
+void RasterDrawStrip(const RASTERTARGET* pTarget, const ANIMMATRIX* pWorld,
+	const ANIMMATRIX* pViewProj, const ANIMVERTEX* pVertices, int primCount);
+// ŏ̈ʒu̎lp`ƒulp`
+void RasterDrawStamps(const ANIMSTATE* a, const RASTERTARGET* pTarget);
+// ĂL[u
+void RasterDrawCubes(const ANIMSTATE* a, const RASTERTARGET* pTarget);
+// ʑS (, ŏ̈ʒu̎lp`, ulp`, L[u) `
+void RasterDrawScene(const ANIMSTATE* a, const RASTERTARGET* pTarget);
+
+// k摜̃s~bh 1 i (o͂ (w + 1) / 2 x (h + 1) / 2)
+void RasterHalve(const unsigned int* pSrc, int srcPitch, int srcWidth, int srcHeight,
+	unsigned int* pDst, int dstPitch);
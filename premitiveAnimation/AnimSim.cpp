@@ -0,0 +1,1069 @@
+//-----------------------------------------------------------------------------
+// File: AnimSim.cpp
+//
+// Desc: See AnimSim.h
+//-----------------------------------------------------------------------------
+#include "AnimSim.h"
+#include "MemStats.h"
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+#define ANIM_NEVER UINT_MAX  // ~܂ȂgbN TrackStopStep()
+#define ANIM_STAMP_GROW 256  // lp`̔zŏɊmۂ鐔 (Ƃ͔{Xɑ₷)
+
+
+
+
+// 1 Xebvœs (ړ̌ʂL[uƎlp`̏ɓn)
+struct ANIMMOVE
+{
+	int row;
+	float prev[2], cur[2];
+};
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: LowestBit()
+//-----------------------------------------------------------------------------
+static inline int LowestBit(unsigned int bits)
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward(&i, bits);
+	return (int)i;
+#else
+	return __builtin_ctz(bits);
+#endif
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: SetRunning() / StopRunning()
+//-----------------------------------------------------------------------------
+static inline void SetRunning(ANIMTRACKSTATE* st, int row)
+{
+	st->running[row >> 5] |= 1u << (row & 31);
+}
+
+static inline void StopRunning(ANIMTRACKSTATE* st, int row)
+{
+	st->running[row >> 5] &= ~(1u << (row & 31));
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: Carve()
+// Desc: Cuts the next column out of a table's block. With pBase NULL it only
+//       adds up the size, so the same layout function measures the block
+//       and then hands out the columns.
+//-----------------------------------------------------------------------------
+template <class T>
+static T* Carve(char* pBase, size_t* pOffset, int count)
+{
+	T* p = (pBase != NULL) ? (T*)(pBase + *pOffset) : NULL;
+	*pOffset += ((size_t)count * sizeof(T) + 15) & ~(size_t)15;
+	return p;
+}
+
+static void LayoutState(ANIMTRACKSTATE* st, char* pBase, size_t* pOffset, int count)
+{
+	st->runWords = (count + 31) / 32;
+	st->start = Carve<ANIMTICK>(pBase, pOffset, count);
+	st->lastTurn = Carve<long long>(pBase, pOffset, count);
+	st->running = Carve<unsigned int>(pBase, pOffset, st->runWords);
+	st->stopStep = Carve<unsigned int>(pBase, pOffset, count);
+}
+
+static size_t LayoutLines(ANIMLINES* l, char* pBase, int count)
+{
+	size_t offset = 0;
+	l->track = Carve<int>(pBase, &offset, count);
+	l->x = Carve<float>(pBase, &offset, count);
+	l->y = Carve<float>(pBase, &offset, count);
+	l->speed = Carve<float>(pBase, &offset, count);
+	l->dirX = Carve<double>(pBase, &offset, count);
+	l->dirY = Carve<double>(pBase, &offset, count);
+	l->axis = Carve<unsigned char>(pBase, &offset, count);
+	l->sign = Carve<float>(pBase, &offset, count);
+	l->end = Carve<float>(pBase, &offset, count);
+	l->spinAxis = Carve<unsigned char>(pBase, &offset, count);
+	l->spinSign = Carve<float>(pBase, &offset, count);
+	l->tilt = Carve<float>(pBase, &offset, count);
+	l->rows = Carve<unsigned char>(pBase, &offset, count);
+	l->prevRows = Carve<unsigned char>(pBase, &offset, count);
+	l->rowStep = Carve<float>(pBase, &offset, count);
+	LayoutState(&l->state, pBase, &offset, count);
+	return offset;
+}
+
+static size_t LayoutArcs(ANIMARCS* r, char* pBase, int count)
+{
+	size_t offset = 0;
+	r->track = Carve<int>(pBase, &offset, count);
+	r->x = Carve<float>(pBase, &offset, count);
+	r->y = Carve<float>(pBase, &offset, count);
+	r->radius = Carve<float>(pBase, &offset, count);
+	r->angle0 = Carve<float>(pBase, &offset, count);
+	r->speed = Carve<float>(pBase, &offset, count);
+	LayoutState(&r->state, pBase, &offset, count);
+	return offset;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AllocTracks()
+// Desc: One block per table, sized for the tracks of the scene: every logo
+//       has one arc and TRACK_NUM - 1 straight tracks
+//-----------------------------------------------------------------------------
+static bool AllocTracks(ANIMSTATE* a, const SCENEPARAM* pScene)
+{
+	int logos = pScene->cols * pScene->rows;
+	int lines = logos * (TRACK_NUM - 1);
+	free(a->line.pBlock);
+	free(a->arc.pBlock);
+	free(a->trackRow);
+	free(a->pMove);
+	MemStatAdd(MEMSYS_TRACKS, -(long long)a->trackBytes);
+	a->trackBytes = 0;
+
+	size_t lineBytes = LayoutLines(&a->line, NULL, lines);
+	size_t arcBytes = LayoutArcs(&a->arc, NULL, logos);
+	a->line.pBlock = malloc(lineBytes);
+	a->arc.pBlock = malloc(arcBytes);
+	a->trackRow = (int*)malloc((size_t)logos * TRACK_NUM * sizeof(int));
+	a->pMove = (ANIMMOVE*)malloc((size_t)logos * TRACK_NUM * sizeof(ANIMMOVE));
+	if (a->line.pBlock == NULL || a->arc.pBlock == NULL || a->trackRow == NULL || a->pMove == NULL) {
+		a->trackCount = 0;
+		return false;
+	}
+	LayoutLines(&a->line, (char*)a->line.pBlock, lines);
+	LayoutArcs(&a->arc, (char*)a->arc.pBlock, logos);
+	a->trackCount = logos * TRACK_NUM;
+	a->trackBytes = lineBytes + arcBytes + (size_t)a->trackCount * (sizeof(int) + sizeof(ANIMMOVE));
+	MemStatAdd(MEMSYS_TRACKS, (long long)a->trackBytes);
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: LinePos()
+// Desc: Position of a straight track after it has moved for elapsed [ms]
+//-----------------------------------------------------------------------------
+static void LinePos(const ANIMLINES* l, int i, ANIMTICK elapsed, float p[2])
+{
+	double s = l->speed[i] * (double)elapsed / 1000.0;
+	p[0] = (float)(l->x[i] + s * l->dirX[i]);
+	p[1] = (float)(l->y[i] + s * l->dirY[i]);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: LineInRange()
+// Desc: A straight track keeps moving until its axis coordinate passes end
+//-----------------------------------------------------------------------------
+static bool LineInRange(const ANIMLINES* l, int i, const float p[2])
+{
+	return l->sign[i] * p[l->axis[i]] <= l->sign[i] * l->end[i];
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ArcPos()
+// Desc: Angle of an arc track after it has moved for elapsed [ms]
+//-----------------------------------------------------------------------------
+static float ArcPos(const ANIMARCS* r, int i, ANIMTICK elapsed)
+{
+	double s = r->speed[i] * (double)elapsed / 1000.0;
+	return (float)(r->angle0[i] - s);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ArcInRange()
+// Desc: The arc stops once it has passed the bottom of the circle
+//-----------------------------------------------------------------------------
+static bool ArcInRange(float angle)
+{
+	return cos(angle) >= -0.01;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: LineMoving() / ArcMoving()
+//-----------------------------------------------------------------------------
+static bool LineMoving(const void* pTable, int i, ANIMTICK elapsed)
+{
+	float p[2];
+	LinePos((const ANIMLINES*)pTable, i, elapsed, p);
+	return LineInRange((const ANIMLINES*)pTable, i, p);
+}
+
+static bool ArcMoving(const void* pTable, int i, ANIMTICK elapsed)
+{
+	return ArcInRange(ArcPos((const ANIMARCS*)pTable, i, elapsed));
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: StopStep()
+// Desc: The step (counted from the track's start, first step is 1) in which
+//       the track finds itself out of range and stops. ms is the time to
+//       the stop solved from the closed form; the result is then corrected
+//       by evaluating the range test, so float rounding cannot make it
+//       differ from stepping.
+//-----------------------------------------------------------------------------
+static unsigned int StopStep(bool (*pfnMoving)(const void*, int, ANIMTICK), const void* pTable, int i, double ms)
+{
+	if (!pfnMoving(pTable, i, 0))
+		return 1;
+	if (!(ms >= 0) || ms > (double)(INT_MAX - 2 * ANIM_STEP_MS))
+		return ANIM_NEVER;
+
+	unsigned int k = (unsigned int)(ms / ANIM_STEP_MS) + 2;
+	while (k > 1 && !pfnMoving(pTable, i, (k - 2) * ANIM_STEP_MS))
+		k--;
+	while (pfnMoving(pTable, i, (k - 1) * ANIM_STEP_MS))
+		k++;
+	return k;
+}
+
+static unsigned int LineStopStep(const ANIMLINES* l, int i)
+{
+	//~܂܂łɐiދ
+	double dist = l->sign[i] * ((double)l->end[i] - (l->axis[i] == 0 ? l->x[i] : l->y[i]));
+	dist /= fabs(l->axis[i] == 0 ? l->dirX[i] : l->dirY[i]);
+	return StopStep(LineMoving, l, i, dist * 1000.0 / l->speed[i]);
+}
+
+static unsigned int ArcStopStep(const ANIMARCS* r, int i)
+{
+	double dist = (r->speed[i] > 0) ? r->angle0[i] + acos(-0.01) : acos(-0.01) - r->angle0[i];
+	return StopStep(ArcMoving, r, i, dist * 1000.0 / fabs(r->speed[i]));
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: BuildTrack()
+// Desc: Fills the components of one track from its scene parameters. The
+//       track's kind decides the table; row is its place in that table.
+//-----------------------------------------------------------------------------
+static void BuildTrack(ANIMSTATE* a, int id, int row)
+{
+	const TRACKPARAM* t = &a->scene.track[id % TRACK_NUM];
+	int logo = id / TRACK_NUM;
+	float offsetX = (logo % a->scene.cols) * a->scene.dx;
+	float offsetY = (logo / a->scene.cols) * a->scene.dy;
+	if (id % TRACK_NUM == TRACK_P2) {
+		ANIMARCS* r = &a->arc;
+		r->track[row] = id;
+		r->x[row] = t->x + offsetX;
+		r->y[row] = t->y + offsetY;
+		r->radius[row] = t->radius;
+		r->angle0[row] = ANIM_PI / 2;
+		r->speed[row] = t->speed;
+		return;
+	}
+
+	ANIMLINES* l = &a->line;
+	l->track[row] = id;
+	l->x[row] = t->x + offsetX;
+	l->y[row] = t->y + offsetY;
+	l->speed[row] = t->speed;
+	l->tilt[row] = 0;
+	l->rows[row] = 1;
+	l->prevRows[row] = 0;
+	l->rowStep[row] = 0;
+	switch (id % TRACK_NUM)
+	{
+	case TRACK_I2: case TRACK_K1: case TRACK_E1: case TRACK_P1:
+		//c_͉֐i, X ܂ɓ]
+		l->dirX[row] = 0; l->dirY[row] = -1;
+		l->axis[row] = 1; l->sign[row] = -1;
+		l->spinAxis[row] = 0; l->spinSign[row] = -1;
+		break;
+	case TRACK_K2:
+		l->dirX[row] = 1 / sqrt(2.0); l->dirY[row] = 1 / sqrt(2.0);
+		l->axis[row] = 0; l->sign[row] = 1;
+		l->spinAxis[row] = 1; l->spinSign[row] = -1;
+		l->tilt[row] = ANIM_PI / 4;
+		break;
+	case TRACK_K3:
+		l->dirX[row] = 0.5; l->dirY[row] = -sqrt(3.0) / 2;
+		l->axis[row] = 0; l->sign[row] = 1;
+		l->spinAxis[row] = 1; l->spinSign[row] = 1;
+		l->tilt[row] = -ANIM_PI / 3;
+		break;
+	default:
+		//_͉E֐i, Y ܂ɓ]BE ̉_ 3 {͓ x œ
+		l->dirX[row] = 1; l->dirY[row] = 0;
+		l->axis[row] = 0; l->sign[row] = 1;
+		l->spinAxis[row] = 1; l->spinSign[row] = -1;
+		if (id % TRACK_NUM == TRACK_E234) {
+			l->rows[row] = 3;
+			l->prevRows[row] = 2;
+			l->rowStep[row] = -t->y;
+		}
+		break;
+	}
+	l->end[row] = t->end + (l->axis[row] == 0 ? offsetX : offsetY);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: FindTrack()
+// Desc: State columns and row of a track id
+//-----------------------------------------------------------------------------
+static ANIMTRACKSTATE* FindTrack(ANIMSTATE* a, int id, int* pRow)
+{
+	if (id < 0 || id >= a->trackCount)
+		return NULL;
+	int row = a->trackRow[id];
+	*pRow = (row >= 0) ? row : ~row;
+	return (row >= 0) ? &a->line.state : &a->arc.state;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AddStamp()
+//-----------------------------------------------------------------------------
+static bool AddStamp(ANIMSTATE* a, float x, float y, float angle, ANIMTICK time)
+{
+	if (a->stampCount >= a->stampCapacity &&
+		!AnimReserve(a, 0, a->stampCapacity > 0 ? a->stampCapacity * 2 : ANIM_STAMP_GROW))
+		return false;
+	a->stamp[a->stampCount].x = x;
+	a->stamp[a->stampCount].y = y;
+	a->stamp[a->stampCount].angle = angle;
+	a->stampTime[a->stampCount] = time;
+	a->stampCount++;
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: LineStamps()
+// Desc: Places the square(s) of a straight track that moved from prev to
+//       cur. Whether the first one fit decides if the turn counts.
+//-----------------------------------------------------------------------------
+static bool LineStamps(ANIMSTATE* a, int i, const float prev[2], const float cur[2], ANIMTICK time)
+{
+	const ANIMLINES* l = &a->line;
+	bool placed = false;
+	float y = cur[1];
+	for (int r = 0; r < l->rows[i]; r++) {
+		bool added = AddStamp(a, (r < l->prevRows[i]) ? prev[0] : cur[0], y, l->tilt[i], time);
+		if (r == 0)
+			placed = added;
+		y += l->rowStep[i];
+	}
+	return placed;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ArcStamps()
+//-----------------------------------------------------------------------------
+static bool ArcStamps(ANIMSTATE* a, int i, float angle, ANIMTICK time)
+{
+	const ANIMARCS* r = &a->arc;
+	return AddStamp(a, r->radius[i] * cos(angle) + r->x[i], r->radius[i] * sin(angle) + r->y[i], angle, time);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: MoveLines() / MoveArcs()
+// Desc: Move system. Only running tracks are visited, in row order. Those
+//       that were out of range at the previous time leave the running set;
+//       the others are listed with their previous and new position.
+//-----------------------------------------------------------------------------
+static int MoveLines(ANIMSTATE* a, ANIMTICK time, ANIMMOVE* pMove)
+{
+	ANIMLINES* l = &a->line;
+	int n = 0;
+	for (int w = 0; w < l->state.runWords; w++) {
+		for (unsigned int bits = l->state.running[w]; bits != 0; bits &= bits - 1) {
+			int i = w * 32 + LowestBit(bits);
+			ANIMMOVE* m = &pMove[n];
+			LinePos(l, i, a->pretime - l->state.start[i], m->prev);
+			if (!LineInRange(l, i, m->prev)) {
+				StopRunning(&l->state, i);
+				continue;
+			}
+			LinePos(l, i, time - l->state.start[i], m->cur);
+			m->row = i;
+			n++;
+		}
+	}
+	return n;
+}
+
+static int MoveArcs(ANIMSTATE* a, ANIMTICK time, ANIMMOVE* pMove)
+{
+	ANIMARCS* r = &a->arc;
+	int n = 0;
+	for (int w = 0; w < r->state.runWords; w++) {
+		for (unsigned int bits = r->state.running[w]; bits != 0; bits &= bits - 1) {
+			int i = w * 32 + LowestBit(bits);
+			ANIMMOVE* m = &pMove[n];
+			m->prev[0] = ArcPos(r, i, a->pretime - r->state.start[i]);
+			if (!ArcInRange(m->prev[0])) {
+				StopRunning(&r->state, i);
+				continue;
+			}
+			m->cur[0] = ArcPos(r, i, time - r->state.start[i]);
+			m->row = i;
+			n++;
+		}
+	}
+	return n;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: SpinMatrix()
+// Desc: Rolling rotation about X (axis 0) or Y (axis 1)
+//-----------------------------------------------------------------------------
+static void SpinMatrix(ANIMMATRIX* pOut, int axis, float angle)
+{
+	if (axis == 0)
+		AnimMatrixRotationX(pOut, angle);
+	else
+		AnimMatrixRotationY(pOut, angle);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: LineCubes() / ArcCubes()
+// Desc: Cube system. World matrices of the moving cubes at their position
+//       before the step, as the original per-frame update drew them.
+//-----------------------------------------------------------------------------
+static void LineCubes(ANIMSTATE* a, const ANIMMOVE* pMove, int n, float turn)
+{
+	const ANIMLINES* l = &a->line;
+	for (int k = 0; k < n; k++) {
+		int i = pMove[k].row;
+		ANIMMATRIX moveMat, rotateMat, tiltMat;
+		SpinMatrix(&rotateMat, l->spinAxis[i], l->spinSign[i] * turn);
+		if (l->tilt[i] != 0) {
+			AnimMatrixRotationZ(&tiltMat, l->tilt[i]);
+			rotateMat = rotateMat * tiltMat;
+		}
+		float y = pMove[k].prev[1];
+		for (int r = 0; r < l->rows[i] && a->cubeCount < a->cubeCapacity; r++) {
+			AnimMatrixTranslation(&moveMat, pMove[k].prev[0], y, 0.0);
+			a->cube[a->cubeCount++] = rotateMat * moveMat;
+			y += l->rowStep[i];
+		}
+	}
+}
+
+static void ArcCubes(ANIMSTATE* a, const ANIMMOVE* pMove, int n, float turn)
+{
+	const ANIMARCS* r = &a->arc;
+	for (int k = 0; k < n && a->cubeCount < a->cubeCapacity; k++) {
+		int i = pMove[k].row;
+		float angle = pMove[k].prev[0];
+		ANIMMATRIX moveMat, rotateMat, rotateMat2;
+		AnimMatrixRotationZ(&rotateMat, angle);
+		AnimMatrixRotationX(&rotateMat2, -turn);
+		AnimMatrixTranslation(&moveMat, r->radius[i] * cos(angle) + r->x[i], r->radius[i] * sin(angle) + r->y[i], 0.0);
+		a->cube[a->cubeCount++] = rotateMat2 * rotateMat * moveMat;
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ResetState()
+//-----------------------------------------------------------------------------
+static void ResetState(ANIMTRACKSTATE* st, int row, ANIMTICK time)
+{
+	st->start[row] = time;
+	st->lastTurn[row] = 0;
+	SetRunning(st, row);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AllDone()
+//-----------------------------------------------------------------------------
+static bool AllDone(const ANIMSTATE* a)
+{
+	for (int w = 0; w < a->line.state.runWords; w++) {
+		if (a->line.state.running[w] != 0)
+			return false;
+	}
+	for (int w = 0; w < a->arc.state.runWords; w++) {
+		if (a->arc.state.running[w] != 0)
+			return false;
+	}
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ResetAll()
+// Desc: Puts every track back to its start position
+//-----------------------------------------------------------------------------
+static void ResetAll(ANIMSTATE* a)
+{
+	for (int i = 0; i < a->line.count; i++)
+		ResetState(&a->line.state, i, a->time);
+	for (int i = 0; i < a->arc.count; i++)
+		ResetState(&a->arc.state, i, a->time);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimInit()
+// Desc: Starts the animation from the beginning at startTime. The tables are
+//       only allocated again when the number of tracks changes, so seeking
+//       and restarting reuse them.
+//-----------------------------------------------------------------------------
+bool AnimInit(ANIMSTATE* a, const SCENEPARAM* pScene, ANIMTICK startTime)
+{
+	if (a->trackCount != SceneTrackCount(pScene) || a->trackRow == NULL) {
+		if (!AllocTracks(a, pScene)) {
+			AnimFree(a);
+			return false;
+		}
+	}
+	a->scene = *pScene;
+	a->startTime = startTime;
+	a->time = startTime;
+	a->pretime = startTime;
+	a->endTime = 0;
+	a->endGet = false;
+	a->loopCount = 0;
+	a->cubeCount = 0;
+	a->stampCount = 0;
+
+	//gbN̎ނƂ̕\, V[̏ɕׂ
+	ANIMLINES* l = &a->line;
+	ANIMARCS* r = &a->arc;
+	l->count = 0;
+	r->count = 0;
+	int cubes = 0;
+	for (int id = 0; id < a->trackCount; id++) {
+		if (id % TRACK_NUM == TRACK_P2) {
+			a->trackRow[id] = ~r->count;
+			BuildTrack(a, id, r->count++);
+			cubes++;
+		}
+		else {
+			a->trackRow[id] = l->count;
+			BuildTrack(a, id, l->count++);
+			cubes += l->rows[l->count - 1];
+		}
+	}
+	if (!AnimReserve(a, cubes, 0)) {
+		AnimFree(a);
+		return false;
+	}
+	memset(l->state.running, 0, l->state.runWords * sizeof(unsigned int));
+	memset(r->state.running, 0, r->state.runWords * sizeof(unsigned int));
+	ResetAll(a);
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: Reinit()
+// Desc: AnimInit with the state's own scene. If that fails the tables are
+//       freed but the scene and start time stay, so the state is empty
+//       rather than broken and a later AnimSeek can build it again.
+//-----------------------------------------------------------------------------
+static bool Reinit(ANIMSTATE* a, ANIMTICK startTime)
+{
+	SCENEPARAM scene = a->scene;
+	if (AnimInit(a, &scene, startTime))
+		return true;
+	a->scene = scene;
+	a->startTime = startTime;
+	a->time = startTime;
+	a->pretime = startTime;
+	return false;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimFree()
+// Desc: Releases the tables, cubes and stamps and leaves a zero-filled state
+//-----------------------------------------------------------------------------
+void AnimFree(ANIMSTATE* a)
+{
+	MemStatAdd(MEMSYS_TRACKS, -(long long)(a->trackBytes + a->cubeCapacity * sizeof(ANIMMATRIX)));
+	MemStatAdd(MEMSYS_STAMPS, -(long long)(a->stampCapacity * (sizeof(ANIMSTAMP) + sizeof(ANIMTICK))));
+	free(a->line.pBlock);
+	free(a->arc.pBlock);
+	free(a->trackRow);
+	free(a->pMove);
+	free(a->cube);
+	free(a->stamp);
+	free(a->stampTime);
+	memset(a, 0, sizeof(ANIMSTATE));
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimReserve()
+// Desc: Grows the cube and stamp arrays; they never shrink. Like the tables
+//       they are counted in MemStats when they change size.
+//-----------------------------------------------------------------------------
+bool AnimReserve(ANIMSTATE* a, int cubes, int stamps)
+{
+	if (cubes > a->cubeCapacity) {
+		ANIMMATRIX* pCube = (ANIMMATRIX*)realloc(a->cube, (size_t)cubes * sizeof(ANIMMATRIX));
+		if (pCube == NULL)
+			return false;
+		MemStatAdd(MEMSYS_TRACKS, (long long)(cubes - a->cubeCapacity) * (long long)sizeof(ANIMMATRIX));
+		a->cube = pCube;
+		a->cubeCapacity = cubes;
+	}
+	if (stamps > a->stampCapacity) {
+		ANIMSTAMP* pStamp = (ANIMSTAMP*)realloc(a->stamp, (size_t)stamps * sizeof(ANIMSTAMP));
+		if (pStamp == NULL)
+			return false;
+		a->stamp = pStamp;
+		ANIMTICK* pTime = (ANIMTICK*)realloc(a->stampTime, (size_t)stamps * sizeof(ANIMTICK));
+		if (pTime == NULL)
+			return false;
+		a->stampTime = pTime;
+		MemStatAdd(MEMSYS_STAMPS, (long long)(stamps - a->stampCapacity) * (long long)(sizeof(ANIMSTAMP) + sizeof(ANIMTICK)));
+		a->stampCapacity = stamps;
+	}
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimCopyFrame()
+// Desc: Copies what a frame is drawn from. The tracks stay behind, so the
+//       copy cannot be stepped.
+//-----------------------------------------------------------------------------
+bool AnimCopyFrame(ANIMSTATE* pDst, const ANIMSTATE* pSrc)
+{
+	if (!AnimReserve(pDst, pSrc->cubeCount, pSrc->stampCount))
+		return false;
+	pDst->scene = pSrc->scene;
+	pDst->startTime = pSrc->startTime;
+	pDst->time = pSrc->time;
+	pDst->pretime = pSrc->pretime;
+	pDst->endTime = pSrc->endTime;
+	pDst->endGet = pSrc->endGet;
+	pDst->loopCount = pSrc->loopCount;
+	pDst->cubeCount = pSrc->cubeCount;
+	memcpy(pDst->cube, pSrc->cube, pSrc->cubeCount * sizeof(ANIMMATRIX));
+	pDst->stampCount = pSrc->stampCount;
+	memcpy(pDst->stamp, pSrc->stamp, pSrc->stampCount * sizeof(ANIMSTAMP));
+	memcpy(pDst->stampTime, pSrc->stampTime, pSrc->stampCount * sizeof(ANIMTICK));
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimResetTrack()
+// Desc: Puts one track back to its start position from the scene parameters
+//-----------------------------------------------------------------------------
+void AnimResetTrack(ANIMSTATE* a, int id)
+{
+	int row;
+	ANIMTRACKSTATE* st = FindTrack(a, id, &row);
+	if (st != NULL)
+		ResetState(st, row, a->time);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimApplyScene()
+// Desc: Only tracks whose parameters changed are restarted, and the stamps
+//       that were already placed stay where they are
+//-----------------------------------------------------------------------------
+bool AnimApplyScene(ANIMSTATE* a, const SCENEPARAM* pScene)
+{
+	//וς΃gbN̕\蒼Blp`͏̂Ń[v𐔂
+	if (pScene->cols != a->scene.cols || pScene->rows != a->scene.rows ||
+		pScene->dx != a->scene.dx || pScene->dy != a->scene.dy) {
+		ANIMSTATE next;
+		memset(&next, 0, sizeof(next));
+		if (!AnimInit(&next, pScene, a->time))
+			return false;
+		next.loopCount = a->loopCount + 1;
+		AnimFree(a);
+		*a = next;
+		return true;
+	}
+
+	bool changed = false;
+	int logos = a->scene.cols * a->scene.rows;
+	for (int i = 0; i < TRACK_NUM; i++) {
+		if (memcmp(&a->scene.track[i], &pScene->track[i], sizeof(TRACKPARAM)) != 0) {
+			a->scene.track[i] = pScene->track[i];
+			//ׂS̓gbNׂč蒼
+			for (int id = i; id < logos * TRACK_NUM; id += TRACK_NUM) {
+				int row;
+				if (FindTrack(a, id, &row) != NULL)
+					BuildTrack(a, id, row);
+				AnimResetTrack(a, id);
+			}
+			//gbN̂ŏI҂蒼
+			a->endGet = false;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimStep()
+// Desc: One step of the simulation. A track that was still in range moves on
+//       and places a square when its cube has turned twice since the last
+//       one. The cube matrices are only needed after the last sub-step, so
+//       the others skip building them.
+//-----------------------------------------------------------------------------
+static void AnimStep(ANIMSTATE* a, ANIMTICK time, bool buildCubes)
+{
+	long long turn = (long long)(time / ANIM_TURN_MS);
+	a->time = time;
+	a->cubeCount = 0;
+
+	ANIMMOVE* lines = a->pMove;
+	ANIMMOVE* arcs = a->pMove + a->line.count;
+	int lineCount = MoveLines(a, time, lines);
+	int arcCount = MoveArcs(a, time, arcs);
+
+	if (buildCubes) {
+		//float ɂO 1 Ɏ߂ (N琔Ԃ float ̊px͑eȂ)
+		float spin = (float)fmod(time / 250.0, 2 * ANIM_PI);
+		LineCubes(a, lines, lineCount, spin);
+		ArcCubes(a, arcs, arcCount, spin);
+	}
+
+	//lp`
+	for (int k = 0; k < lineCount; k++) {
+		ANIMTRACKSTATE* st = &a->line.state;
+		int i = lines[k].row;
+		if (turn - st->lastTurn[i] >= 2 && LineStamps(a, i, lines[k].prev, lines[k].cur, time))
+			st->lastTurn[i] = turn;
+	}
+	for (int k = 0; k < arcCount; k++) {
+		ANIMTRACKSTATE* st = &a->arc.state;
+		int i = arcs[k].row;
+		if (turn - st->lastTurn[i] >= 2 && ArcStamps(a, i, arcs[k].cur[0], time))
+			st->lastTurn[i] = turn;
+	}
+
+	a->pretime = a->time;
+
+
+	if (AllDone(a)) {
+
+		if (!a->endGet) { a->endTime = a->time; a->endGet = true; }
+
+		if ((a->time - a->endTime) > ANIM_HOLD_MS) {
+			ResetAll(a);
+			a->stampCount = 0;
+			a->endGet = false;
+			a->loopCount++;
+		}
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimUpdate()
+// Desc: Advances the animation to the given time in steps of ANIM_STEP_MS.
+//       Stopping and stamp placement are checked once per step, so the
+//       result would depend on the step size. Fixing the step makes it
+//       independent of the frame rate and of how far one call jumps: a 1000x
+//       fast-forward places exactly the same stamps as real time. A remainder
+//       below one step is carried over.
+//-----------------------------------------------------------------------------
+void AnimUpdate(ANIMSTATE* a, ANIMTICK time)
+{
+	if (time < a->time)
+		return;
+	ANIMTICK steps = (time - a->time) / ANIM_STEP_MS;
+	for (; steps > 1; steps--)
+		AnimStep(a, a->time + ANIM_STEP_MS, false);
+	if (steps == 1)
+		AnimStep(a, a->time + ANIM_STEP_MS, true);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: StopSteps()
+// Desc: Stop step of every track; returns the last one (the logo is complete
+//       in that step)
+//-----------------------------------------------------------------------------
+static unsigned int StopSteps(ANIMSTATE* a)
+{
+	unsigned int* pLineStop = a->line.state.stopStep;
+	unsigned int* pArcStop = a->arc.state.stopStep;
+	unsigned int last = 0;
+	for (int i = 0; i < a->line.count; i++) {
+		pLineStop[i] = LineStopStep(&a->line, i);
+		if (pLineStop[i] > last)
+			last = pLineStop[i];
+	}
+	for (int i = 0; i < a->arc.count; i++) {
+		pArcStop[i] = ArcStopStep(&a->arc, i);
+		if (pArcStop[i] > last)
+			last = pArcStop[i];
+	}
+	return last;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimSeek()
+// Desc: Rebuilds the state at time without simulating the frames before it.
+//       The stop step of each track gives the loop length, so whole loops
+//       are skipped arithmetically. Within the current loop all tracks share
+//       one stamp schedule (every second quarter turn after the start), and
+//       only those schedule points are visited, so the cost is O(stamps).
+//       The state is rebuilt one step short of time and AnimStep does the
+//       last step, which also builds the cube matrices.
+//-----------------------------------------------------------------------------
+bool AnimSeek(ANIMSTATE* a, ANIMTICK time)
+{
+	if (!Reinit(a, a->startTime))
+		return false;
+	if (time < a->startTime + ANIM_STEP_MS)
+		return true;
+	ANIMTICK steps = (time - a->startTime) / ANIM_STEP_MS;
+
+	ANIMLINES* l = &a->line;
+	ANIMARCS* r = &a->arc;
+	unsigned int last = StopSteps(a);
+	const unsigned int* lineStop = l->state.stopStep;
+	const unsigned int* arcStop = r->state.stopStep;
+
+	//Ō̃gbN~܂Ă ANIM_HOLD_MS 𒴂Xebvōŏɖ߂
+	ANIMTICK loopStart = a->startTime;
+	ANIMTICK done = steps - 1;  // Ō 1 Xebv AnimStep ɔC
+	if (last != ANIM_NEVER) {
+		ANIMTICK loopSteps = last + ANIM_HOLD_MS / ANIM_STEP_MS + 1;
+		a->loopCount = (unsigned int)(done / loopSteps);
+		loopStart += (done / loopSteps) * loopSteps * ANIM_STEP_MS;
+		done %= loopSteps;
+	}
+	a->time = loopStart + done * ANIM_STEP_MS;
+	a->pretime = a->time;
+	for (int i = 0; i < l->count; i++) {
+		l->state.start[i] = loopStart;
+		if (done >= lineStop[i])
+			StopRunning(&l->state, i);
+	}
+	for (int i = 0; i < r->count; i++) {
+		r->state.start[i] = loopStart;
+		if (done >= arcStop[i])
+			StopRunning(&r->state, i);
+	}
+	if (done >= last) {
+		a->endGet = true;
+		a->endTime = loopStart + last * ANIM_STEP_MS;
+	}
+
+	//lp`uXebvǂ
+	ANIMTICK moving = (last - 1 < done) ? last - 1 : done;
+	long long lastTurn = 0;
+	ANIMTICK k = 1;
+	for (;;) {
+		ANIMTICK due = (ANIMTICK)(lastTurn + 2) * ANIM_TURN_MS;
+		if (loopStart + k * ANIM_STEP_MS < due)
+			k = (due - loopStart + ANIM_STEP_MS - 1) / ANIM_STEP_MS;
+		if (k > moving)
+			break;
+
+		ANIMTICK stepTime = loopStart + k * ANIM_STEP_MS;
+		long long turn = (long long)(stepTime / ANIM_TURN_MS);
+		for (int i = 0; i < l->count; i++) {
+			if (k >= lineStop[i])
+				continue;
+			float prev[2], cur[2];
+			LinePos(l, i, (k - 1) * ANIM_STEP_MS, prev);
+			LinePos(l, i, k * ANIM_STEP_MS, cur);
+			if (LineStamps(a, i, prev, cur, stepTime))
+				l->state.lastTurn[i] = turn;
+		}
+		for (int i = 0; i < r->count; i++) {
+			if (k >= arcStop[i])
+				continue;
+			if (ArcStamps(a, i, ArcPos(r, i, k * ANIM_STEP_MS), stepTime))
+				r->state.lastTurn[i] = turn;
+		}
+		lastTurn = turn;
+		k++;
+	}
+
+	AnimStep(a, a->time + ANIM_STEP_MS, true);
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimSeekEnd()
+// Desc: Seeks to the step in which the last track stops, the first moment
+//       of the hold with every stamp placed
+//-----------------------------------------------------------------------------
+bool AnimSeekEnd(ANIMSTATE* a)
+{
+	unsigned int last = StopSteps(a);
+	if (last == ANIM_NEVER || !AnimSeek(a, a->startTime + (ANIMTICK)last * ANIM_STEP_MS))
+		return false;
+	return a->endGet;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimPhaseEnd()
+// Desc: Time of the step that ends the current phase. While tracks run it is
+//       the step in which the last running one stops (counted from its own
+//       start, so tracks restarted by a scene change are included); during
+//       the hold it is the step that starts the next loop.
+//-----------------------------------------------------------------------------
+ANIMTICK AnimPhaseEnd(const ANIMSTATE* a)
+{
+	if (a->endGet)
+		return a->endTime + ANIM_HOLD_MS + ANIM_STEP_MS;
+
+	ANIMTICK end = a->time;
+	for (int w = 0; w < a->line.state.runWords; w++) {
+		for (unsigned int bits = a->line.state.running[w]; bits != 0; bits &= bits - 1) {
+			int i = w * 32 + LowestBit(bits);
+			unsigned int k = LineStopStep(&a->line, i);
+			if (k == ANIM_NEVER)
+				return a->time;
+			if (a->line.state.start[i] + (ANIMTICK)k * ANIM_STEP_MS > end)
+				end = a->line.state.start[i] + (ANIMTICK)k * ANIM_STEP_MS;
+		}
+	}
+	for (int w = 0; w < a->arc.state.runWords; w++) {
+		for (unsigned int bits = a->arc.state.running[w]; bits != 0; bits &= bits - 1) {
+			int i = w * 32 + LowestBit(bits);
+			unsigned int k = ArcStopStep(&a->arc, i);
+			if (k == ANIM_NEVER)
+				return a->time;
+			if (a->arc.state.start[i] + (ANIMTICK)k * ANIM_STEP_MS > end)
+				end = a->arc.state.start[i] + (ANIMTICK)k * ANIM_STEP_MS;
+		}
+	}
+	return end;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimRestart()
+// Desc: Starts the animation over from the current time. The loop counter
+//       goes on counting, so users of loopCount see that the stamps are gone.
+//-----------------------------------------------------------------------------
+void AnimRestart(ANIMSTATE* a)
+{
+	unsigned int loops = a->loopCount;
+	Reinit(a, a->time);
+	a->loopCount = loops + 1;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AnimTrackStopped()
+// Desc: A stopped track keeps its start time until it is restarted, so the
+//       step it stopped in follows from the stop step of its table row
+//-----------------------------------------------------------------------------
+bool AnimTrackStopped(const ANIMSTATE* a, int id, ANIMTICK* pTime)
+{
+	if (id < 0 || id >= a->trackCount)
+		return false;
+	int row = a->trackRow[id];
+	if (row >= 0) {
+		if (a->line.state.running[row >> 5] & (1u << (row & 31)))
+			return false;
+		*pTime = a->line.state.start[row] + (ANIMTICK)LineStopStep(&a->line, row) * ANIM_STEP_MS;
+	}
+	else {
+		row = ~row;
+		if (a->arc.state.running[row >> 5] & (1u << (row & 31)))
+			return false;
+		*pTime = a->arc.state.start[row] + (ANIMTICK)ArcStopStep(&a->arc, row) * ANIM_STEP_MS;
+	}
+	return true;
+}
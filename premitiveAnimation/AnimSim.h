@@ -0,0 +1,160 @@
+//-----------------------------------------------------------------------------
+// File: AnimSim.h
+//
+// Desc: Simulation of the logo animation. The cubes roll along their tracks
+//       and leave a square (stamp) every other quarter turn; when all tracks
+//       are done the finished logo is held for five seconds and the animation
+//       starts over. All state lives in ANIMSTATE, so several animations can
+//       run side by side and no window or device is needed.
+//
+//       A track's position is a closed form of the time since it started,
+//       and stamps are placed on a fixed schedule of quarter turns. AnimSeek
+//       uses this to rebuild the state at any time directly from the
+//       schedule, with the same result as stepping there with AnimUpdate.
+//
+//       Times are 64-bit milliseconds (ANIMTICK), so a kiosk that has been
+//       up for months neither wraps around like timeGetTime() after 49.7
+//       days nor loses precision in the cube rotation.
+//
+//       Tracks are stored by kind (archetype) as columns of components:
+//       straight tracks in ANIMLINES, the arc of the P in ANIMARCS. Each
+//       step runs a few systems (move, complete, cubes, stamps) that loop
+//       over one table at a time and only touch the columns they need; the
+//       track id is only used to find the row again when the scene changes.
+//       The columns, the cubes and the stamps are on the heap and sized
+//       from the scene, so a grid of many logos is the same loops over
+//       longer arrays. An ANIMSTATE owns that memory: it starts zero-filled,
+//       AnimInit sizes it and AnimFree releases it, and states are copied
+//       with AnimCopyFrame rather than by assignment. The tables and cubes
+//       are counted in MEMSYS_TRACKS and the stamps in MEMSYS_STAMPS as they
+//       are allocated.
+//-----------------------------------------------------------------------------
+#pragma once
+#include "AnimMath.h"
+#include "Scene.h"
+
+
+#define ANIM_STEP_MS 5        // V~[V̍ [ms] (250 ̖)
+#define ANIM_TURN_MS 250      // L[u 1/4 ]鎞
+#define ANIM_HOLD_MS 5000     // SĂŏɖ߂܂
+
+typedef unsigned long long ANIMTICK;  //  [ms]
+
+struct ANIMSTAMP
+{
+	float x, y;
+	float angle;  // Z ܂̉]
+};
+
+struct ANIMMOVE;
+
+// ǂ̎ނ̃gbNɂԁBʒu start ̌oߎԂŌ܂
+// running ͓Ăs̃rbgW, ~܂s͊OBVXe͗Ărbgǂ̂,
+// ~܂gbN 32 {Ƃ 0 ̌ǂݔ΂ɂȂ
+struct ANIMTRACKSTATE
+{
+	ANIMTICK* start;          // n߂
+	long long* lastTurn;      // ŌɎlp`u 1/4 ]̔ԍ
+	unsigned int* running;
+	int runWords;             // running ̌ꐔ
+	unsigned int* stopStep;   // AnimSeek ̍Ɨp (~܂Xebv)
+};
+
+// ɓgbN (I, K, E, P ̏c_)
+struct ANIMLINES
+{
+	int count;
+	int* track;  // V[̃gbNԍ
+
+	// ʒuƑx: (x, y) + speed [/s] * oߎ * (dirX, dirY)
+	float* x, * y;
+	float* speed;
+	double* dirX, * dirY;
+
+	// ~: axis ̍W (0 = x, 1 = y) iތ sign  end z~܂
+	unsigned char* axis;
+	float* sign;
+	float* end;
+
+	// ]: spinAxis (0 = X, 1 = Y) ܂ spinSign ̌ɓ], Z ܂ tilt X
+	unsigned char* spinAxis;
+	float* spinSign;
+	float* tilt;
+
+	// o: rows ̃L[uƎlp` y  rowStep 炵ĕׂ
+	// (E ̉_)Bŏ prevRows s̎lp`͓Öʒuɒu
+	unsigned char* rows;
+	unsigned char* prevRows;
+	float* rowStep;
+
+	ANIMTRACKSTATE state;
+	void* pBlock;  // ܂Ƃ߂Ċmۂ
+};
+
+// ~ʂgbN (P ̊)Bpx angle0  speed [rad/s] ŌĂ, X ܂ɓ]
+struct ANIMARCS
+{
+	int count;
+	int* track;
+	float* x, * y;  // S
+	float* radius;
+	float* angle0;
+	float* speed;
+	ANIMTRACKSTATE state;
+	void* pBlock;
+};
+
+struct ANIMSTATE
+{
+	SCENEPARAM scene;
+	ANIMTICK startTime;  // AnimInit ̎ (AnimSeek ̊)
+
+	// gbN (V[)
+	ANIMLINES line;
+	ANIMARCS arc;
+	int trackCount;
+	int* trackRow;       // gbNԍ -> s ( row, ~ʂ ~row)
+	ANIMMOVE* pMove;     // 1 Xebvœs (VXe̊Ԃ̎󂯓n)
+	size_t trackBytes;   // \, trackRow, pMove ̑傫 (MemStats ɑ)
+
+	ANIMTICK time;     // ݂̎ (ANIM_STEP_MS )
+	ANIMTICK pretime;  // O̎
+	ANIMTICK endTime;  // SgbN~܂
+	bool endGet;
+	unsigned int loopCount;  // ŏɖ߂ (lp`Ƃ)
+
+	int cubeCount, cubeCapacity;
+	ANIMMATRIX* cube;  // ĂL[ũ[hs
+	int stampCount, stampCapacity;
+	ANIMSTAMP* stamp;
+	ANIMTICK* stampTime;  // lp`u (stamp  AnimCore ł̂܂܌̂ŕʂ̔z)
+};
+
+
+// a  0 Ŗ߂̂x AnimInit ́BȂ false
+bool AnimInit(ANIMSTATE* a, const SCENEPARAM* pScene, ANIMTICK startTime);
+void AnimFree(ANIMSTATE* a);
+// `Ɏg (V[, , L[u, lp`) ʂBȂ false
+bool AnimCopyFrame(ANIMSTATE* pDst, const ANIMSTATE* pSrc);
+// L[uƎlp`̔zȂƂ cubes, stamps ɂ (󂯑R[hʂOɌĂ)
+bool AnimReserve(ANIMSTATE* a, int cubes, int stamps);
+void AnimResetTrack(ANIMSTATE* a, int id);
+// p[^ςgbN蒼BςgbN trueB
+// S̕וςΑŜ̎蒼 (Ȃ΍̃V[̂܂)
+bool AnimApplyScene(ANIMSTATE* a, const SCENEPARAM* pScene);
+// ANIM_STEP_MS ݂ time ܂Ői߂ ([͎ɉ)BL[u̍s cube[] ɓ
+// O̎Ȃ牽Ȃ
+void AnimUpdate(ANIMSTATE* a, ANIMTICK time);
+// startTime 獡̃V[ time ܂Ői߂Ԃ, t[ǂ킸ɍ
+// (AnimApplyScene œr瓮gbN̗͎cȂ)B
+// Ȃ false , a ̓V[c̏ԂɂȂ
+bool AnimSeek(ANIMSTATE* a, ANIMTICK time);
+// SgbN~܂Ďlp`_܂ AnimSeek B~܂ȂgbN false
+bool AnimSeekEnd(ANIMSTATE* a);
+// ̒iKIXebv̎: ĂԂ͍Ō̃gbN~܂Xebv,
+// Ƃ͍ŏɖ߂XebvB~܂ȂgbN΍̎
+ANIMTICK AnimPhaseEnd(const ANIMSTATE* a);
+// ̎ŏ̏Ԃł蒼 (lp`͏, loopCount  1 )
+void AnimRestart(ANIMSTATE* a);
+// gbN~܂Ă true , ~܂Xebv̎ *pTime ɓ
+bool AnimTrackStopped(const ANIMSTATE* a, int id, ANIMTICK* pTime);
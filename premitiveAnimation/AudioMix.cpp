@@ -0,0 +1,744 @@
+//-----------------------------------------------------------------------------
+// File: AudioMix.cpp
+//
+// Desc: See AudioMix.h. The cue waveforms are synthesized when a mixer is
+//       opened (a few decaying sines each), so there are no sound files.
+//
+//       Only the simulation thread pushes into the ring and only the mixer
+//       thread pops, so head and tail each have a single writer. On every
+//       pass the mixer empties the whole ring into pQueue, its own growable
+//       array kept in start order, and a queued cue becomes a voice when the
+//       block it mixes reaches it; voices are the cues that are actually
+//       sounding. A WAV mixer also reads ready, the end of the last
+//       scheduled frame, before it empties the ring: every cue of that frame
+//       was pushed before ready moved, and none of a later frame can start
+//       before it, so the mixer never has to go back.
+//
+//       Since the ring never holds cues the mixer is waiting on, its size
+//       only sets how often a busy frame makes the simulation wait for the
+//       mixer to run (WAV) or how many cues one late mixer pass can lose
+//       (real time). The queue holds the cues between the mixed position
+//       and ready, at most about one frame's worth.
+//-----------------------------------------------------------------------------
+#include "AudioMix.h"
+#include "MemStats.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_SSE2
+#endif
+
+static_assert((AUDIO_RING_SIZE & (AUDIO_RING_SIZE - 1)) == 0, "ring size must be a power of two");
+static_assert(AUDIO_BLOCK % 4 == 0, "block must be a multiple of 4 frames");
+
+#define AUDIO_PENDING_GROW 64  // 1 t[̗\LP
+
+
+// ̌`: partials ̃TCg̘a, attack ŗオ decay [s] Ō|B
+// lp` 12 ɒu邱Ƃ̂, dȂĂȂ傫ɂĂ
+struct CUESPEC
+{
+	float seconds;
+	float attack, decay;
+	int partials;
+	float freq[4];
+	float amp[4];
+};
+
+static const CUESPEC s_cueSpec[AUDIOCUE_NUM] =
+{
+	{ 0.04f, 0.0005f, 0.012f, 1, { 1568.0f }, { 0.08f } },                                      // G6 ̃NbN
+	{ 0.30f, 0.002f, 0.08f, 2, { 784.0f, 1176.0f }, { 0.2f, 0.1f } },                            // G5  D6
+	{ 1.80f, 0.005f, 0.5f, 4, { 523.25f, 659.25f, 783.99f, 1046.5f }, { 0.1f, 0.1f, 0.1f, 0.07f } },  // C ̘a
+};
+
+struct AUDIOEVENT
+{
+	int cue;
+	float pan;          // -1 () .. 1 (E)
+	long long sample;   // n߂t[
+};
+
+struct AUDIOVOICE
+{
+	const float* pData;
+	int length;
+	long long start;
+	float gain[2];
+};
+
+struct AUDIOMIXER
+{
+	int rate;
+	long long latency;  // [t[]
+	float* pCue[AUDIOCUE_NUM];
+	int cueLength[AUDIOCUE_NUM];
+
+	// o
+	FILE* fp;
+	AUDIOWRITEFN pfnWrite;
+	void* pContext;
+	std::thread thread;
+	std::atomic<bool> quit;
+
+	// V~[ṼXbh獬Xbh
+	AUDIOEVENT ring[AUDIO_RING_SIZE];
+	std::atomic<unsigned int> head;
+	std::atomic<unsigned int> tail;
+	std::atomic<long long> ready;  // WAV: Oɖn߂鉹ׂ͂ēꂽ
+
+	// \鑤G
+	AUDIOEVENT* pPending;  // 1 t[ (n߂鏇ɕׂĂ)
+	int pendingCount, pendingCapacity;
+	bool synced;
+	ANIMTICK prevAnim;
+	double prevTimeline;
+	unsigned int loopCount;
+	int stampCount;
+	unsigned int* pStopped;  // ~܂ĂgbÑrbg (trackCount )
+	int stoppedWords;
+	bool endGet;
+
+	// 鑤G
+	AUDIOEVENT* pQueue;  // O󂯎Ėn߂҂ (n߂鏇)
+	int queueFirst, queueCount, queueCapacity;
+	AUDIOVOICE voice[AUDIO_VOICE_MAX];
+	int voiceCount;
+	long long pos;  // ɍt[
+	float mix[AUDIO_BLOCK * 2];
+	short out[AUDIO_BLOCK * 2];
+
+	std::atomic<unsigned int> cues, late, dropped;
+	std::atomic<long long> written;
+};
+
+// WAV ̐擪 (PCM)
+#pragma pack(push, 1)
+struct WAVHEADER
+{
+	char riff[4];
+	unsigned int riffSize;
+	char wave[4];
+	char fmt[4];
+	unsigned int fmtSize;
+	unsigned short format;
+	unsigned short channels;
+	unsigned int rate;
+	unsigned int byteRate;
+	unsigned short blockAlign;
+	unsigned short bits;
+	char data[4];
+	unsigned int dataSize;
+};
+#pragma pack(pop)
+static_assert(sizeof(WAVHEADER) == 44, "wav header layout");
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: SynthCues()
+//-----------------------------------------------------------------------------
+static bool SynthCues(AUDIOMIXER* m)
+{
+	for (int c = 0; c < AUDIOCUE_NUM; c++) {
+		const CUESPEC* p = &s_cueSpec[c];
+		int n = (int)(p->seconds * m->rate);
+		m->pCue[c] = (float*)malloc(n * sizeof(float));
+		if (m->pCue[c] == NULL)
+			return false;
+		m->cueLength[c] = n;
+		MemStatAdd(MEMSYS_AUDIO, n * sizeof(float));
+
+		for (int i = 0; i < n; i++) {
+			double t = (double)i / m->rate;
+			double env = exp(-t / p->decay) * (t < p->attack ? t / p->attack : 1.0);
+			double v = 0;
+			for (int k = 0; k < p->partials; k++)
+				v += p->amp[k] * sin(2 * 3.14159265358979 * p->freq[k] * t);
+			m->pCue[c][i] = (float)(v * env);
+		}
+	}
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: MixVoice()
+// Desc: Adds count mono samples to the interleaved stereo accumulator with
+//       the voice's left and right gain. Each sample is duplicated into a
+//       left/right pair, so four samples become two vectors of the output.
+//-----------------------------------------------------------------------------
+static void MixVoice(float* pDst, const float* pSrc, int count, const float gain[2])
+{
+	int i = 0;
+#if defined(AUDIO_SSE2)
+	__m128 g = _mm_setr_ps(gain[0], gain[1], gain[0], gain[1]);
+	for (; i + 4 <= count; i += 4) {
+		__m128 s = _mm_loadu_ps(pSrc + i);
+		__m128 lo = _mm_unpacklo_ps(s, s);
+		__m128 hi = _mm_unpackhi_ps(s, s);
+		_mm_storeu_ps(pDst + i * 2, _mm_add_ps(_mm_loadu_ps(pDst + i * 2), _mm_mul_ps(lo, g)));
+		_mm_storeu_ps(pDst + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(pDst + i * 2 + 4), _mm_mul_ps(hi, g)));
+	}
+#endif
+	for (; i < count; i++) {
+		pDst[i * 2] += pSrc[i] * gain[0];
+		pDst[i * 2 + 1] += pSrc[i] * gain[1];
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ConvertBlock()
+// Desc: Clamps the accumulator to [-1, 1] and rounds it to 16 bit
+//-----------------------------------------------------------------------------
+static void ConvertBlock(const float* pSrc, short* pDst, int count)
+{
+	int i = 0;
+#if defined(AUDIO_SSE2)
+	__m128 lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f), scale = _mm_set1_ps(32767.0f);
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(pSrc + i), lo), hi), scale);
+		__m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(pSrc + i + 4), lo), hi), scale);
+		_mm_storeu_si128((__m128i*)(pDst + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+	}
+#endif
+	for (; i < count; i++) {
+		float v = pSrc[i] < -1.0f ? -1.0f : (pSrc[i] > 1.0f ? 1.0f : pSrc[i]);
+		pDst[i] = (short)lrintf(v * 32767.0f);
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: QueueCue()
+// Desc: Inserts a cue into the mixer's queue by start. Cues mostly arrive in
+//       order, so the search from the back ends at once.
+//-----------------------------------------------------------------------------
+static bool QueueCue(AUDIOMIXER* m, const AUDIOEVENT* e)
+{
+	if (m->queueCount == m->queueCapacity) {
+		if (m->queueFirst > 0) {
+			//炵n߂l߂
+			m->queueCount -= m->queueFirst;
+			memmove(m->pQueue, m->pQueue + m->queueFirst, m->queueCount * sizeof(AUDIOEVENT));
+			m->queueFirst = 0;
+		}
+		else {
+			int capacity = m->queueCapacity + AUDIO_RING_SIZE;
+			AUDIOEVENT* pQueue = (AUDIOEVENT*)realloc(m->pQueue, capacity * sizeof(AUDIOEVENT));
+			if (pQueue == NULL)
+				return false;
+			MemStatAdd(MEMSYS_AUDIO, AUDIO_RING_SIZE * sizeof(AUDIOEVENT));
+			m->pQueue = pQueue;
+			m->queueCapacity = capacity;
+		}
+	}
+	int i = m->queueCount++;
+	for (; i > m->queueFirst && m->pQueue[i - 1].sample > e->sample; i--)
+		m->pQueue[i] = m->pQueue[i - 1];
+	m->pQueue[i] = *e;
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ReceiveCues()
+// Desc: Empties the ring into the queue, however far ahead the cues start,
+//       so a simulation waiting on a full ring never waits for frames it
+//       has yet to schedule. Returns the number of cues taken.
+//-----------------------------------------------------------------------------
+static int ReceiveCues(AUDIOMIXER* m)
+{
+	unsigned int tail = m->tail.load(std::memory_order_relaxed);
+	unsigned int head = m->head.load(std::memory_order_acquire);
+	int count = (int)(head - tail);
+	for (; tail != head; tail++) {
+		if (!QueueCue(m, &m->ring[tail & (AUDIO_RING_SIZE - 1)]))
+			m->dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+	m->tail.store(tail, std::memory_order_release);
+	return count;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: StartVoices()
+// Desc: Turns the queued cues that start before end into voices. A cue
+//       whose start has already been mixed starts at once.
+//-----------------------------------------------------------------------------
+static void StartVoices(AUDIOMIXER* m, long long end)
+{
+	for (; m->queueFirst < m->queueCount; m->queueFirst++) {
+		const AUDIOEVENT* e = &m->pQueue[m->queueFirst];
+		if (e->sample >= end)
+			break;
+		if (m->voiceCount == AUDIO_VOICE_MAX) {
+			m->dropped.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		AUDIOVOICE* v = &m->voice[m->voiceCount++];
+		v->pData = m->pCue[e->cue];
+		v->length = m->cueLength[e->cue];
+		v->start = e->sample;
+		if (v->start < m->pos) {
+			v->start = m->pos;
+			m->late.fetch_add(1, std::memory_order_relaxed);
+		}
+		//p[ōEɐU
+		float angle = (e->pan + 1) * 0.25f * 3.14159265f;
+		v->gain[0] = cosf(angle);
+		v->gain[1] = sinf(angle);
+		m->cues.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (m->queueFirst == m->queueCount) {
+		m->queueFirst = 0;
+		m->queueCount = 0;
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: MixBlock()
+// Desc: Mixes frames [pos, pos + frames) into out. A voice that starts in
+//       the block is added from its start sample on; finished voices are
+//       removed.
+//-----------------------------------------------------------------------------
+static void MixBlock(AUDIOMIXER* m, int frames)
+{
+	memset(m->mix, 0, frames * 2 * sizeof(float));
+	for (int i = 0; i < m->voiceCount;) {
+		AUDIOVOICE* v = &m->voice[i];
+		long long begin = v->start - m->pos;
+		if (begin >= frames) {
+			i++;
+			continue;
+		}
+		if (begin < 0)
+			begin = 0;
+		long long offset = m->pos + begin - v->start;
+		int count = (int)(frames - begin < v->length - offset ? frames - begin : v->length - offset);
+		MixVoice(m->mix + begin * 2, v->pData + offset, count, v->gain);
+
+		if (offset + count >= v->length)
+			*v = m->voice[--m->voiceCount];
+		else
+			i++;
+	}
+	ConvertBlock(m->mix, m->out, frames * 2);
+	m->pos += frames;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: MixerThread()
+// Desc: Both mixers take every cue in the ring first. A WAV mixer mixes
+//       whole blocks while they end before ready and the rest when it is
+//       closed, and only sleeps when there was nothing to do. A real-time
+//       mixer mixes block after block and waits in the write function.
+//-----------------------------------------------------------------------------
+static void MixerThread(AUDIOMIXER* m)
+{
+	for (;;) {
+		bool quit = m->quit.load(std::memory_order_acquire);
+		//ready ͉ꂽƂɐiނ̂, ɓǂł󂯎
+		long long ready = m->ready.load(std::memory_order_acquire);
+		int received = ReceiveCues(m);
+
+		if (m->fp != NULL) {
+			int frames = (int)(ready - m->pos < AUDIO_BLOCK ? ready - m->pos : AUDIO_BLOCK);
+			if (frames == AUDIO_BLOCK || (quit && frames > 0)) {
+				StartVoices(m, m->pos + frames);
+				MixBlock(m, frames);
+				fwrite(m->out, sizeof(short) * 2, frames, m->fp);
+				m->written.fetch_add(frames, std::memory_order_relaxed);
+				continue;
+			}
+			if (quit)
+				break;
+			if (received == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		if (quit)
+			break;
+		StartVoices(m, m->pos + AUDIO_BLOCK);
+		MixBlock(m, AUDIO_BLOCK);
+		if (!m->pfnWrite(m->pContext, m->out, AUDIO_BLOCK))
+			break;
+		m->written.fetch_add(AUDIO_BLOCK, std::memory_order_relaxed);
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: OpenMixer()
+//-----------------------------------------------------------------------------
+static AUDIOMIXER* OpenMixer(int rate, int latencyMs)
+{
+	if (rate <= 0)
+		return NULL;
+	AUDIOMIXER* m = new (std::nothrow) AUDIOMIXER;
+	if (m == NULL)
+		return NULL;
+	MemStatAdd(MEMSYS_AUDIO, sizeof(AUDIOMIXER));
+	m->rate = rate;
+	m->latency = (long long)latencyMs * rate / 1000;
+	memset(m->pCue, 0, sizeof(m->pCue));
+	m->fp = NULL;
+	m->pfnWrite = NULL;
+	m->pContext = NULL;
+	m->quit = false;
+	m->head = 0;
+	m->tail = 0;
+	m->ready = 0;
+	m->pPending = NULL;
+	m->pendingCount = 0;
+	m->pendingCapacity = 0;
+	m->pStopped = NULL;
+	m->stoppedWords = 0;
+	m->synced = false;
+	m->pQueue = NULL;
+	m->queueFirst = 0;
+	m->queueCount = 0;
+	m->queueCapacity = 0;
+	m->voiceCount = 0;
+	m->pos = 0;
+	m->cues = 0;
+	m->late = 0;
+	m->dropped = 0;
+	m->written = 0;
+	if (!SynthCues(m)) {
+		CloseAudio(m);
+		return NULL;
+	}
+	return m;
+}
+
+
+static FILE* OpenUtf8(const char* pPath)
+{
+#if defined(_WIN32)
+	wchar_t path[1024];
+	FILE* fp;
+	if (MultiByteToWideChar(CP_UTF8, 0, pPath, -1, path, 1024) == 0 || _wfopen_s(&fp, path, L"wb") != 0)
+		return NULL;
+	return fp;
+#else
+	return fopen(pPath, "wb");
+#endif
+}
+
+
+static void WriteWavHeader(AUDIOMIXER* m, long long frames)
+{
+	WAVHEADER h;
+	memcpy(h.riff, "RIFF", 4);
+	memcpy(h.wave, "WAVE", 4);
+	memcpy(h.fmt, "fmt ", 4);
+	memcpy(h.data, "data", 4);
+	h.fmtSize = 16;
+	h.format = 1;
+	h.channels = 2;
+	h.rate = m->rate;
+	h.blockAlign = 4;
+	h.byteRate = m->rate * 4;
+	h.bits = 16;
+	h.dataSize = (unsigned int)(frames * 4);
+	h.riffSize = h.dataSize + sizeof(WAVHEADER) - 8;
+	fseek(m->fp, 0, SEEK_SET);
+	fwrite(&h, sizeof(h), 1, m->fp);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: OpenAudioWav() / OpenAudioStream()
+//-----------------------------------------------------------------------------
+AUDIOMIXER* OpenAudioWav(const char* pPath, int rate)
+{
+	AUDIOMIXER* m = OpenMixer(rate, 0);
+	if (m == NULL)
+		return NULL;
+	m->fp = OpenUtf8(pPath);
+	if (m->fp == NULL) {
+		CloseAudio(m);
+		return NULL;
+	}
+	//傫͕Ƃɏ
+	WriteWavHeader(m, 0);
+	m->thread = std::thread(MixerThread, m);
+	return m;
+}
+
+
+AUDIOMIXER* OpenAudioStream(AUDIOWRITEFN pfnWrite, void* pContext, int rate, int latencyMs)
+{
+	if (pfnWrite == NULL)
+		return NULL;
+	AUDIOMIXER* m = OpenMixer(rate, latencyMs);
+	if (m == NULL)
+		return NULL;
+	m->pfnWrite = pfnWrite;
+	m->pContext = pContext;
+	m->thread = std::thread(MixerThread, m);
+	return m;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: CloseAudio()
+//-----------------------------------------------------------------------------
+void CloseAudio(AUDIOMIXER* m)
+{
+	if (m == NULL)
+		return;
+	m->quit.store(true, std::memory_order_release);
+	if (m->thread.joinable())
+		m->thread.join();
+	if (m->fp != NULL) {
+		WriteWavHeader(m, m->written);
+		fclose(m->fp);
+	}
+	for (int c = 0; c < AUDIOCUE_NUM; c++) {
+		if (m->pCue[c] != NULL) {
+			MemStatAdd(MEMSYS_AUDIO, -(long long)(m->cueLength[c] * sizeof(float)));
+			free(m->pCue[c]);
+		}
+	}
+	MemStatAdd(MEMSYS_AUDIO, -(long long)((m->pendingCapacity + m->queueCapacity) * sizeof(AUDIOEVENT) + m->stoppedWords * sizeof(unsigned int)));
+	free(m->pPending);
+	free(m->pQueue);
+	free(m->pStopped);
+	MemStatAdd(MEMSYS_AUDIO, -(long long)sizeof(AUDIOMIXER));
+	delete m;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: TimelineSample()
+//-----------------------------------------------------------------------------
+static long long TimelineSample(const AUDIOMIXER* m, double timelineMs)
+{
+	return (long long)floor(timelineMs * m->rate / 1000.0 + 0.5) + m->latency;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: SizeStopped()
+// Desc: Sizes the stopped bits to the scene's tracks (a grid change gives
+//       the state a new track count). The bits are cleared when they are
+//       reallocated.
+//-----------------------------------------------------------------------------
+static bool SizeStopped(AUDIOMIXER* m, const ANIMSTATE* a)
+{
+	int words = (a->trackCount + 31) >> 5;
+	if (words == m->stoppedWords)
+		return true;
+	unsigned int* pStopped = (unsigned int*)calloc(words, sizeof(unsigned int));
+	if (pStopped == NULL)
+		return false;
+	MemStatAdd(MEMSYS_AUDIO, ((long long)words - m->stoppedWords) * (long long)sizeof(unsigned int));
+	free(m->pStopped);
+	m->pStopped = pStopped;
+	m->stoppedWords = words;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: GridPan()
+// Desc: Pan of x measured from the middle column of the grid (one logo spans
+//       about -3 .. 3)
+//-----------------------------------------------------------------------------
+static float GridPan(const ANIMSTATE* a, float x)
+{
+	return (x - (a->scene.cols - 1) * 0.5f * a->scene.dx) / 3.0f;
+}
+
+
+void SyncAudio(AUDIOMIXER* m, const ANIMSTATE* a, ANIMTICK animTime, double timelineMs)
+{
+	m->synced = SizeStopped(m, a);
+	m->ready.store(TimelineSample(m, timelineMs), std::memory_order_release);
+	if (!m->synced)
+		return;
+	m->prevAnim = animTime;
+	m->prevTimeline = timelineMs;
+	m->loopCount = a->loopCount;
+	m->stampCount = a->stampCount;
+	ANIMTICK time;
+	for (int id = 0; id < a->trackCount; id++) {
+		if (AnimTrackStopped(a, id, &time))
+			m->pStopped[id >> 5] |= 1u << (id & 31);
+		else
+			m->pStopped[id >> 5] &= ~(1u << (id & 31));
+	}
+	m->endGet = a->endGet;
+}
+
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AddCue()
+// Desc: Places a cue of animation time t on the timeline of the frame
+//       (prevAnim, animTime] -> (prevTimeline, timelineMs] and inserts it
+//       into the frame's cues by start. Events of a restart may lie before
+//       the frame and are moved to its start.
+//-----------------------------------------------------------------------------
+static void AddCue(AUDIOMIXER* m, int cue, float pan, ANIMTICK t, ANIMTICK animTime, double timelineMs)
+{
+	double timeline = timelineMs;
+	if (t <= m->prevAnim)
+		timeline = m->prevTimeline;
+	else if (t < animTime)
+		timeline = m->prevTimeline + (timelineMs - m->prevTimeline) * (double)(t - m->prevAnim) / (double)(animTime - m->prevAnim);
+
+	AUDIOEVENT e;
+	e.cue = cue;
+	e.pan = pan < -1.0f ? -1.0f : (pan > 1.0f ? 1.0f : pan);
+	e.sample = TimelineSample(m, timeline);
+	if (m->pendingCount == m->pendingCapacity) {
+		int capacity = m->pendingCapacity + AUDIO_PENDING_GROW;
+		AUDIOEVENT* pPending = (AUDIOEVENT*)realloc(m->pPending, capacity * sizeof(AUDIOEVENT));
+		if (pPending == NULL) {
+			m->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		MemStatAdd(MEMSYS_AUDIO, AUDIO_PENDING_GROW * sizeof(AUDIOEVENT));
+		m->pPending = pPending;
+		m->pendingCapacity = capacity;
+	}
+	int i = m->pendingCount++;
+	for (; i > 0 && m->pPending[i - 1].sample > e.sample; i--)
+		m->pPending[i] = m->pPending[i - 1];
+	m->pPending[i] = e;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: PushCues()
+// Desc: Pushes the frame's cues into the ring. A real-time mixer must not be
+//       held up, so a cue that does not fit is dropped; for a WAV file the
+//       simulation waits until the mixer has emptied the ring, which it does
+//       without waiting for ready to move, so a frame may hold any number
+//       of cues.
+//-----------------------------------------------------------------------------
+static void PushCues(AUDIOMIXER* m)
+{
+	unsigned int head = m->head.load(std::memory_order_relaxed);
+	for (int i = 0; i < m->pendingCount; i++) {
+		while (head - m->tail.load(std::memory_order_acquire) == AUDIO_RING_SIZE) {
+			if (m->fp == NULL)
+				break;
+			std::this_thread::yield();
+		}
+		if (head - m->tail.load(std::memory_order_acquire) == AUDIO_RING_SIZE) {
+			m->dropped.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		m->ring[head & (AUDIO_RING_SIZE - 1)] = m->pPending[i];
+		m->head.store(++head, std::memory_order_release);
+	}
+	m->pendingCount = 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ScheduleAudio()
+// Desc: New stamps are those past the previous count, or all of them after
+//       the loop started over. A track cue is due when its stopped bit
+//       appears, at the step it stopped in; the logo cue when endGet does.
+//       Stamps and tracks are panned by their x position in the grid.
+//-----------------------------------------------------------------------------
+void ScheduleAudio(AUDIOMIXER* m, const ANIMSTATE* a, ANIMTICK animTime, double timelineMs)
+{
+	if (!m->synced) {
+		SyncAudio(m, a, animTime, timelineMs);
+		return;
+	}
+
+	bool restarted = a->loopCount != m->loopCount;
+	if (!SizeStopped(m, a)) {
+		SyncAudio(m, a, animTime, timelineMs);
+		return;
+	}
+	for (int i = restarted ? 0 : m->stampCount; i < a->stampCount; i++)
+		AddCue(m, AUDIOCUE_STAMP, GridPan(a, a->stamp[i].x), a->stampTime[i], animTime, timelineMs);
+
+	//~܂rbg͂̏ŏ (ObhςƂ loopCount ςĂ)
+	for (int id = 0; id < a->trackCount; id++) {
+		unsigned int* pWord = &m->pStopped[id >> 5];
+		unsigned int bit = 1u << (id & 31);
+		ANIMTICK time;
+		if (!AnimTrackStopped(a, id, &time)) {
+			*pWord &= ~bit;
+			continue;
+		}
+		if (restarted || !(*pWord & bit)) {
+			float x = a->scene.track[id % TRACK_NUM].x + (id / TRACK_NUM % a->scene.cols) * a->scene.dx;
+			AddCue(m, AUDIOCUE_TRACK, GridPan(a, x), time, animTime, timelineMs);
+		}
+		*pWord |= bit;
+	}
+	if (a->endGet && (restarted || !m->endGet))
+		AddCue(m, AUDIOCUE_LOGO, 0, a->endTime, animTime, timelineMs);
+	PushCues(m);
+
+	m->prevAnim = animTime;
+	m->prevTimeline = timelineMs;
+	m->loopCount = a->loopCount;
+	m->stampCount = a->stampCount;
+	m->endGet = a->endGet;
+	m->ready.store(TimelineSample(m, timelineMs), std::memory_order_release);
+}
+
+
+void GetAudioStats(const AUDIOMIXER* m, AUDIOSTATS* pStats)
+{
+	pStats->cues = m->cues.load(std::memory_order_relaxed);
+	pStats->late = m->late.load(std::memory_order_relaxed);
+	pStats->dropped = m->dropped.load(std::memory_order_relaxed);
+	pStats->samples = m->written.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------------
+// File: AudioMix.h
+//
+// Desc: Sound of the logo animation. Cues are tied to the events of the
+//       simulation: a short click for every stamp, a chime when a track
+//       stops and a chord when the logo is complete. The simulation thread
+//       compares each frame with the previous one and schedules the cues it
+//       finds at the sample their step happened in, so the timing does not
+//       depend on the frame rate.
+//
+//       Cues go through a lock-free ring to a mixer thread that moves them
+//       into its own queue, starts them as voices when their block comes and
+//       adds the voices block by block (SSE2) and hands 16-bit stereo to the
+//       output. A WAV file is written only up to the frames scheduled so far
+//       and is therefore exact however fast the frames come (when the ring
+//       is full the simulation waits for the mixer to empty it rather than
+//       dropping a cue); a real-time output is mixed continuously and its
+//       write function sets the pace.
+//
+//       Frames are placed on an audio timeline [ms] given by the caller:
+//       the clock since the output started, or the animation time for an
+//       offline export. Within a frame the cues are spread in proportion to
+//       their animation time, so a skip or fast forward plays them quickly
+//       one after the other instead of all at once.
+//-----------------------------------------------------------------------------
+#pragma once
+#include "AnimSim.h"
+
+
+#define AUDIO_RATE 48000
+#define AUDIO_BLOCK 256        // 1 ɍt[ (4 ̔{)
+#define AUDIO_VOICE_MAX 64     // ɖ鉹
+#define AUDIO_RING_SIZE 2048   // 2 ׂ̂B1 t[̉͂葽Ă悢 (鑤󂯂̂҂)
+
+enum AUDIOCUE
+{
+	AUDIOCUE_STAMP,  // lp`u
+	AUDIOCUE_TRACK,  // gbN~܂
+	AUDIOCUE_LOGO,   // S
+	AUDIOCUE_NUM
+};
+
+struct AUDIOSTATS
+{
+	unsigned int cues;     // 炵
+	unsigned int late;     // IƂɓ͂̂ŒxĖ炵 (Ԃ̏o͂)
+	unsigned int dropped;  // Oɖ鉹tŎ̂Ă
+	long long samples;     // ot[
+};
+
+// Ԃ̏óBframes ̃XeI 16bit 󂯎܂ő҂ (ō鑬܂)B
+// false Ԃƍ̂߂
+typedef bool (*AUDIOWRITEFN)(void* pContext, const short* pSamples, int frames);
+
+struct AUDIOMIXER;
+
+
+// pPath (UTF-8)  16bit XeI WAV BJȂ NULL
+AUDIOMIXER* OpenAudioWav(const char* pPath, int rate);
+// latencyMs: \肵ɑ]TBt[͂܂łƏo͂̃obt@̕蒷
+AUDIOMIXER* OpenAudioStream(AUDIOWRITEFN pfnWrite, void* pContext, int rate, int latencyMs);
+// WAV ͗\肵Ō̃t[܂ŏĂ
+void CloseAudio(AUDIOMIXER* m);
+
+// ̏Ԃo邾ŉ炳Ȃ (n߂Ƃ, ΂)
+void SyncAudio(AUDIOMIXER* m, const ANIMSTATE* a, ANIMTICK animTime, double timelineMs);
+// ǑĂяȍo炷\ɓBanimTime ̓t[̎, timelineMs 
+// ̎Ԏł̂̎B1 ̃XbhĂ
+void ScheduleAudio(AUDIOMIXER* m, const ANIMSTATE* a, ANIMTICK animTime, double timelineMs);
+
+void GetAudioStats(const AUDIOMIXER* m, AUDIOSTATS* pStats);
@@ -0,0 +1,317 @@
+//-----------------------------------------------------------------------------
+// File: EventStream.cpp
+//
+// Desc: See EventStream.h. The writer remembers what the receiver already
+//       has (stamp count, loop count, scene) and only sends the difference.
+//       The reader appends whatever bytes have arrived to one buffer and
+//       hands out complete records in place.
+//-----------------------------------------------------------------------------
+#include "EventStream.h"
+#include "MemStats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <share.h>
+#endif
+
+
+#define EVREADER_CHUNK (64 * 1024)
+
+struct EVENTWRITER
+{
+	FILE* fp;
+	unsigned int loopCount;
+	int stampCount;
+	SCENEPARAM scene;
+	bool first;
+	unsigned char* pRecord;  // 1 R[h (ȂȂL)
+	size_t recordSize;
+};
+
+struct EVENTREADER
+{
+	FILE* fp;
+	unsigned char* pBuf;
+	size_t size;      // mۂoCg
+	size_t used;      // ǂݍ񂾃oCg
+	size_t pos;       // ̃R[ḧʒu
+	bool headerRead;
+};
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: OpenUtf8()
+//-----------------------------------------------------------------------------
+static FILE* OpenUtf8(const char* pPath, bool write)
+{
+#if defined(_WIN32)
+	wchar_t path[1024];
+	if (MultiByteToWideChar(CP_UTF8, 0, pPath, -1, path, 1024) == 0)
+		return NULL;
+	//ĂŒ̃t@Cʂ̃vZXǂ߂悤ɂ
+	return _wfsopen(path, write ? L"wb" : L"rb", _SH_DENYNO);
+#else
+	return fopen(pPath, write ? "wb" : "rb");
+#endif
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: OpenEventWriter()
+//-----------------------------------------------------------------------------
+EVENTWRITER* OpenEventWriter(const char* pPath)
+{
+	EVENTWRITER* w = (EVENTWRITER*)calloc(1, sizeof(EVENTWRITER));
+	if (w == NULL)
+		return NULL;
+	w->fp = OpenUtf8(pPath, true);
+	if (w->fp == NULL) {
+		CloseEventWriter(w);
+		return NULL;
+	}
+
+	EVSTREAMHEADER header = { EVSTREAM_MAGIC, EVSTREAM_VERSION, ANIM_STEP_MS, 0 };
+	if (fwrite(&header, sizeof(header), 1, w->fp) != 1) {
+		CloseEventWriter(w);
+		return NULL;
+	}
+	w->first = true;
+	return w;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: WriteEventFrame()
+// Desc: Writes one record. A loop restart clears the stamps, so the record
+//       then starts the list over; otherwise only the new tail is sent.
+//-----------------------------------------------------------------------------
+bool WriteEventFrame(EVENTWRITER* w, const ANIMSTATE* a, unsigned int frame)
+{
+	//ԑ傫Ȃ̂̓V[ƂׂĂ̎lp`𑗂Ƃ
+	size_t size = sizeof(EVFRAME) + sizeof(SCENEPARAM) + a->cubeCount * sizeof(EVCUBE) + a->stampCount * sizeof(EVSTAMP);
+	if (size > w->recordSize) {
+		size += size / 2;
+		unsigned char* pRecord = (unsigned char*)realloc(w->pRecord, size);
+		if (pRecord == NULL)
+			return false;
+		MemStatAdd(MEMSYS_EXPORT, (long long)(size - w->recordSize));
+		w->pRecord = pRecord;
+		w->recordSize = size;
+	}
+
+	EVFRAME* pFrame = (EVFRAME*)w->pRecord;
+	unsigned char* p = (unsigned char*)(pFrame + 1);
+	pFrame->frame = frame;
+	pFrame->timeLo = (uint32_t)a->time;
+	pFrame->timeHi = (uint32_t)(a->time >> 32);
+	pFrame->flags = 0;
+
+	if (w->first || memcmp(&w->scene, &a->scene, sizeof(SCENEPARAM)) != 0) {
+		pFrame->flags |= EVFRAME_SCENE;
+		memcpy(p, &a->scene, sizeof(SCENEPARAM));
+		p += sizeof(SCENEPARAM);
+		w->scene = a->scene;
+	}
+	if (a->loopCount != w->loopCount || a->stampCount < w->stampCount) {
+		pFrame->flags |= EVFRAME_RESET;
+		w->loopCount = a->loopCount;
+		w->stampCount = 0;
+	}
+	w->first = false;
+
+	pFrame->cubeCount = (uint32_t)a->cubeCount;
+	EVCUBE* pCube = (EVCUBE*)p;
+	for (int i = 0; i < a->cubeCount; i++) {
+		for (int r = 0; r < 4; r++) {
+			pCube[i].m[r][0] = a->cube[i].m[r][0];
+			pCube[i].m[r][1] = a->cube[i].m[r][1];
+			pCube[i].m[r][2] = a->cube[i].m[r][2];
+		}
+	}
+	p += a->cubeCount * sizeof(EVCUBE);
+
+	pFrame->stampCount = (uint32_t)(a->stampCount - w->stampCount);
+	EVSTAMP* pStamp = (EVSTAMP*)p;
+	for (int i = w->stampCount; i < a->stampCount; i++, pStamp++) {
+		pStamp->x = a->stamp[i].x;
+		pStamp->y = a->stamp[i].y;
+		pStamp->angle = a->stamp[i].angle;
+		pStamp->timeLo = (uint32_t)a->stampTime[i];
+	}
+	p = (unsigned char*)pStamp;
+	w->stampCount = a->stampCount;
+
+	pFrame->size = (uint32_t)(p - w->pRecord);
+	if (fwrite(w->pRecord, pFrame->size, 1, w->fp) != 1)
+		return false;
+	return fflush(w->fp) == 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: CloseEventWriter()
+//-----------------------------------------------------------------------------
+bool CloseEventWriter(EVENTWRITER* w)
+{
+	if (w == NULL)
+		return false;
+	bool ok = true;
+	if (w->fp != NULL)
+		ok = (fclose(w->fp) == 0);
+	MemStatAdd(MEMSYS_EXPORT, -(long long)w->recordSize);
+	free(w->pRecord);
+	free(w);
+	return ok;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: OpenEventReader()
+//-----------------------------------------------------------------------------
+EVENTREADER* OpenEventReader(const char* pPath)
+{
+	EVENTREADER* r = (EVENTREADER*)calloc(1, sizeof(EVENTREADER));
+	if (r == NULL)
+		return NULL;
+	r->fp = OpenUtf8(pPath, false);
+	if (r->fp == NULL) {
+		free(r);
+		return NULL;
+	}
+	return r;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ReadEventFrame()
+// Desc: Returns the next complete record, reading more of the file when the
+//       buffer runs short. Consumed records are dropped by moving the rest
+//       to the front, so the buffer only ever holds about one record.
+//-----------------------------------------------------------------------------
+const EVFRAME* ReadEventFrame(EVENTREADER* r)
+{
+	for (;;) {
+		size_t avail = r->used - r->pos;
+		size_t need = r->headerRead ? sizeof(EVFRAME) : sizeof(EVSTREAMHEADER);
+		if (avail >= need && r->headerRead) {
+			const EVFRAME* pFrame = (const EVFRAME*)(r->pBuf + r->pos);
+			need = pFrame->size;
+			size_t body = sizeof(EVFRAME) + ((pFrame->flags & EVFRAME_SCENE) ? sizeof(SCENEPARAM) : 0) +
+				pFrame->cubeCount * sizeof(EVCUBE) + (size_t)pFrame->stampCount * sizeof(EVSTAMP);
+			//ꂽR[h͐ɐi߂Ȃ̂Ŏ~߂
+			if (need != body || pFrame->cubeCount > EVFRAME_CUBE_MAX)
+				return NULL;
+			if (avail >= need) {
+				r->pos += need;
+				return pFrame;
+			}
+		}
+		else if (avail >= need) {
+			const EVSTREAMHEADER* pHeader = (const EVSTREAMHEADER*)(r->pBuf + r->pos);
+			if (pHeader->magic != EVSTREAM_MAGIC || pHeader->version != EVSTREAM_VERSION)
+				return NULL;
+			r->pos += sizeof(EVSTREAMHEADER);
+			r->headerRead = true;
+			continue;
+		}
+
+		//Ȃǂ
+		if (r->pos > 0) {
+			memmove(r->pBuf, r->pBuf + r->pos, avail);
+			r->used = avail;
+			r->pos = 0;
+		}
+		if (r->size < need + EVREADER_CHUNK) {
+			size_t size = need + EVREADER_CHUNK;
+			unsigned char* pBuf = (unsigned char*)realloc(r->pBuf, size);
+			if (pBuf == NULL)
+				return NULL;
+			MemStatAdd(MEMSYS_CACHE, (long long)(size - r->size));
+			r->pBuf = pBuf;
+			r->size = size;
+		}
+		clearerr(r->fp);
+		size_t got = fread(r->pBuf + r->used, 1, r->size - r->used, r->fp);
+		if (got == 0)
+			return NULL;
+		r->used += got;
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: CloseEventReader()
+//-----------------------------------------------------------------------------
+void CloseEventReader(EVENTREADER* r)
+{
+	if (r == NULL)
+		return;
+	fclose(r->fp);
+	MemStatAdd(MEMSYS_CACHE, -(long long)r->size);
+	free(r->pBuf);
+	free(r);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ApplyEventFrame()
+//-----------------------------------------------------------------------------
+void ApplyEventFrame(ANIMSTATE* a, const EVFRAME* pFrame)
+{
+	const SCENEPARAM* pScene = EventScene(pFrame);
+	if (pScene != NULL)
+		a->scene = *pScene;
+	if (pFrame->flags & EVFRAME_RESET) {
+		a->stampCount = 0;
+		a->loopCount++;
+	}
+	a->time = EventTime(pFrame);
+
+	//LȂ΃L[uVlp`̂Ă
+	if (!AnimReserve(a, (int)pFrame->cubeCount, a->stampCount + (int)pFrame->stampCount)) {
+		a->cubeCount = 0;
+		return;
+	}
+	const EVCUBE* pCube = EventCubes(pFrame);
+	a->cubeCount = pFrame->cubeCount;
+	for (int i = 0; i < a->cubeCount; i++) {
+		for (int r = 0; r < 4; r++) {
+			a->cube[i].m[r][0] = pCube[i].m[r][0];
+			a->cube[i].m[r][1] = pCube[i].m[r][1];
+			a->cube[i].m[r][2] = pCube[i].m[r][2];
+			a->cube[i].m[r][3] = (r == 3) ? 1.0f : 0.0f;
+		}
+	}
+
+	const EVSTAMP* pStamp = EventStamps(pFrame);
+	for (uint32_t i = 0; i < pFrame->stampCount; i++) {
+		a->stamp[a->stampCount].x = pStamp[i].x;
+		a->stamp[a->stampCount].y = pStamp[i].y;
+		a->stamp[a->stampCount].angle = pStamp[i].angle;
+		//lp`͑ÕR[ĥƂɒuꂽ̂, ʂ̓R[h̎Ɠ 1 O
+		ANIMTICK time = (a->time & ~0xFFFFFFFFULL) | pStamp[i].timeLo;
+		if (time > a->time)
+			time -= 0x100000000ULL;
+		a->stampTime[a->stampCount] = time;
+		a->stampCount++;
+	}
+}
@@ -0,0 +1,98 @@
+//-----------------------------------------------------------------------------
+// File: EventStream.h
+//
+// Desc: Binary stream of simulation events for replicating the animation on
+//       other machines. Instead of pixels, every frame record carries the
+//       cube transforms and only the stamps placed since the previous record
+//       (16 bytes each); the receiver keeps the stamp list itself.
+//
+//       The stream is a EVSTREAMHEADER followed by frame records:
+//
+//           EVFRAME  [SCENEPARAM]  EVCUBE[cubeCount]  EVSTAMP[stampCount]
+//
+//       Everything is little endian and 4-byte aligned, so a record can be
+//       used in place from the file or socket buffer without parsing.
+//-----------------------------------------------------------------------------
+#pragma once
+#include "AnimSim.h"
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define EVSTREAM_MAGIC   0x56454B49  // "IKEV"
+#define EVSTREAM_VERSION 3
+
+#define EVFRAME_SCENE 0x0001  // V[ς (wb_̒ SCENEPARAM)
+#define EVFRAME_RESET 0x0002  // [vŏɖ߂ (󂯑̎lp`Ăǉ)
+#define EVFRAME_CUBE_MAX (SCENE_LOGO_MAX * (TRACK_NUM + 2))  // S 1 œL[u͍ő 12 (E ̉_ 3 )
+
+struct EVSTREAMHEADER
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t stepMs;    // V~[V̍ (ANIM_STEP_MS)
+	uint32_t reserved;
+};
+
+struct EVFRAME
+{
+	uint32_t size;        // ̃R[hŜ̃oCg (ǂݔ΂p)
+	uint32_t frame;
+	uint32_t timeLo;      // Aj[V̎ [ms] (64bit, EventTime() œǂ)
+	uint32_t timeHi;
+	uint32_t flags;
+	uint32_t cubeCount;
+	uint32_t stampCount;  // ÕR[h瑝lp`
+};
+
+// L[ũ[hs̏ 3  (4 ڂ͏ 0 0 0 1)
+struct EVCUBE
+{
+	float m[4][3];
+};
+
+struct EVSTAMP
+{
+	float x, y;
+	float angle;
+	uint32_t timeLo;  // ủ 32bit (R[h̎Öԋ߂ɖ߂)
+};
+
+static_assert(sizeof(EVFRAME) == 28 && sizeof(EVCUBE) == 48 && sizeof(EVSTAMP) == 16, "event layout");
+static_assert(sizeof(SCENEPARAM) % 4 == 0, "scene must keep records aligned");
+
+
+struct EVENTWRITER;
+struct EVENTREADER;
+
+// pPath  UTF-8
+EVENTWRITER* OpenEventWriter(const char* pPath);
+// O񂩂ς 1 R[hɂď (R[hƂ flush ̂Ŏ󂯑͒ǂēǂ߂)
+bool WriteEventFrame(EVENTWRITER* pWriter, const ANIMSTATE* a, unsigned int frame);
+bool CloseEventWriter(EVENTWRITER* pWriter);
+
+EVENTREADER* OpenEventReader(const char* pPath);
+// Ă鎟̃R[hԂB܂͂ĂȂ NULLB
+// |C^͎̌Ăяo܂ŗL (ǂݍ݃obt@̂܂܎w)
+const EVFRAME* ReadEventFrame(EVENTREADER* pReader);
+void CloseEventReader(EVENTREADER* pReader);
+
+inline ANIMTICK EventTime(const EVFRAME* p)
+{
+	return ((ANIMTICK)p->timeHi << 32) | p->timeLo;
+}
+inline const SCENEPARAM* EventScene(const EVFRAME* p)
+{
+	return (p->flags & EVFRAME_SCENE) ? (const SCENEPARAM*)(p + 1) : NULL;
+}
+inline const EVCUBE* EventCubes(const EVFRAME* p)
+{
+	return (const EVCUBE*)((const char*)(p + 1) + ((p->flags & EVFRAME_SCENE) ? sizeof(SCENEPARAM) : 0));
+}
+inline const EVSTAMP* EventStamps(const EVFRAME* p)
+{
+	return (const EVSTAMP*)(EventCubes(p) + p->cubeCount);
+}
+
+// 󂯑: R[h ANIMSTATE ɔf (V[, L[u, lp`g)
+void ApplyEventFrame(ANIMSTATE* a, const EVFRAME* pFrame);
@@ -0,0 +1,482 @@
+//-----------------------------------------------------------------------------
+// File: FrameSink.cpp
+//
+// Desc: See FrameSink.h. Buffers are always written whole, so every request is
+//       aligned in both offset and size and the file can be opened unbuffered
+//       (FILE_FLAG_NO_BUFFERING / O_DIRECT). The padding of the last buffer is
+//       cut off again when the sink is closed.
+//-----------------------------------------------------------------------------
+#include "FrameSink.h"
+#include "MemStats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+
+#define SINK_ALIGN 4096
+
+enum SINKBACKEND
+{
+	SINK_OVERLAPPED,
+	SINK_URING,
+	SINK_PWRITE,
+};
+
+struct SINKBUFFER
+{
+	unsigned char* pData;
+	size_t used;
+	size_t length;              // ݗṽoCg
+	unsigned long long offset;  // ݐ̃t@Cʒu
+	bool busy;
+#if defined(_WIN32)
+	OVERLAPPED ov;
+#else
+	struct iovec iov;
+#endif
+};
+
+struct FRAMESINK
+{
+	SINKBACKEND backend;
+	SINKBUFFER buf[SINK_MAX_INFLIGHT];
+	int count;
+	int cur;
+	size_t bufferSize;
+	unsigned long long offset;
+	unsigned long long total;
+	bool failed;
+#if defined(_WIN32)
+	HANDLE hFile;
+	WCHAR path[MAX_PATH];
+#else
+	int fd;
+#if defined(__linux__)
+	int ring;
+	void* pSQ;
+	void* pCQ;
+	size_t sqSize, cqSize;
+	struct io_uring_sqe* pSQEs;
+	size_t sqeSize;
+	unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+	unsigned *cqHead, *cqTail, *cqMask;
+	struct io_uring_cqe* pCQEs;
+#endif
+#endif
+};
+
+
+
+
+//-----------------------------------------------------------------------------
+// Aligned buffer allocation
+//-----------------------------------------------------------------------------
+static unsigned char* AllocSinkBuffer(size_t size, int node)
+{
+#if defined(_WIN32)
+	if (node >= 0)
+		return (unsigned char*)VirtualAllocExNuma(GetCurrentProcess(), NULL, size,
+			MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE, (DWORD)node);
+	return (unsigned char*)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	(void)node;
+	void* p;
+	return posix_memalign(&p, SINK_ALIGN, size) == 0 ? (unsigned char*)p : NULL;
+#endif
+}
+
+static void FreeSinkBuffer(unsigned char* p)
+{
+	if (p == NULL)
+		return;
+#if defined(_WIN32)
+	VirtualFree(p, 0, MEM_RELEASE);
+#else
+	free(p);
+#endif
+}
+
+
+
+
+#if defined(__linux__)
+//-----------------------------------------------------------------------------
+// io_uring (raw system calls, so no liburing is needed)
+//-----------------------------------------------------------------------------
+static bool SetupRing(FRAMESINK* s)
+{
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	s->ring = (int)syscall(__NR_io_uring_setup, (unsigned)s->count, &p);
+	if (s->ring < 0)
+		return false;
+
+	s->sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	s->cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (s->cqSize > s->sqSize)
+			s->sqSize = s->cqSize;
+		s->cqSize = s->sqSize;
+	}
+	s->sqeSize = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	s->pSQ = mmap(NULL, s->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s->ring, IORING_OFF_SQ_RING);
+	if (s->pSQ == MAP_FAILED)
+		s->pSQ = NULL;
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		s->pCQ = s->pSQ;
+	else {
+		s->pCQ = mmap(NULL, s->cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s->ring, IORING_OFF_CQ_RING);
+		if (s->pCQ == MAP_FAILED)
+			s->pCQ = NULL;
+	}
+	s->pSQEs = (struct io_uring_sqe*)mmap(NULL, s->sqeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s->ring, IORING_OFF_SQES);
+	if (s->pSQEs == MAP_FAILED)
+		s->pSQEs = NULL;
+	if (s->pSQ == NULL || s->pCQ == NULL || s->pSQEs == NULL)
+		return false;
+
+	char* sq = (char*)s->pSQ;
+	char* cq = (char*)s->pCQ;
+	s->sqHead = (unsigned*)(sq + p.sq_off.head);
+	s->sqTail = (unsigned*)(sq + p.sq_off.tail);
+	s->sqMask = (unsigned*)(sq + p.sq_off.ring_mask);
+	s->sqArray = (unsigned*)(sq + p.sq_off.array);
+	s->cqHead = (unsigned*)(cq + p.cq_off.head);
+	s->cqTail = (unsigned*)(cq + p.cq_off.tail);
+	s->cqMask = (unsigned*)(cq + p.cq_off.ring_mask);
+	s->pCQEs = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+	return true;
+}
+
+static void CloseRing(FRAMESINK* s)
+{
+	if (s->pSQEs != NULL)
+		munmap(s->pSQEs, s->sqeSize);
+	if (s->pCQ != NULL && s->pCQ != s->pSQ)
+		munmap(s->pCQ, s->cqSize);
+	if (s->pSQ != NULL)
+		munmap(s->pSQ, s->sqSize);
+	if (s->ring >= 0)
+		close(s->ring);
+	s->ring = -1;
+	s->pSQ = s->pCQ = NULL;
+	s->pSQEs = NULL;
+}
+
+static bool SubmitRing(FRAMESINK* s, int index)
+{
+	SINKBUFFER* b = &s->buf[index];
+	unsigned tail = *s->sqTail;
+	unsigned slot = tail & *s->sqMask;
+	struct io_uring_sqe* sqe = &s->pSQEs[slot];
+
+	b->iov.iov_base = b->pData;
+	b->iov.iov_len = b->length;
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = s->fd;
+	sqe->addr = (unsigned long long)(size_t)&b->iov;
+	sqe->len = 1;
+	sqe->off = b->offset;
+	sqe->user_data = (unsigned long long)index;
+	s->sqArray[slot] = slot;
+	__atomic_store_n(s->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+	int ret;
+	do {
+		ret = (int)syscall(__NR_io_uring_enter, s->ring, 1, 0, 0, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+	return ret == 1;
+}
+
+// ЂƂ󂯎
+static bool ReapRing(FRAMESINK* s)
+{
+	for (;;) {
+		unsigned head = *s->cqHead;
+		if (head != __atomic_load_n(s->cqTail, __ATOMIC_ACQUIRE)) {
+			struct io_uring_cqe* cqe = &s->pCQEs[head & *s->cqMask];
+			SINKBUFFER* b = &s->buf[(int)cqe->user_data];
+			int res = cqe->res;
+			__atomic_store_n(s->cqHead, head + 1, __ATOMIC_RELEASE);
+
+			//Z݂G[͓݂ł蒼
+			if (res < 0 || (size_t)res != b->length) {
+				if (pwrite(s->fd, b->pData, b->length, (off_t)b->offset) != (ssize_t)b->length)
+					s->failed = true;
+			}
+			b->busy = false;
+			b->used = 0;
+			return true;
+		}
+		if (syscall(__NR_io_uring_enter, s->ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+			return false;
+	}
+}
+#endif
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: SubmitBuffer() / WaitBuffer()
+// Desc: Starts writing a buffer at the current file offset / waits until a
+//       buffer may be reused
+//-----------------------------------------------------------------------------
+#if !defined(_WIN32)
+static bool PwriteBuffer(const FRAMESINK* s, const SINKBUFFER* b)
+{
+	return pwrite(s->fd, b->pData, b->length, (off_t)b->offset) == (ssize_t)b->length;
+}
+#endif
+
+static void SubmitBuffer(FRAMESINK* s, int index, size_t length)
+{
+	SINKBUFFER* b = &s->buf[index];
+	b->length = length;
+	b->offset = s->offset;
+	s->offset += length;
+
+	switch (s->backend)
+	{
+#if defined(_WIN32)
+	case SINK_OVERLAPPED:
+		b->ov.Offset = (DWORD)b->offset;
+		b->ov.OffsetHigh = (DWORD)(b->offset >> 32);
+		ResetEvent(b->ov.hEvent);
+		if (WriteFile(s->hFile, b->pData, (DWORD)length, NULL, &b->ov) || GetLastError() == ERROR_IO_PENDING)
+			b->busy = true;
+		else
+			s->failed = true;
+		break;
+#else
+#if defined(__linux__)
+	case SINK_URING:
+		if (SubmitRing(s, index)) {
+			b->busy = true;
+			break;
+		}
+		//OgȂȂȍ~ pwrite
+		s->backend = SINK_PWRITE;
+		if (!PwriteBuffer(s, b))
+			s->failed = true;
+		break;
+#endif
+	case SINK_PWRITE:
+		if (!PwriteBuffer(s, b))
+			s->failed = true;
+		break;
+#endif
+	default:
+		break;
+	}
+
+	if (!b->busy)
+		b->used = 0;
+}
+
+static void WaitBuffer(FRAMESINK* s, int index)
+{
+	SINKBUFFER* b = &s->buf[index];
+	while (b->busy)
+	{
+#if defined(_WIN32)
+		DWORD written;
+		if (!GetOverlappedResult(s->hFile, &b->ov, &written, TRUE) || written != b->length)
+			s->failed = true;
+		b->busy = false;
+		b->used = 0;
+#elif defined(__linux__)
+		if (!ReapRing(s)) {
+			s->failed = true;
+			b->busy = false;
+			b->used = 0;
+		}
+#else
+		b->busy = false;
+#endif
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: OpenFrameSink()
+// Desc: Creates (truncates) the output file and allocates the buffers
+//-----------------------------------------------------------------------------
+FRAMESINK* OpenFrameSink(const char* pPath, int inFlight, size_t bufferSize, int node)
+{
+	FRAMESINK* s = (FRAMESINK*)calloc(1, sizeof(FRAMESINK));
+	if (s == NULL)
+		return NULL;
+	s->count = inFlight < 1 ? 1 : (inFlight > SINK_MAX_INFLIGHT ? SINK_MAX_INFLIGHT : inFlight);
+	s->bufferSize = (bufferSize + SINK_ALIGN - 1) & ~(size_t)(SINK_ALIGN - 1);
+
+#if defined(_WIN32)
+	MultiByteToWideChar(CP_UTF8, 0, pPath, -1, s->path, MAX_PATH);
+	s->hFile = CreateFileW(s->path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+		FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING, NULL);
+	if (s->hFile == INVALID_HANDLE_VALUE) {
+		free(s);
+		return NULL;
+	}
+	s->backend = SINK_OVERLAPPED;
+#else
+	s->fd = -1;
+#if defined(__linux__)
+	s->ring = -1;
+	s->fd = open(pPath, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+#endif
+	//O_DIRECT gȂt@CVXe (tmpfs Ȃ) ł̓y[WLbVoR
+	if (s->fd < 0)
+		s->fd = open(pPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (s->fd < 0) {
+		free(s);
+		return NULL;
+	}
+	s->backend = SINK_PWRITE;
+#if defined(__linux__)
+	if (SetupRing(s))
+		s->backend = SINK_URING;
+	else
+		CloseRing(s);
+#endif
+#endif
+
+	for (int i = 0; i < s->count; i++) {
+		s->buf[i].pData = AllocSinkBuffer(s->bufferSize, node);
+		if (s->buf[i].pData == NULL) {
+			s->failed = true;
+			CloseFrameSink(s);
+			return NULL;
+		}
+		MemStatAdd(MEMSYS_EXPORT, (long long)s->bufferSize);
+#if defined(_WIN32)
+		s->buf[i].ov.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+#endif
+	}
+
+	return s;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: WriteFrameSink()
+// Desc: Appends data. Full buffers are submitted immediately; the call only
+//       blocks when all buffers are still in flight.
+//-----------------------------------------------------------------------------
+bool WriteFrameSink(FRAMESINK* s, const void* pData, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)pData;
+	s->total += size;
+
+	while (size > 0) {
+		SINKBUFFER* b = &s->buf[s->cur];
+		WaitBuffer(s, s->cur);
+
+		size_t n = s->bufferSize - b->used;
+		if (n > size)
+			n = size;
+		memcpy(b->pData + b->used, p, n);
+		b->used += n;
+		p += n;
+		size -= n;
+
+		if (b->used == s->bufferSize) {
+			SubmitBuffer(s, s->cur, s->bufferSize);
+			s->cur = (s->cur + 1) % s->count;
+		}
+	}
+
+	return !s->failed;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: CloseFrameSink()
+// Desc: Flushes the partial buffer, waits for all writes and trims the file
+//       back to the number of bytes actually written
+//-----------------------------------------------------------------------------
+bool CloseFrameSink(FRAMESINK* s)
+{
+	if (s == NULL)
+		return false;
+
+	SINKBUFFER* b = &s->buf[s->cur];
+	if (b->pData != NULL && b->used > 0) {
+		size_t length = (b->used + SINK_ALIGN - 1) & ~(size_t)(SINK_ALIGN - 1);
+		memset(b->pData + b->used, 0, length - b->used);
+		SubmitBuffer(s, s->cur, length);
+	}
+	for (int i = 0; i < s->count; i++) {
+		if (s->buf[i].pData != NULL)
+			WaitBuffer(s, i);
+	}
+
+#if defined(_WIN32)
+	for (int i = 0; i < s->count; i++) {
+		if (s->buf[i].ov.hEvent != NULL)
+			CloseHandle(s->buf[i].ov.hEvent);
+	}
+	CloseHandle(s->hFile);
+
+	//obt@Ȃ̃nhł͒[̈ʒuɐ؂l߂Ȃ̂ŊJ
+	HANDLE hFile = CreateFileW(s->path, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER size;
+		size.QuadPart = (LONGLONG)s->total;
+		if (!SetFilePointerEx(hFile, size, NULL, FILE_BEGIN) || !SetEndOfFile(hFile))
+			s->failed = true;
+		CloseHandle(hFile);
+	}
+	else
+		s->failed = true;
+#else
+#if defined(__linux__)
+	CloseRing(s);
+#endif
+	if (ftruncate(s->fd, (off_t)s->total) != 0)
+		s->failed = true;
+	close(s->fd);
+#endif
+
+	for (int i = 0; i < s->count; i++) {
+		if (s->buf[i].pData != NULL)
+			MemStatAdd(MEMSYS_EXPORT, -(long long)s->bufferSize);
+		FreeSinkBuffer(s->buf[i].pData);
+	}
+
+	bool ok = !s->failed;
+	free(s);
+	return ok;
+}
+
+
+const char* FrameSinkBackend(const FRAMESINK* s)
+{
+	switch (s->backend)
+	{
+	case SINK_OVERLAPPED: return "overlapped";
+	case SINK_URING:      return "io_uring";
+	default:              return "pwrite";
+	}
+}
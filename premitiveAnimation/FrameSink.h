@@ -0,0 +1,21 @@
+//-----------------------------------------------------------------------------
+// File: FrameSink.h
+//
+// Desc: Batched file writer for exported frames. Data is collected into large
+//       sector aligned buffers, and a fixed number of them can be in flight at
+//       once: overlapped WriteFile on Windows, io_uring on Linux with a plain
+//       pwrite() fallback when the ring is not available.
+//-----------------------------------------------------------------------------
+#pragma once
+#include <stddef.h>
+
+
+#define SINK_MAX_INFLIGHT 8
+
+struct FRAMESINK;
+
+// pPath  UTF-8, node ̓obt@u NUMA m[h (-1 Ȃw肵Ȃ)
+FRAMESINK* OpenFrameSink(const char* pPath, int inFlight, size_t bufferSize, int node = -1);
+bool WriteFrameSink(FRAMESINK* pSink, const void* pData, size_t size);
+bool CloseFrameSink(FRAMESINK* pSink);
+const char* FrameSinkBackend(const FRAMESINK* pSink);
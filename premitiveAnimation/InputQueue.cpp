@@ -0,0 +1,200 @@
+//-----------------------------------------------------------------------------
+// File: InputQueue.cpp
+//
+// Desc: See InputQueue.h. The queue is a ring of cells with a sequence
+//       number each: a producer claims a position by advancing head and
+//       publishes the cell by storing its sequence, so several producers
+//       never block each other and the consumer never sees a half-written
+//       event. A full queue drops the new input instead of waiting.
+//-----------------------------------------------------------------------------
+#include "InputQueue.h"
+#include <string.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+static_assert((INPUT_QUEUE_SIZE & (INPUT_QUEUE_SIZE - 1)) == 0, "queue size must be a power of two");
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: InputClockUs()
+// Desc: Monotonic microsecond clock shared by the producers and the point
+//       where the frame is shown
+//-----------------------------------------------------------------------------
+unsigned long long InputClockUs()
+{
+#if defined(_WIN32)
+	static LARGE_INTEGER s_freq;
+	LARGE_INTEGER now;
+	if (s_freq.QuadPart == 0)
+		QueryPerformanceFrequency(&s_freq);
+	QueryPerformanceCounter(&now);
+	return (unsigned long long)(now.QuadPart / s_freq.QuadPart) * 1000000 +
+		(unsigned long long)(now.QuadPart % s_freq.QuadPart) * 1000000 / s_freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: InitInputQueue()
+//-----------------------------------------------------------------------------
+void InitInputQueue(INPUTQUEUE* q)
+{
+	for (unsigned int i = 0; i < INPUT_QUEUE_SIZE; i++)
+		q->cell[i].seq.store(i, std::memory_order_relaxed);
+	q->head.store(0, std::memory_order_relaxed);
+	q->tail.store(0, std::memory_order_relaxed);
+	q->dropped.store(0, std::memory_order_relaxed);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: PushInput()
+// Desc: A cell is free for position pos when its sequence equals pos; a
+//       smaller one means the consumer has not read it yet (the queue is
+//       full), a larger one that another producer took pos first.
+//-----------------------------------------------------------------------------
+bool PushInput(INPUTQUEUE* q, int command, float value)
+{
+	unsigned long long timeUs = InputClockUs();
+	unsigned int pos = q->head.load(std::memory_order_relaxed);
+	INPUTCELL* pCell;
+	for (;;) {
+		pCell = &q->cell[pos & (INPUT_QUEUE_SIZE - 1)];
+		int diff = (int)(pCell->seq.load(std::memory_order_acquire) - pos);
+		if (diff == 0) {
+			if (q->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0) {
+			q->dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else
+			pos = q->head.load(std::memory_order_relaxed);
+	}
+
+	pCell->event.command = command;
+	pCell->event.value = value;
+	pCell->event.timeUs = timeUs;
+	pCell->seq.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+
+bool PopInput(INPUTQUEUE* q, INPUTEVENT* pEvent)
+{
+	unsigned int pos = q->tail.load(std::memory_order_relaxed);
+	INPUTCELL* pCell = &q->cell[pos & (INPUT_QUEUE_SIZE - 1)];
+	if (pCell->seq.load(std::memory_order_acquire) != pos + 1)
+		return false;
+
+	*pEvent = pCell->event;
+	pCell->seq.store(pos + INPUT_QUEUE_SIZE, std::memory_order_release);
+	q->tail.store(pos + 1, std::memory_order_relaxed);
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: InitPlayControl() / PlayControlTime()
+//-----------------------------------------------------------------------------
+void InitPlayControl(PLAYCONTROL* c, ANIMTICK time, unsigned long long clockMs, double speed)
+{
+	c->base = time;
+	c->baseClock = clockMs;
+	c->speed = speed;
+	c->paused = false;
+}
+
+ANIMTICK PlayControlTime(const PLAYCONTROL* c, unsigned long long clockMs)
+{
+	if (c->paused || clockMs <= c->baseClock)
+		return c->base;
+	return c->base + (ANIMTICK)((clockMs - c->baseClock) * c->speed);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: DrainInput()
+// Desc: Applies the queued inputs in the order they arrived. Each one first
+//       moves the base to the present, so what was played so far is kept.
+//       Skip moves the base to the end of the current phase; AnimUpdate then
+//       steps there as usual, placing every stamp on the way, so a skipped
+//       animation looks exactly like one that was waited for. Restart is
+//       applied to the state at once and keeps the time running.
+//-----------------------------------------------------------------------------
+int DrainInput(INPUTQUEUE* q, PLAYCONTROL* c, ANIMSTATE* a, unsigned long long clockMs, INPUTFRAME* pFrame)
+{
+	int count = 0;
+	INPUTEVENT e;
+	while (PopInput(q, &e)) {
+		ANIMTICK now = PlayControlTime(c, clockMs);
+		c->base = now;
+		c->baseClock = clockMs;
+
+		switch (e.command) {
+		case INPUT_SKIP:
+			if (a != NULL) {
+				ANIMTICK end = AnimPhaseEnd(a);
+				if (end > c->base)
+					c->base = end;
+			}
+			break;
+		case INPUT_RESTART:
+			if (a != NULL)
+				AnimRestart(a);
+			break;
+		case INPUT_PAUSE:
+			c->paused = !c->paused;
+			break;
+		case INPUT_SPEED:
+			//̒l NaN  0 (~܂)
+			c->speed = e.value >= 0 ? (e.value < INPUT_SPEED_MAX ? e.value : INPUT_SPEED_MAX) : 0.0;
+			break;
+		default:
+			continue;
+		}
+
+		if (pFrame->count == 0 || e.timeUs < pFrame->firstUs)
+			pFrame->firstUs = e.timeUs;
+		pFrame->count++;
+		pFrame->sumUs += e.timeUs;
+		count++;
+	}
+	return count;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RecordInputLatency()
+//-----------------------------------------------------------------------------
+void RecordInputLatency(INPUTSTATS* pStats, INPUTFRAME* pFrame, unsigned long long nowUs)
+{
+	if (pFrame->count == 0)
+		return;
+	pStats->count += pFrame->count;
+	pStats->sumUs += (unsigned long long)pFrame->count * nowUs - pFrame->sumUs;
+	if (nowUs - pFrame->firstUs > pStats->maxUs)
+		pStats->maxUs = nowUs - pFrame->firstUs;
+	memset(pFrame, 0, sizeof(INPUTFRAME));
+}
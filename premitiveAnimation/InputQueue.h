@@ -0,0 +1,96 @@
+//-----------------------------------------------------------------------------
+// File: InputQueue.h
+//
+// Desc: Operator controls (skip, restart, pause, speed). The thread that
+//       receives an input (the window, or whoever calls the core) stamps it
+//       with a microsecond clock and pushes it into a bounded lock-free
+//       queue; the simulation drains the queue once per frame, just before
+//       it takes the frame's time, so every input lands on a frame boundary
+//       and the steps in between stay the same as without input.
+//
+//       The time of the animation is no longer a plain scale of the clock.
+//       PLAYCONTROL keeps the animation time and clock of the last change
+//       and the speed since then; pause, speed and skip only move that base.
+//
+//       The frame that applied inputs carries their stamps to the point
+//       where it is shown, which gives the input-to-photon latency.
+//-----------------------------------------------------------------------------
+#pragma once
+#include "AnimSim.h"
+#include <atomic>
+
+
+#define INPUT_QUEUE_SIZE 64   // 2 ׂ̂BtȂV͂̂Ă
+#define INPUT_SPEED_MAX 64.0
+
+enum INPUTCOMMAND
+{
+	INPUT_SKIP,     // ̒iK (Ă / Ƃ̑҂) ̏I܂Ői߂
+	INPUT_RESTART,  // ŏ蒼
+	INPUT_PAUSE,    // ꎞ~ƍĊJ؂ւ
+	INPUT_SPEED,    // Đx value ɂ
+	INPUT_COMMAND_NUM
+};
+
+struct INPUTEVENT
+{
+	int command;                // INPUTCOMMAND
+	float value;
+	unsigned long long timeUs;  // ͂󂯎 (InputClockUs)
+};
+
+struct INPUTCELL
+{
+	std::atomic<unsigned int> seq;  // I pos + 1, ǂݏI pos + INPUT_QUEUE_SIZE
+	INPUTEVENT event;
+};
+
+// ̂͂ǂ̃Xbhł悢Bô 1 ̃Xbh
+struct INPUTQUEUE
+{
+	INPUTCELL cell[INPUT_QUEUE_SIZE];
+	std::atomic<unsigned int> head;     // ɓʒu
+	std::atomic<unsigned int> tail;     // Ɏoʒu
+	std::atomic<unsigned int> dropped;  // tŎ̂Ă
+};
+
+// Aj[V̎ = base + (v - baseClock) * speed (~߂ĂԂ base)
+struct PLAYCONTROL
+{
+	ANIMTICK base;
+	unsigned long long baseClock;  // [ms]
+	double speed;
+	bool paused;
+};
+
+// 1 t[Ŕf (`܂ŉ^Œxɂ)
+struct INPUTFRAME
+{
+	unsigned int count;
+	unsigned long long sumUs;    // 󂯎̍v
+	unsigned long long firstUs;  // ԌÂ͂̎
+};
+
+struct INPUTSTATS
+{
+	unsigned int count;  // \܂œ͂
+	unsigned long long sumUs;
+	unsigned long long maxUs;
+};
+
+
+unsigned long long InputClockUs();
+
+void InitInputQueue(INPUTQUEUE* q);
+// ̎tēBtȂ false
+bool PushInput(INPUTQUEUE* q, int command, float value);
+bool PopInput(INPUTQUEUE* q, INPUTEVENT* pEvent);
+
+void InitPlayControl(PLAYCONTROL* c, ANIMTICK time, unsigned long long clockMs, double speed);
+ANIMTICK PlayControlTime(const PLAYCONTROL* c, unsigned long long clockMs);
+
+// ҂Ăׂ͂Ĕf, pFrame ɑBa  NULL (Cxg̍Đ) Ȃ
+// ̑ (ꎞ~Ƒx) 𔽉fBfԂ
+int DrainInput(INPUTQUEUE* q, PLAYCONTROL* c, ANIMSTATE* a, unsigned long long clockMs, INPUTFRAME* pFrame);
+// t[\ nowUs , ̃t[̓͂̒x𑫂 pFrame ɂ
+void RecordInputLatency(INPUTSTATS* pStats, INPUTFRAME* pFrame, unsigned long long nowUs);
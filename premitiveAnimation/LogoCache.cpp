@@ -0,0 +1,748 @@
+//-----------------------------------------------------------------------------
+// File: LogoCache.cpp
+//
+// Desc: See LogoCache.h. A layer is baked by seeking a private state to the
+//       end of the first loop and drawing it with the software rasterizer.
+//       It is written to a temporary file that is then renamed, so a player
+//       opening the cache never maps a half-written layer; when two players
+//       bake the same layer at once, the last rename wins with the same
+//       bytes.
+//
+//       The distance field is measured on a mask of the stamps drawn at
+//       LOGOSDF_BAKE_SCALE times its size, with the exact Euclidean
+//       distance transform (two passes of the lower envelope of parabolas),
+//       once towards the stamps and once towards the background. Each texel
+//       is the mean of its block of mask pixels.
+//-----------------------------------------------------------------------------
+#include "LogoCache.h"
+#include "AnimRaster.h"
+#include "MemStats.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LOGO_SSE2
+#endif
+
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#define LOGO_BACKGROUND 0xFF000000  // RasterClear ̐F
+#define SDF_EDGE 127.5f
+#define SDF_FAR 1e20                // ϊŁu܂Ȃv
+
+// wb_[ƃf[^Bʑt@C, oȂƂ̓q[v
+struct CACHEDATA
+{
+	const void* pData;
+	size_t size;
+	void* pView;
+	void* pHeap;
+};
+
+static std::atomic<unsigned int> s_tempSerial(0);  // ꎞt@C̖OXbhƂɕ
+
+struct LOGOLAYER
+{
+	CACHEDATA data;
+};
+
+struct LOGOSDF
+{
+	CACHEDATA data;
+};
+
+// ǂ̃wb_[擪͂̕
+struct CACHEHEADER
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+};
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: Fnv1a()
+//-----------------------------------------------------------------------------
+static uint64_t Fnv1a(uint64_t hash, const void* pData, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)pData;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: LogoLayerKey(), LogoSdfKey()
+//-----------------------------------------------------------------------------
+uint64_t LogoLayerKey(const SCENEPARAM* pScene, const MESH* pCube, const MESH* pSquare, int width, int height)
+{
+	MESHKEY cube = pCube != NULL ? pCube->key : DefaultMeshKey(MESH_CUBE);
+	MESHKEY square = pSquare != NULL ? pSquare->key : DefaultMeshKey(MESH_SQUARE);
+	uint32_t version = LOGOLAYER_VERSION;
+	int32_t size[2] = { width, height };
+
+	uint64_t hash = FNV_OFFSET;
+	hash = Fnv1a(hash, &version, sizeof(version));
+	hash = Fnv1a(hash, pScene, sizeof(SCENEPARAM));
+	hash = Fnv1a(hash, &cube, sizeof(cube));
+	hash = Fnv1a(hash, &square, sizeof(square));
+	return Fnv1a(hash, size, sizeof(size));
+}
+
+
+uint64_t LogoSdfKey(const SCENEPARAM* pScene, const MESH* pSquare, int width, int height)
+{
+	//L[u͎cĂȂ̂Ŏlp`̌`
+	MESHKEY square = pSquare != NULL ? pSquare->key : DefaultMeshKey(MESH_SQUARE);
+	uint32_t version[2] = { LOGOSDF_MAGIC, LOGOSDF_VERSION };
+	int32_t size[2] = { width, height };
+
+	uint64_t hash = FNV_OFFSET;
+	hash = Fnv1a(hash, version, sizeof(version));
+	hash = Fnv1a(hash, pScene, sizeof(SCENEPARAM));
+	hash = Fnv1a(hash, &square, sizeof(square));
+	return Fnv1a(hash, size, sizeof(size));
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: LogoStampHash()
+//-----------------------------------------------------------------------------
+uint64_t LogoStampHash(const ANIMSTATE* a)
+{
+	return Fnv1a(FNV_OFFSET, a->stamp, a->stampCount * sizeof(ANIMSTAMP));
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: CachePath()
+//-----------------------------------------------------------------------------
+static bool CachePath(char* pPath, size_t size, const char* pDir, uint64_t key, const char* pSuffix)
+{
+	size_t len = strlen(pDir);
+	const char* pSep = (len == 0 || pDir[len - 1] == '/' || pDir[len - 1] == '\\') ? "" : "/";
+	int n = snprintf(pPath, size, "%s%slogo_%016llx%s", pDir, pSep, (unsigned long long)key, pSuffix);
+	return n > 0 && (size_t)n < size;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: FreeCache()
+//-----------------------------------------------------------------------------
+static void FreeCache(CACHEDATA* c)
+{
+	if (c->pView != NULL) {
+#if defined(_WIN32)
+		UnmapViewOfFile(c->pView);
+#else
+		munmap(c->pView, c->size);
+#endif
+	}
+	if (c->pHeap != NULL) {
+		MemStatAdd(MEMSYS_FRAMEBUFFER, -(long long)c->size);
+		free(c->pHeap);
+	}
+	memset(c, 0, sizeof(*c));
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: MapCache()
+// Desc: Maps the file read-only and checks its size and header. The view
+//       stays valid after the handles are closed.
+//-----------------------------------------------------------------------------
+static bool MapCache(const char* pPath, size_t size, uint32_t magic, uint32_t version, uint64_t key, CACHEDATA* pOut)
+{
+	void* pView = NULL;
+	size_t fileSize = 0;
+#if defined(_WIN32)
+	wchar_t path[1024];
+	if (MultiByteToWideChar(CP_UTF8, 0, pPath, -1, path, 1024) == 0)
+		return false;
+	//O̕ύXŒu悤폜L
+	HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER li;
+	if (GetFileSizeEx(hFile, &li) && li.QuadPart > (LONGLONG)sizeof(CACHEHEADER)) {
+		HANDLE hMap = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMap != NULL) {
+			pView = MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+			fileSize = (size_t)li.QuadPart;
+			CloseHandle(hMap);
+		}
+	}
+	CloseHandle(hFile);
+#else
+	int fd = open(pPath, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > (off_t)sizeof(CACHEHEADER)) {
+		pView = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (pView == MAP_FAILED)
+			pView = NULL;
+		fileSize = (size_t)st.st_size;
+	}
+	close(fd);
+#endif
+	if (pView == NULL)
+		return false;
+
+	memset(pOut, 0, sizeof(*pOut));
+	pOut->pData = pView;
+	pOut->size = fileSize;
+	pOut->pView = pView;
+	const CACHEHEADER* h = (const CACHEHEADER*)pView;
+	if (fileSize != size || h->magic != magic || h->version != version || h->key != key) {
+		FreeCache(pOut);
+		return false;
+	}
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: WriteCache()
+// Desc: Writes the data under a temporary name and renames it into place
+//-----------------------------------------------------------------------------
+static bool WriteCache(const char* pPath, const char* pTemp, const void* pData, size_t size)
+{
+#if defined(_WIN32)
+	wchar_t path[1024], temp[1024];
+	if (MultiByteToWideChar(CP_UTF8, 0, pPath, -1, path, 1024) == 0 ||
+		MultiByteToWideChar(CP_UTF8, 0, pTemp, -1, temp, 1024) == 0)
+		return false;
+	FILE* fp;
+	if (_wfopen_s(&fp, temp, L"wb") != 0)
+		fp = NULL;
+#else
+	FILE* fp = fopen(pTemp, "wb");
+#endif
+	if (fp == NULL)
+		return false;
+	bool ok = (fwrite(pData, size, 1, fp) == 1);
+	ok = (fclose(fp) == 0) && ok;
+#if defined(_WIN32)
+	//uȂ (ʂ̃v[[JĂ) g
+	if (!ok || !MoveFileExW(temp, path, MOVEFILE_REPLACE_EXISTING)) {
+		DeleteFileW(temp);
+		return false;
+	}
+#else
+	if (!ok || rename(pTemp, pPath) != 0) {
+		remove(pTemp);
+		return false;
+	}
+#endif
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: KeepCache()
+// Desc: Stores freshly baked data (header + body in pData) in the directory
+//       and maps the file; without a directory, or when the file cannot be
+//       written or read back, the heap copy is kept instead
+//-----------------------------------------------------------------------------
+static void KeepCache(const char* pPath, const char* pDir, void* pData, size_t size, CACHEDATA* pOut)
+{
+	const CACHEHEADER* h = (const CACHEHEADER*)pData;
+	if (pPath != NULL) {
+		//fBNgɏvZXXbhǂŖOdȂȂ悤ɂ
+#if defined(_WIN32)
+		unsigned long pid = GetCurrentProcessId();
+#else
+		unsigned long pid = (unsigned long)getpid();
+#endif
+		char suffix[32], temp[1024];
+		snprintf(suffix, sizeof(suffix), ".%lu.%u.tmp", pid, s_tempSerial.fetch_add(1, std::memory_order_relaxed));
+		if (CachePath(temp, sizeof(temp), pDir, h->key, suffix))
+			WriteCache(pPath, temp, pData, size);
+		if (MapCache(pPath, size, h->magic, h->version, h->key, pOut)) {
+			free(pData);
+			return;
+		}
+	}
+	memset(pOut, 0, sizeof(*pOut));
+	pOut->pData = pData;
+	pOut->size = size;
+	pOut->pHeap = pData;
+	MemStatAdd(MEMSYS_FRAMEBUFFER, (long long)size);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: FinalState() / FreeFinalState()
+// Desc: A fresh run of the scene at the moment the logo is complete
+//-----------------------------------------------------------------------------
+static void FreeFinalState(ANIMSTATE* a)
+{
+	if (a != NULL)
+		AnimFree(a);
+	free(a);
+}
+
+static ANIMSTATE* FinalState(const SCENEPARAM* pScene)
+{
+	ANIMSTATE* a = (ANIMSTATE*)calloc(1, sizeof(ANIMSTATE));
+	if (a == NULL)
+		return NULL;
+	if (!AnimInit(a, pScene, 0) || !AnimSeekEnd(a)) {
+		FreeFinalState(a);
+		return NULL;
+	}
+	return a;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: BakeLayer()
+// Desc: Draws the finished logo into header + pixels
+//-----------------------------------------------------------------------------
+static void* BakeLayer(const SCENEPARAM* pScene, const MESH* pCube, const MESH* pSquare,
+	int width, int height, uint64_t key, size_t size)
+{
+	ANIMSTATE* a = FinalState(pScene);
+	float* pDepth = (float*)malloc((size_t)width * height * sizeof(float));
+	unsigned char* pData = (unsigned char*)malloc(size);
+	bool ok = (a != NULL && pDepth != NULL && pData != NULL);
+	if (ok) {
+		LOGOLAYERHEADER* h = (LOGOLAYERHEADER*)pData;
+		memset(h, 0, sizeof(*h));
+		h->magic = LOGOLAYER_MAGIC;
+		h->version = LOGOLAYER_VERSION;
+		h->key = key;
+		h->stampHash = LogoStampHash(a);
+		h->width = width;
+		h->height = height;
+		h->stampCount = (uint32_t)a->stampCount;
+
+		//AnimCore Ɠݒŕ`
+		RASTERTARGET target;
+		target.pColor = (unsigned int*)(h + 1);
+		target.pitch = width;
+		target.pDepth = pDepth;
+		target.width = width;
+		target.height = height;
+		target.gouraud = false;
+		target.pCube = pCube;
+		target.pSquare = pSquare;
+		RasterDrawScene(a, &target);
+	}
+	FreeFinalState(a);
+	free(pDepth);
+	if (!ok) {
+		free(pData);
+		return NULL;
+	}
+	return pData;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: OpenLogoLayer()
+//-----------------------------------------------------------------------------
+LOGOLAYER* OpenLogoLayer(const char* pDir, const SCENEPARAM* pScene,
+	const MESH* pCube, const MESH* pSquare, int width, int height)
+{
+	if (pScene == NULL || width <= 0 || height <= 0)
+		return NULL;
+	LOGOLAYER* pLayer = (LOGOLAYER*)calloc(1, sizeof(LOGOLAYER));
+	if (pLayer == NULL)
+		return NULL;
+	uint64_t key = LogoLayerKey(pScene, pCube, pSquare, width, height);
+	size_t size = sizeof(LOGOLAYERHEADER) + (size_t)width * height * 4;
+
+	char path[1024];
+	bool cached = (pDir != NULL && CachePath(path, sizeof(path), pDir, key, ".bin"));
+	if (cached && MapCache(path, size, LOGOLAYER_MAGIC, LOGOLAYER_VERSION, key, &pLayer->data))
+		return pLayer;
+
+	void* pData = BakeLayer(pScene, pCube, pSquare, width, height, key, size);
+	if (pData == NULL) {
+		free(pLayer);
+		return NULL;
+	}
+	KeepCache(cached ? path : NULL, pDir, pData, size, &pLayer->data);
+	return pLayer;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: CloseLogoLayer()
+//-----------------------------------------------------------------------------
+void CloseLogoLayer(LOGOLAYER* pLayer)
+{
+	if (pLayer == NULL)
+		return;
+	FreeCache(&pLayer->data);
+	free(pLayer);
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: LogoLayerHeader(), LogoLayerPixels()
+//-----------------------------------------------------------------------------
+const LOGOLAYERHEADER* LogoLayerHeader(const LOGOLAYER* pLayer)
+{
+	return (const LOGOLAYERHEADER*)pLayer->data.pData;
+}
+
+
+const unsigned int* LogoLayerPixels(const LOGOLAYER* pLayer)
+{
+	return (const unsigned int*)(LogoLayerHeader(pLayer) + 1);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: DistanceLine()
+// Desc: 1D squared distance transform of f (n samples, stride apart):
+//       d[q] = min over p of (q - p)^2 + f[p]. v and z hold the parabolas of
+//       the lower envelope and their boundaries (n and n + 1 entries).
+//-----------------------------------------------------------------------------
+static void DistanceLine(float* pData, int n, size_t stride, double* f, int* v, double* z)
+{
+	for (int q = 0; q < n; q++)
+		f[q] = pData[q * stride];
+
+	int k = 0;
+	v[0] = 0;
+	z[0] = -DBL_MAX;
+	z[1] = DBL_MAX;
+	for (int q = 1; q < n; q++) {
+		//q ̕ɉB̂O (z[0]  -DBL_MAX Ȃ̂ k  0 Ŏ~܂)
+		double s;
+		for (;;) {
+			int p = v[k];
+			s = ((f[q] + (double)q * q) - (f[p] + (double)p * p)) / (2.0 * (q - p));
+			if (s > z[k])
+				break;
+			k--;
+		}
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = DBL_MAX;
+	}
+
+	k = 0;
+	for (int q = 0; q < n; q++) {
+		while (z[k + 1] < q)
+			k++;
+		double d = (double)(q - v[k]) * (q - v[k]) + f[v[k]];
+		pData[q * stride] = (float)(d < SDF_FAR ? d : SDF_FAR);
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: DistanceField()
+// Desc: Squared distance of every mask pixel to the nearest pixel whose
+//       mask equals site
+//-----------------------------------------------------------------------------
+static bool DistanceField(const unsigned char* pMask, bool site, int width, int height, float* pOut)
+{
+	int n = width > height ? width : height;
+	double* f = (double*)malloc(n * sizeof(double));
+	double* z = (double*)malloc((n + 1) * sizeof(double));
+	int* v = (int*)malloc(n * sizeof(int));
+	bool ok = (f != NULL && z != NULL && v != NULL);
+	if (ok) {
+		size_t count = (size_t)width * height;
+		for (size_t i = 0; i < count; i++)
+			pOut[i] = ((pMask[i] != 0) == site) ? 0.0f : (float)SDF_FAR;
+		for (int y = 0; y < height; y++)
+			DistanceLine(pOut + (size_t)y * width, width, 1, f, v, z);
+		for (int x = 0; x < width; x++)
+			DistanceLine(pOut + x, height, width, f, v, z);
+	}
+	free(f);
+	free(z);
+	free(v);
+	return ok;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: BakeSdf()
+// Desc: Draws the stamps into a mask, measures both distance fields and
+//       packs the signed distance (inside positive) into header + texels
+//-----------------------------------------------------------------------------
+static void* BakeSdf(const SCENEPARAM* pScene, const MESH* pSquare, int width, int height, uint64_t key, size_t size)
+{
+	const int scale = LOGOSDF_BAKE_SCALE;
+	int mw = width * scale, mh = height * scale;
+	size_t count = (size_t)mw * mh;
+	ANIMSTATE* a = FinalState(pScene);
+	unsigned int* pColor = (unsigned int*)malloc(count * sizeof(unsigned int));
+	float* pDepth = (float*)malloc(count * sizeof(float));
+	unsigned char* pMask = (unsigned char*)malloc(count);
+	unsigned char* pData = (unsigned char*)malloc(size);
+	bool ok = (a != NULL && pColor != NULL && pDepth != NULL && pMask != NULL && pData != NULL);
+
+	LOGOSDFHEADER* h = (LOGOSDFHEADER*)pData;
+	if (ok) {
+		RASTERTARGET target;
+		target.pColor = pColor;
+		target.pitch = mw;
+		target.pDepth = pDepth;
+		target.width = mw;
+		target.height = mh;
+		target.gouraud = false;
+		target.pCube = NULL;
+		target.pSquare = pSquare;
+		RasterClear(&target);
+		RasterDrawStamps(a, &target);
+
+		//lp`͂ǂ̖ʂȂ̂ 1 F
+		memset(h, 0, sizeof(*h));
+		h->color = LOGO_BACKGROUND;
+		for (size_t i = 0; i < count; i++) {
+			pMask[i] = (pColor[i] != LOGO_BACKGROUND);
+			if (pMask[i] && h->color == LOGO_BACKGROUND)
+				h->color = pColor[i];
+		}
+		//FƐ[x̃obt@͋Ɏg
+		ok = DistanceField(pMask, true, mw, mh, (float*)pColor) &&
+			DistanceField(pMask, false, mw, mh, pDepth);
+	}
+	if (ok) {
+		h->magic = LOGOSDF_MAGIC;
+		h->version = LOGOSDF_VERSION;
+		h->key = key;
+		h->stampHash = LogoStampHash(a);
+		h->width = width;
+		h->height = height;
+		h->stampCount = (uint32_t)a->stampCount;
+
+		//f̒Sǂ̋Ȃ̂, E܂ł 0.5 
+		const float* pToInside = (const float*)pColor;
+		const float* pToOutside = pDepth;
+		unsigned char* pTexel = (unsigned char*)(h + 1);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				float sum = 0;
+				for (int j = 0; j < scale; j++) {
+					size_t i = (size_t)(y * scale + j) * mw + x * scale;
+					for (int k = 0; k < scale; k++, i++)
+						sum += pMask[i] ? sqrtf(pToOutside[i]) - 0.5f : 0.5f - sqrtf(pToInside[i]);
+				}
+				float d = sum / (scale * scale) / scale;  // texel P
+				float t = SDF_EDGE + d * (SDF_EDGE / LOGOSDF_SPREAD);
+				pTexel[(size_t)y * width + x] = (unsigned char)(t < 0 ? 0 : (t > 255 ? 255 : t + 0.5f));
+			}
+		}
+	}
+	FreeFinalState(a);
+	free(pColor);
+	free(pDepth);
+	free(pMask);
+	if (!ok) {
+		free(pData);
+		return NULL;
+	}
+	return pData;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: OpenLogoSdf()
+//-----------------------------------------------------------------------------
+LOGOSDF* OpenLogoSdf(const char* pDir, const SCENEPARAM* pScene, const MESH* pSquare, int width, int height)
+{
+	if (pScene == NULL || width <= 0 || height <= 0)
+		return NULL;
+	LOGOSDF* pSdf = (LOGOSDF*)calloc(1, sizeof(LOGOSDF));
+	if (pSdf == NULL)
+		return NULL;
+	uint64_t key = LogoSdfKey(pScene, pSquare, width, height);
+	size_t size = sizeof(LOGOSDFHEADER) + (size_t)width * height;
+
+	char path[1024];
+	bool cached = (pDir != NULL && CachePath(path, sizeof(path), pDir, key, ".sdf"));
+	if (cached && MapCache(path, size, LOGOSDF_MAGIC, LOGOSDF_VERSION, key, &pSdf->data))
+		return pSdf;
+
+	void* pData = BakeSdf(pScene, pSquare, width, height, key, size);
+	if (pData == NULL) {
+		free(pSdf);
+		return NULL;
+	}
+	KeepCache(cached ? path : NULL, pDir, pData, size, &pSdf->data);
+	return pSdf;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: CloseLogoSdf()
+//-----------------------------------------------------------------------------
+void CloseLogoSdf(LOGOSDF* pSdf)
+{
+	if (pSdf == NULL)
+		return;
+	FreeCache(&pSdf->data);
+	free(pSdf);
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: LogoSdfHeader()
+//-----------------------------------------------------------------------------
+const LOGOSDFHEADER* LogoSdfHeader(const LOGOSDF* pSdf)
+{
+	return (const LOGOSDFHEADER*)pSdf->data.pData;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: FirstAtLeast()
+// Desc: First index of the non-decreasing table p whose value is >= value
+//-----------------------------------------------------------------------------
+static int FirstAtLeast(const int* p, int n, int value)
+{
+	int lo = 0, hi = n;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (p[mid] < value)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: DrawLogoSdf()
+// Desc: For each output row the two field rows around it are blended into
+//       one line (padded with background at both ends); the columns then
+//       blend two texels of that line by a per-column table and compare
+//       with the edge, four pixels at a time with SSE2. A pixel can only be
+//       inside if one of its texels is, so columns outside the span of
+//       inside texels of the line are filled with background directly.
+//
+//       The projection only scales x by 1 / aspect, so an output with a
+//       different aspect maps its x through the ratio of the two.
+//-----------------------------------------------------------------------------
+bool DrawLogoSdf(const LOGOSDF* pSdf, unsigned int* pColor, int pitch, int width, int height)
+{
+	const LOGOSDFHEADER* h = LogoSdfHeader(pSdf);
+	const unsigned char* pTexel = (const unsigned char*)(h + 1);
+	int sw = h->width, sh = h->height;
+	int* pX = (int*)malloc(width * sizeof(int));
+	float* pF = (float*)malloc(width * sizeof(float));
+	float* pLine = (float*)malloc((sw + 2) * sizeof(float));
+	if (pX == NULL || pF == NULL || pLine == NULL) {
+		free(pX);
+		free(pF);
+		free(pLine);
+		return false;
+	}
+
+	//񂲂Ƃ̋̈ʒuBpLine ̓Y 1 Ă, 0  sw + 1 ͊O
+	float ratio = ((float)width / height) / ((float)sw / sh);
+	for (int x = 0; x < width; x++) {
+		float ndc = (2.0f * (x + 0.5f) / width - 1.0f) * ratio;
+		float u = (ndc + 1.0f) * 0.5f * sw - 0.5f;
+		u = u < -1.0f ? -1.0f : (u > (float)sw ? (float)sw : u);
+		int x0 = (int)floorf(u);
+		if (x0 > sw - 1)
+			x0 = sw - 1;
+		pX[x] = x0 + 1;
+		pF[x] = u - x0;
+	}
+	pLine[0] = 0;
+	pLine[sw + 1] = 0;
+
+	const unsigned int inside = h->color;
+	for (int y = 0; y < height; y++) {
+		float v = (y + 0.5f) * sh / height - 0.5f;
+		int y0 = (int)floorf(v);
+		float fy = v - y0;
+		const unsigned char* pRow0 = (y0 >= 0) ? pTexel + (size_t)y0 * sw : NULL;
+		const unsigned char* pRow1 = (y0 + 1 < sh) ? pTexel + (size_t)(y0 + 1) * sw : NULL;
+		int first = sw + 1, last = 0;  //  texel (pLine ̓Y)
+		for (int x = 0; x < sw; x++) {
+			float a = pRow0 != NULL ? pRow0[x] : 0.0f;
+			float b = pRow1 != NULL ? pRow1[x] : 0.0f;
+			float d = a + fy * (b - a);
+			pLine[x + 1] = d;
+			if (d >= SDF_EDGE) {
+				if (first > x + 1)
+					first = x + 1;
+				last = x + 1;
+			}
+		}
+
+		//pX[x] + 1  first ȏ pX[x]  last ȉ̗񂾂ׂ
+		unsigned int* pOut = pColor + (size_t)y * pitch;
+		int x = 0, end = 0;
+		if (last > 0) {
+			x = FirstAtLeast(pX, width, first - 1);
+			end = FirstAtLeast(pX, width, last + 1);
+		}
+		for (int i = 0; i < x; i++)
+			pOut[i] = LOGO_BACKGROUND;
+		for (int i = end; i < width; i++)
+			pOut[i] = LOGO_BACKGROUND;
+#if defined(LOGO_SSE2)
+		const __m128 edge = _mm_set1_ps(SDF_EDGE);
+		const __m128i in4 = _mm_set1_epi32((int)inside), out4 = _mm_set1_epi32((int)LOGO_BACKGROUND);
+		for (; x + 4 <= end; x += 4) {
+			const int* i = pX + x;
+			__m128 a = _mm_setr_ps(pLine[i[0]], pLine[i[1]], pLine[i[2]], pLine[i[3]]);
+			__m128 b = _mm_setr_ps(pLine[i[0] + 1], pLine[i[1] + 1], pLine[i[2] + 1], pLine[i[3] + 1]);
+			__m128 d = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(pF + x), _mm_sub_ps(b, a)));
+			__m128i m = _mm_castps_si128(_mm_cmpge_ps(d, edge));
+			_mm_storeu_si128((__m128i*)(pOut + x), _mm_or_si128(_mm_and_si128(m, in4), _mm_andnot_si128(m, out4)));
+		}
+#endif
+		for (; x < end; x++) {
+			float a = pLine[pX[x]], b = pLine[pX[x] + 1];
+			pOut[x] = (a + pF[x] * (b - a) >= SDF_EDGE) ? inside : LOGO_BACKGROUND;
+		}
+	}
+	free(pX);
+	free(pF);
+	free(pLine);
+	return true;
+}
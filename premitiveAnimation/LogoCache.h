@@ -0,0 +1,83 @@
+//-----------------------------------------------------------------------------
+// File: LogoCache.h
+//
+// Desc: Cache of the finished logo. The completed state of a scene (start
+//       squares, all stamps and the cubes at that moment) is drawn once per
+//       resolution into a layer and kept in a file named after a hash of
+//       everything the picture depends on (scene, mesh style, size). The
+//       file is memory-mapped, so a player that only needs the finished
+//       logo, or that restarts during the hold, copies the rows instead of
+//       simulating and drawing every stamp, and players on one machine
+//       share the pages.
+//
+//       For output at many resolutions the stamps can instead be baked once
+//       into a signed distance field. Any output size is then a bilinear
+//       lookup and a threshold per pixel. The field is 8 bit, so edges are
+//       exact to a fraction of a texel, but corners are rounded by about
+//       one texel; bake it at least a quarter of the largest output size.
+//
+//       Both are what a fresh run of the scene shows. Their headers keep a
+//       hash of the stamps, so a player whose history differs (a scene
+//       changed halfway) can tell the cache is not its picture.
+//-----------------------------------------------------------------------------
+#pragma once
+#include "AnimSim.h"
+#include "MeshCache.h"
+#include <stdint.h>
+
+
+#define LOGOLAYER_MAGIC 0x4C4C4B49  // "IKLL"
+#define LOGOLAYER_VERSION 1
+#define LOGOSDF_MAGIC 0x534C4B49    // "IKLS"
+#define LOGOSDF_VERSION 1
+#define LOGOSDF_SPREAD 4.0f         // 8bit ɋl߂鋗̕ [texel]BE 127.5
+#define LOGOSDF_BAKE_SCALE 2        // 𑪂}XN͋̉{ŕ`
+
+// t@C̐擪B̂Ƃ width * height  X8R8G8B8 
+struct LOGOLAYERHEADER
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;        // LogoLayerKey
+	uint64_t stampHash;  // LogoStampHash
+	int32_t width, height;
+	uint32_t stampCount;
+	uint32_t reserved;
+};
+
+// t@C̐擪B̂Ƃ width * height ̋ (unsigned char, قǑ傫) 
+struct LOGOSDFHEADER
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;        // LogoSdfKey
+	uint64_t stampHash;
+	int32_t width, height;  // width / height Ăʂ̏c
+	uint32_t stampCount;
+	uint32_t color;         // lp`̐F (X8R8G8B8)
+};
+
+struct LOGOLAYER;
+struct LOGOSDF;
+
+
+// pCube, pSquare  NULL Ȃ AnimMesh.h ̕\g
+uint64_t LogoLayerKey(const SCENEPARAM* pScene, const MESH* pCube, const MESH* pSquare, int width, int height);
+uint64_t LogoSdfKey(const SCENEPARAM* pScene, const MESH* pSquare, int width, int height);
+uint64_t LogoStampHash(const ANIMSTATE* a);
+
+// pDir (UTF-8) ɓL[̃t@CΎʑ, ȂΕ`ďoB
+// pDir  NULL oȂƂ̓ɂB~܂ȂgbN NULL
+LOGOLAYER* OpenLogoLayer(const char* pDir, const SCENEPARAM* pScene,
+	const MESH* pCube, const MESH* pSquare, int width, int height);
+void CloseLogoLayer(LOGOLAYER* pLayer);
+const LOGOLAYERHEADER* LogoLayerHeader(const LOGOLAYER* pLayer);
+const unsigned int* LogoLayerPixels(const LOGOLAYER* pLayer);  // pitch  width
+
+// 悤Ƀt@CɒuBwidth x height ͋̑傫
+LOGOSDF* OpenLogoSdf(const char* pDir, const SCENEPARAM* pScene, const MESH* pSquare, int width, int height);
+void CloseLogoSdf(LOGOSDF* pSdf);
+const LOGOSDFHEADER* LogoSdfHeader(const LOGOSDF* pSdf);
+// lŐ؂ width x height ɕ` (pitch ̓sNZ)B
+// c䂪ĂƂƈႦ, Ăʂ̊O͔wiɂȂBobt@Ȃ false
+bool DrawLogoSdf(const LOGOSDF* pSdf, unsigned int* pColor, int pitch, int width, int height);
@@ -0,0 +1,84 @@
+//-----------------------------------------------------------------------------
+// File: MemStats.cpp
+//
+// Desc: See MemStats.h
+//-----------------------------------------------------------------------------
+#include "MemStats.h"
+#include <stdio.h>
+#include <atomic>
+
+
+const char* const g_memSysName[MEMSYS_NUM] =
+{
+	"stamps", "tracks", "vertex", "framebuffer", "cache", "export", "audio",
+};
+
+static std::atomic<long long> s_live[MEMSYS_NUM];
+static std::atomic<long long> s_peak[MEMSYS_NUM];
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: UpdatePeak()
+// Desc: Raises the high-water mark; other threads may be updating it too
+//-----------------------------------------------------------------------------
+static void UpdatePeak(MEMSYS sys, long long live)
+{
+	long long peak = s_peak[sys].load(std::memory_order_relaxed);
+	while (live > peak &&
+		!s_peak[sys].compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		;
+}
+
+
+void MemStatAdd(MEMSYS sys, long long bytes)
+{
+	long long live = s_live[sys].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	UpdatePeak(sys, live);
+}
+
+
+void MemStatSet(MEMSYS sys, long long bytes)
+{
+	s_live[sys].store(bytes, std::memory_order_relaxed);
+	UpdatePeak(sys, bytes);
+}
+
+
+void GetMemStats(MEMSTAT* pStats)
+{
+	for (int i = 0; i < MEMSYS_NUM; i++) {
+		pStats[i].live = s_live[i].load(std::memory_order_relaxed);
+		pStats[i].peak = s_peak[i].load(std::memory_order_relaxed);
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: FormatMemStats()
+// Desc: One line per subsystem plus the total, sizes in bytes
+//-----------------------------------------------------------------------------
+int FormatMemStats(char* pBuf, size_t size)
+{
+	MEMSTAT stats[MEMSYS_NUM];
+	GetMemStats(stats);
+
+	long long live = 0, peak = 0;
+	int n = snprintf(pBuf, size, "%-12s %14s %14s\n", "subsystem", "live", "peak");
+	for (int i = 0; i < MEMSYS_NUM; i++) {
+		if (n >= 0 && (size_t)n < size)
+			n += snprintf(pBuf + n, size - n, "%-12s %14lld %14lld\n",
+				g_memSysName[i], stats[i].live, stats[i].peak);
+		live += stats[i].live;
+		peak += stats[i].peak;
+	}
+	//v̍ől͊eől̘a (ɍőɂȂƂ͌Ȃ)
+	if (n >= 0 && (size_t)n < size)
+		n += snprintf(pBuf + n, size - n, "%-12s %14lld %14lld\n", "total", live, peak);
+	if (n < 0)
+		return 0;
+	return (size_t)n < size ? n : (int)size - 1;
+}
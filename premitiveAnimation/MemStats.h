@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// File: MemStats.h
+//
+// Desc: Memory accounting per subsystem. Every owner reports its allocations
+//       here, and the live byte count and the high-water mark of each
+//       subsystem can be queried at any time, from any thread.
+//-----------------------------------------------------------------------------
+#pragma once
+#include <stddef.h>
+
+
+enum MEMSYS
+{
+	MEMSYS_STAMPS,       // uꂽlp`
+	MEMSYS_TRACKS,       // gbN̏
+	MEMSYS_VERTEX,       // _obt@
+	MEMSYS_FRAMEBUFFER,  // obNobt@, Lv`, YUV t[
+	MEMSYS_CACHE,        // ǂݍ񂾂܂ܔf҂̃f[^
+	MEMSYS_EXPORT,       // õobt@
+	MEMSYS_AUDIO,        // ̔g`ƃ~LT[
+	MEMSYS_NUM
+};
+
+struct MEMSTAT
+{
+	long long live;  // ݂̃oCg
+	long long peak;  // ő̃oCg
+};
+
+
+extern const char* const g_memSysName[MEMSYS_NUM];
+
+// mۂ琳, 畉̃oCgn
+void MemStatAdd(MEMSYS sys, long long bytes);
+// ŒTCY̓ꕨ̎gpʂ̂܂ܐݒ肷
+void MemStatSet(MEMSYS sys, long long bytes);
+void GetMemStats(MEMSTAT* pStats);  // MEMSYS_NUM 
+
+// \`̃eLXgɂBԂ
+int FormatMemStats(char* pBuf, size_t size);
@@ -0,0 +1,307 @@
+//-----------------------------------------------------------------------------
+// File: MeshCache.cpp
+//
+// Desc: See MeshCache.h. A subdivided cube is six grids, one strip per row
+//       of quads; rows and faces are joined by repeating the last and the
+//       next vertex, which adds two empty triangles and keeps every row
+//       starting on an even vertex so the winding does not flip. The bevel
+//       moves the vertices of the outermost rows onto a rounded box.
+//-----------------------------------------------------------------------------
+#include "MeshCache.h"
+#include "MemStats.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+
+
+#define MESH_CACHE_MAX 32
+
+struct MESHENTRY
+{
+	MESH mesh;
+	int refCount;                        // 0 Ȃ
+	ANIMVERTEX* pBuf[MESH_LOD_MAX];
+	size_t bytes;
+};
+
+static MESHENTRY s_entry[MESH_CACHE_MAX];
+static std::mutex s_lock;
+
+// L[u̖: O̎ƌ, ʂ̒ u, v  (u x v ɂȂ̂ D3D ̕\)
+static const struct { int axis, sign, u, v; } s_face[6] =
+{
+	{ 2, -1, 0, 1 }, { 2, 1, 1, 0 },
+	{ 0, -1, 1, 2 }, { 0, 1, 2, 1 },
+	{ 1, -1, 2, 0 }, { 1, 1, 0, 2 },
+};
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: DefaultMeshKey()
+//-----------------------------------------------------------------------------
+MESHKEY DefaultMeshKey(int type)
+{
+	MESHKEY key = { type, ANIM_CUBE_LEN, 0, 1 };
+	return key;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: NormalizeKey()
+// Desc: Clamps the parameters so that equal meshes get equal keys. The
+//       square is flat, so all cube styles of one size share it.
+//-----------------------------------------------------------------------------
+static MESHKEY NormalizeKey(const MESHKEY* pKey)
+{
+	MESHKEY key;
+	memset(&key, 0, sizeof(key));  // Ԃ 0 ɂ memcmp Ŕׂ
+	key.type = pKey->type;
+	key.size = pKey->size;
+	key.subdiv = pKey->subdiv < 1 ? 1 : (pKey->subdiv > MESH_SUBDIV_MAX ? MESH_SUBDIV_MAX : pKey->subdiv);
+	key.bevel = pKey->bevel < 0 ? 0 : (pKey->bevel > pKey->size ? pKey->size : pKey->bevel);
+	//2 ͕Ȗʂ邾Ȃ̂ŔƓɂ
+	if (key.type == MESH_SQUARE || key.subdiv < 3) {
+		key.subdiv = 1;
+		key.bevel = 0;
+	}
+	return key;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: GridCoord()
+// Desc: Coordinate of grid line i of n along one axis. With a bevel the
+//       first and last segment span the rounded edge.
+//-----------------------------------------------------------------------------
+static float GridCoord(int i, int n, float size, float bevel)
+{
+	if (i == 0)
+		return -size;
+	if (i == n)
+		return size;
+	if (bevel > 0) {
+		float inner = size - bevel;
+		return -inner + 2 * inner * (i - 1) / (n - 2);
+	}
+	return -size + 2 * size * i / n;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: CubeVertex()
+//-----------------------------------------------------------------------------
+static ANIMVERTEX CubeVertex(int face, int i, int j, int n, float size, float bevel)
+{
+	float p[3];
+	p[s_face[face].axis] = s_face[face].sign * size;
+	p[s_face[face].u] = GridCoord(i, n, size, bevel);
+	p[s_face[face].v] = GridCoord(j, n, size, bevel);
+
+	if (bevel > 0) {
+		//̔ԋ߂_Ɍ bevel ̋ɒu
+		float inner = size - bevel, d[3], len2 = 0;
+		for (int k = 0; k < 3; k++) {
+			float c = p[k] < -inner ? -inner : (p[k] > inner ? inner : p[k]);
+			d[k] = p[k] - c;
+			len2 += d[k] * d[k];
+		}
+		if (len2 > 0) {
+			float scale = bevel / sqrtf(len2) - 1;
+			for (int k = 0; k < 3; k++)
+				p[k] += d[k] * scale;
+		}
+	}
+	ANIMVERTEX v = { p[0], p[1], p[2] };
+	return v;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: BuildCube()
+// Desc: Fills pOut (NULL to count only) and returns the vertex count
+//-----------------------------------------------------------------------------
+static int BuildCube(ANIMVERTEX* pOut, int n, float size, float bevel)
+{
+	int count = 0;
+	for (int face = 0; face < 6; face++) {
+		for (int j = 0; j < n; j++) {
+			//O̍sƂȂ (ʐ 0 ̎Op` 2 ł)
+			if (count > 0) {
+				if (pOut != NULL) {
+					pOut[count] = pOut[count - 1];
+					pOut[count + 1] = CubeVertex(face, 0, j, n, size, bevel);
+				}
+				count += 2;
+			}
+			for (int i = 0; i <= n; i++) {
+				if (pOut != NULL) {
+					pOut[count] = CubeVertex(face, i, j, n, size, bevel);
+					pOut[count + 1] = CubeVertex(face, i, j + 1, n, size, bevel);
+				}
+				count += 2;
+			}
+		}
+	}
+	return count;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: BuildLod()
+// Desc: Vertices of one level. Subdivision 1 is the hand-made table, scaled.
+//-----------------------------------------------------------------------------
+static ANIMVERTEX* BuildLod(const MESHKEY* pKey, int n, int* pCount)
+{
+	const ANIMVERTEX* pTable = NULL;
+	int count;
+	if (pKey->type == MESH_SQUARE) {
+		pTable = g_squareVertices;
+		count = ANIM_SQUARE_PRIMS + 2;
+	}
+	else if (n == 1) {
+		pTable = g_cubeVertices;
+		count = ANIM_CUBE_PRIMS + 2;
+	}
+	else {
+		count = BuildCube(NULL, n, pKey->size, pKey->bevel);
+	}
+
+	ANIMVERTEX* pBuf = (ANIMVERTEX*)malloc(count * sizeof(ANIMVERTEX));
+	if (pBuf == NULL)
+		return NULL;
+	if (pTable != NULL) {
+		float scale = pKey->size / ANIM_CUBE_LEN;
+		for (int i = 0; i < count; i++) {
+			pBuf[i].x = pTable[i].x * scale;
+			pBuf[i].y = pTable[i].y * scale;
+			pBuf[i].z = pTable[i].z * scale;
+		}
+	}
+	else {
+		BuildCube(pBuf, n, pKey->size, n >= 3 ? pKey->bevel : 0);
+	}
+	*pCount = count;
+	return pBuf;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: FreeEntry()
+//-----------------------------------------------------------------------------
+static void FreeEntry(MESHENTRY* e)
+{
+	for (int i = 0; i < MESH_LOD_MAX; i++) {
+		free(e->pBuf[i]);
+		e->pBuf[i] = NULL;
+	}
+	MemStatAdd(MEMSYS_VERTEX, -(long long)e->bytes);
+	e->bytes = 0;
+	e->refCount = 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AcquireMesh()
+// Desc: Looks the key up and builds the mesh on a miss. The levels halve the
+//       subdivision; the last one is always the plain box.
+//-----------------------------------------------------------------------------
+const MESH* AcquireMesh(const MESHKEY* pKey)
+{
+	if (pKey == NULL || pKey->type < 0 || pKey->type >= MESH_TYPE_NUM || !(pKey->size > 0))
+		return NULL;
+	MESHKEY key = NormalizeKey(pKey);
+
+	std::lock_guard<std::mutex> lock(s_lock);
+	MESHENTRY* pFree = NULL;
+	for (int i = 0; i < MESH_CACHE_MAX; i++) {
+		MESHENTRY* e = &s_entry[i];
+		if (e->refCount == 0) {
+			if (pFree == NULL)
+				pFree = e;
+		}
+		else if (memcmp(&e->mesh.key, &key, sizeof(key)) == 0) {
+			e->refCount++;
+			return &e->mesh;
+		}
+	}
+	if (pFree == NULL)
+		return NULL;
+
+	MESHENTRY* e = pFree;
+	memset(e, 0, sizeof(*e));
+	e->mesh.key = key;
+	int n = key.subdiv;
+	for (int level = 0; level < MESH_LOD_MAX; level++) {
+		if (level == MESH_LOD_MAX - 1 || n < 3)
+			n = 1;
+		MESHLOD* pLod = &e->mesh.lod[level];
+		e->pBuf[level] = BuildLod(&key, n, &pLod->vertexCount);
+		if (e->pBuf[level] == NULL) {
+			e->bytes = 0;  // ܂ MemStat ɑĂȂ
+			FreeEntry(e);
+			return NULL;
+		}
+		pLod->subdiv = n;
+		pLod->primCount = pLod->vertexCount - 2;
+		pLod->pVertices = e->pBuf[level];
+		e->bytes += pLod->vertexCount * sizeof(ANIMVERTEX);
+		e->mesh.lodCount++;
+		if (n == 1)
+			break;
+		n /= 2;
+	}
+	MemStatAdd(MEMSYS_VERTEX, (long long)e->bytes);
+	e->refCount = 1;
+	return &e->mesh;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ReleaseMesh()
+//-----------------------------------------------------------------------------
+void ReleaseMesh(const MESH* pMesh)
+{
+	if (pMesh == NULL)
+		return;
+	std::lock_guard<std::mutex> lock(s_lock);
+	MESHENTRY* e = (MESHENTRY*)((char*)pMesh - offsetof(MESHENTRY, mesh));
+	if (--e->refCount == 0)
+		FreeEntry(e);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: SelectMeshLod()
+// Desc: The finest level whose grid segments still cover
+//       MESH_LOD_SEGMENT_PX pixels on screen
+//-----------------------------------------------------------------------------
+int SelectMeshLod(const MESH* pMesh, float pixels)
+{
+	for (int i = 0; i < pMesh->lodCount - 1; i++) {
+		if (pixels >= pMesh->lod[i].subdiv * MESH_LOD_SEGMENT_PX)
+			return i;
+	}
+	return pMesh->lodCount - 1;
+}
@@ -0,0 +1,64 @@
+//-----------------------------------------------------------------------------
+// File: MeshCache.h
+//
+// Desc: Shared cache of the primitive meshes. A mesh is identified by its
+//       type and parameters (half size, bevel, subdivision) and is built the
+//       first time somebody asks for it; everyone asking for the same key
+//       gets the same mesh, so instances and styles that agree share one
+//       copy of the vertices. Each mesh comes with level-of-detail variants
+//       that halve the subdivision down to the plain box.
+//
+//       Meshes are triangle strips in the same winding as AnimMesh.h. The
+//       plain cube and square (subdivision 1, no bevel) are those tables.
+//       The cache may be used from several threads; a mesh does not change
+//       after it is built.
+//-----------------------------------------------------------------------------
+#pragma once
+#include "AnimMesh.h"
+
+
+#define MESH_LOD_MAX 4
+#define MESH_SUBDIV_MAX 16
+#define MESH_LOD_SEGMENT_PX 8.0f  // LOD IԂƂ, ʂ 1 ؂肪̃sNZ菬ȂȂ悤ɂ
+
+enum MESHTYPE
+{
+	MESH_CUBE,
+	MESH_SQUARE,  // ulp` (z = 0 ̖)
+	MESH_TYPE_NUM
+};
+
+struct MESHKEY
+{
+	int type;      // MESHTYPE
+	float size;    // ӂ̒̔ (܂ł ANIM_CUBE_LEN)
+	float bevel;   // ӂ̊ۂ (0 ȂpB 3 ȏŌ)
+	int subdiv;    // LOD 0  1 ӂ̕ (1 .. MESH_SUBDIV_MAXB2 ȉ͔)
+};
+
+struct MESHLOD
+{
+	int subdiv;
+	int vertexCount;
+	int primCount;  // vertexCount - 2
+	const ANIMVERTEX* pVertices;
+};
+
+struct MESH
+{
+	MESHKEY key;
+	int lodCount;
+	MESHLOD lod[MESH_LOD_MAX];  // [0] ԍׂ
+};
+
+
+// ܂ł̑傫̃L[uƎlp`̃L[
+MESHKEY DefaultMeshKey(int type);
+
+// L[Ȃ瓯 MESH Ԃ (QƂ 1 ₷)BȂ NULL
+const MESH* AcquireMesh(const MESHKEY* pKey);
+// Ō̎QƂȂȂ璸_
+void ReleaseMesh(const MESH* pMesh);
+
+// ʏŕ pixels ɌƂɎg LOD
+int SelectMeshLod(const MESH* pMesh, float pixels);
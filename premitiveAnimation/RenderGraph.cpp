@@ -0,0 +1,190 @@
+//-----------------------------------------------------------------------------
+// File: RenderGraph.cpp
+//
+// Desc: See RenderGraph.h. Passes are culled by walking backwards from the
+//       imported buffers. Transient buffers are placed largest first at the
+//       lowest offset that does not collide with an already placed buffer
+//       that is alive at the same time.
+//-----------------------------------------------------------------------------
+#include "RenderGraph.h"
+#include "MemStats.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+
+
+void RenderGraphInit(RENDERGRAPH* g)
+{
+	memset(g, 0, sizeof(*g));
+}
+
+
+void RenderGraphFree(RENDERGRAPH* g)
+{
+	if (g->pHeap != NULL)
+		MemStatAdd(MEMSYS_FRAMEBUFFER, -(long long)g->heapSize);
+	free(g->pHeap);
+	g->pHeap = NULL;
+	g->heapSize = 0;
+}
+
+
+void RenderGraphReset(RENDERGRAPH* g)
+{
+	g->passCount = 0;
+	g->resourceCount = 0;
+}
+
+
+
+
+int RenderGraphImport(RENDERGRAPH* g, const char* pName, void* pMemory)
+{
+	if (g->resourceCount >= RG_RESOURCE_MAX)
+		return -1;
+	RGRESOURCE* r = &g->res[g->resourceCount];
+	memset(r, 0, sizeof(*r));
+	r->pName = pName;
+	r->pMemory = pMemory;
+	r->imported = true;
+	return g->resourceCount++;
+}
+
+
+int RenderGraphCreate(RENDERGRAPH* g, const char* pName, size_t size)
+{
+	if (g->resourceCount >= RG_RESOURCE_MAX)
+		return -1;
+	RGRESOURCE* r = &g->res[g->resourceCount];
+	memset(r, 0, sizeof(*r));
+	r->pName = pName;
+	r->size = (size + RG_ALIGN - 1) & ~(size_t)(RG_ALIGN - 1);
+	return g->resourceCount++;
+}
+
+
+bool RenderGraphAddPass(RENDERGRAPH* g, const char* pName, unsigned int reads, unsigned int writes,
+	RGPASSFN pfn, void* pContext)
+{
+	if (g->passCount >= RG_PASS_MAX)
+		return false;
+	RGPASS* p = &g->pass[g->passCount++];
+	p->pName = pName;
+	p->reads = reads;
+	p->writes = writes;
+	p->pfn = pfn;
+	p->pContext = pContext;
+	p->culled = false;
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RenderGraphCompile()
+// Desc: A pass survives if it writes something that is needed later; the
+//       imported buffers are needed at the end of the frame. What a
+//       surviving pass reads becomes needed in turn. The passes only ever
+//       add to a buffer (clear, then draw on top), so a write does not end
+//       the need for the earlier writers.
+//-----------------------------------------------------------------------------
+bool RenderGraphCompile(RENDERGRAPH* g)
+{
+	unsigned int needed = 0;
+	for (int i = 0; i < g->resourceCount; i++) {
+		if (g->res[i].imported)
+			needed |= RG_BIT(i);
+		g->res[i].first = g->res[i].last = -1;
+	}
+
+	g->culledCount = 0;
+	for (int i = g->passCount - 1; i >= 0; i--) {
+		RGPASS* p = &g->pass[i];
+		p->culled = (p->writes & needed) == 0;
+		if (p->culled) {
+			g->culledCount++;
+			continue;
+		}
+		needed |= p->reads;
+	}
+
+	//cpX߂
+	for (int i = 0; i < g->passCount; i++) {
+		if (g->pass[i].culled)
+			continue;
+		unsigned int used = g->pass[i].reads | g->pass[i].writes;
+		for (int r = 0; r < g->resourceCount; r++) {
+			if (!(used & RG_BIT(r)))
+				continue;
+			if (g->res[r].first < 0)
+				g->res[r].first = i;
+			g->res[r].last = i;
+		}
+	}
+
+	//傫, ̏dȂ̂ƔȂԒႢʒuɒu
+	int order[RG_RESOURCE_MAX];
+	int count = 0;
+	g->transientBytes = 0;
+	for (int r = 0; r < g->resourceCount; r++) {
+		if (g->res[r].imported || g->res[r].first < 0)
+			continue;
+		int k = count++;
+		while (k > 0 && g->res[order[k - 1]].size < g->res[r].size) {
+			order[k] = order[k - 1];
+			k--;
+		}
+		order[k] = r;
+		g->transientBytes += g->res[r].size;
+	}
+
+	size_t heapUsed = 0;
+	for (int i = 0; i < count; i++) {
+		RGRESOURCE* r = &g->res[order[i]];
+		size_t offset = 0;
+		for (bool moved = true; moved; ) {
+			moved = false;
+			for (int j = 0; j < i; j++) {
+				const RGRESOURCE* o = &g->res[order[j]];
+				if (o->last < r->first || r->last < o->first)
+					continue;
+				if (offset < o->offset + o->size && o->offset < offset + r->size) {
+					offset = o->offset + o->size;
+					moved = true;
+				}
+			}
+		}
+		r->offset = offset;
+		if (offset + r->size > heapUsed)
+			heapUsed = offset + r->size;
+	}
+	g->heapUsed = heapUsed;
+
+	if (heapUsed > g->heapSize) {
+		unsigned char* pHeap = (unsigned char*)malloc(heapUsed);
+		if (pHeap == NULL)
+			return false;
+		RenderGraphFree(g);
+		g->pHeap = pHeap;
+		g->heapSize = heapUsed;
+		MemStatAdd(MEMSYS_FRAMEBUFFER, (long long)heapUsed);
+	}
+	for (int r = 0; r < g->resourceCount; r++) {
+		if (!g->res[r].imported)
+			g->res[r].pMemory = g->res[r].first >= 0 ? g->pHeap + g->res[r].offset : NULL;
+	}
+	return true;
+}
+
+
+
+
+void RenderGraphExecute(RENDERGRAPH* g)
+{
+	for (int i = 0; i < g->passCount; i++) {
+		if (!g->pass[i].culled)
+			g->pass[i].pfn(g, g->pass[i].pContext);
+	}
+}
@@ -0,0 +1,81 @@
+//-----------------------------------------------------------------------------
+// File: RenderGraph.h
+//
+// Desc: A small render graph for the software frame. Each frame declares its
+//       buffers and passes again; a pass names the buffers it reads and
+//       writes. Compiling the graph drops every pass whose writes nobody
+//       needs, and places the transient buffers in one heap so that buffers
+//       whose lifetimes do not overlap share the same memory.
+//
+//       Imported buffers belong to the caller and are the outputs of the
+//       frame. A graph without an output for some stage (YUV, thumbnail)
+//       culls that stage and never allocates its buffers.
+//-----------------------------------------------------------------------------
+#pragma once
+#include <stddef.h>
+
+
+#define RG_PASS_MAX 16
+#define RG_RESOURCE_MAX 16
+#define RG_ALIGN 64
+
+struct RENDERGRAPH;
+typedef void (*RGPASSFN)(RENDERGRAPH* g, void* pContext);
+
+struct RGRESOURCE
+{
+	const char* pName;
+	size_t size;       // oCg (transient ̂)
+	void* pMemory;     // imported ͌Ăяõ, transient  Compile Ō܂
+	bool imported;
+	size_t offset;     // q[v̒̈ʒu
+	int first, last;   // gpX͈̔ (-1 ȂNgȂ)
+};
+
+struct RGPASS
+{
+	const char* pName;
+	unsigned int reads;   // ǂރ\[X̃rbg
+	unsigned int writes;  // \[X̃rbg
+	RGPASSFN pfn;
+	void* pContext;
+	bool culled;
+};
+
+struct RENDERGRAPH
+{
+	RGPASS pass[RG_PASS_MAX];
+	int passCount;
+	RGRESOURCE res[RG_RESOURCE_MAX];
+	int resourceCount;
+
+	unsigned char* pHeap;  // transient ̃ (t[܂Ŏg)
+	size_t heapSize;
+
+	// Ō Compile ̌
+	int culledCount;
+	size_t transientBytes;  // GCAXȂꍇ̍v
+	size_t heapUsed;        // ۂɎgq[v
+};
+
+#define RG_BIT(id) (1u << (id))
+
+
+void RenderGraphInit(RENDERGRAPH* g);
+void RenderGraphFree(RENDERGRAPH* g);
+// t[̐錾n߂ (q[v͎c)
+void RenderGraphReset(RENDERGRAPH* g);
+// \[X̔ԍԂBςȂ -1
+int RenderGraphImport(RENDERGRAPH* g, const char* pName, void* pMemory);
+int RenderGraphCreate(RENDERGRAPH* g, const char* pName, size_t size);
+// ǉɎs
+bool RenderGraphAddPass(RENDERGRAPH* g, const char* pName, unsigned int reads, unsigned int writes,
+	RGPASSFN pfn, void* pContext);
+// pXԈ, transient ̃\[Xq[vɒuBq[vmۂłȂ false
+bool RenderGraphCompile(RENDERGRAPH* g);
+void RenderGraphExecute(RENDERGRAPH* g);
+
+inline void* RenderGraphGet(const RENDERGRAPH* g, int id)
+{
+	return g->res[id].pMemory;
+}
@@ -0,0 +1,160 @@
+//-----------------------------------------------------------------------------
+// File: Scene.cpp
+//
+// Desc: Scene file parser (see Scene.h)
+//-----------------------------------------------------------------------------
+#include "Scene.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+
+#if defined(_MSC_VER)
+#define strtok_r strtok_s
+#endif
+
+
+const char* const g_trackName[TRACK_NUM] =
+{
+	"I1", "I2", "I3", "K1", "K2", "K3", "E1", "E234", "P1", "P2",
+};
+
+const SCENEPARAM g_defaultScene =
+{
+	{
+		//  x      y     end    speed  radius
+		{ -3.0f,  1.5f, -1.9f, 0.5f, 0.0f  },  // I1
+		{ -2.5f,  1.5f, -1.5f, 0.5f, 0.0f  },  // I2
+		{ -3.0f, -1.5f, -1.9f, 0.5f, 0.0f  },  // I3
+		{ -1.3f,  1.5f, -1.7f, 0.5f, 0.0f  },  // K1
+		{ -1.3f,  0.0f,  0.0f, 0.5f, 0.0f  },  // K2
+		{ -1.1f,  0.2f,  0.0f, 0.5f, 0.0f  },  // K3
+		{  0.5f,  1.5f, -1.5f, 0.5f, 0.0f  },  // E1
+		{  0.5f,  1.5f,  1.8f, 0.5f, 0.0f  },  // E234
+		{  2.3f,  1.5f, -1.7f, 0.5f, 0.0f  },  // P1
+		{  2.3f,  0.75f, 0.0f, 0.5f, 0.85f },  // P2
+	},
+	1, 1, 7.0f, -4.0f,
+};
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ReadScene()
+// Desc: Parses the scene file into a copy of pScene, so a half-written or
+//       broken file never leaves a partly updated scene behind. Closes fp.
+//-----------------------------------------------------------------------------
+static bool ReadScene(FILE* fp, SCENEPARAM* pScene)
+{
+	if (fp == NULL)
+		return false;
+
+	SCENEPARAM scene = *pScene;
+	bool ok = true;
+	char line[256];
+	while (ok && fgets(line, sizeof(line), fp) != NULL)
+	{
+		char* pComment = strchr(line, '#');
+		if (pComment != NULL)
+			*pComment = '\0';
+
+		char* pContext;
+		char* pToken = strtok_r(line, " \t\r\n", &pContext);
+		if (pToken == NULL)
+			continue;
+
+		int id = 0;
+		while (id < TRACK_NUM && strcmp(pToken, g_trackName[id]) != 0)
+			id++;
+		bool grid = strcmp(pToken, "grid") == 0;
+		if (id == TRACK_NUM && !grid) {
+			ok = false;
+			break;
+		}
+
+		TRACKPARAM* pTrack = grid ? NULL : &scene.track[id];
+		while ((pToken = strtok_r(NULL, " \t\r\n", &pContext)) != NULL)
+		{
+			char* pValue = strchr(pToken, '=');
+			if (pValue == NULL) {
+				ok = false;
+				break;
+			}
+			*pValue++ = '\0';
+
+			char* pEnd;
+			float value = strtof(pValue, &pEnd);
+			if (pEnd == pValue || *pEnd != '\0' || !isfinite(value)) {
+				ok = false;
+				break;
+			}
+
+			if (grid) {
+				//S̐ 1 ȏ̐
+				bool count = value >= 1 && value <= SCENE_LOGO_MAX && value == floorf(value);
+				if (strcmp(pToken, "cols") == 0 && count)       scene.cols = (int)value;
+				else if (strcmp(pToken, "rows") == 0 && count)  scene.rows = (int)value;
+				else if (strcmp(pToken, "dx") == 0)             scene.dx = value;
+				else if (strcmp(pToken, "dy") == 0)             scene.dy = value;
+				else ok = false;
+			}
+			else if (strcmp(pToken, "x") == 0)       pTrack->x = value;
+			else if (strcmp(pToken, "y") == 0)       pTrack->y = value;
+			else if (strcmp(pToken, "end") == 0)     pTrack->end = value;
+			else if (strcmp(pToken, "speed") == 0)   pTrack->speed = value;
+			else if (strcmp(pToken, "radius") == 0)  pTrack->radius = value;
+			else ok = false;
+		}
+	}
+	fclose(fp);
+
+	if ((long long)scene.cols * scene.rows > SCENE_LOGO_MAX)
+		ok = false;
+	if (ok)
+		*pScene = scene;
+	return ok;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: LoadScene() / LoadSceneUtf8()
+// Desc: Opens the scene file by a wide or a UTF-8 name. A name that does not
+//       fit the conversion buffer is rejected rather than truncated.
+//-----------------------------------------------------------------------------
+bool LoadScene(const wchar_t* pPath, SCENEPARAM* pScene)
+{
+#if defined(_WIN32)
+	FILE* fp;
+	if (_wfopen_s(&fp, pPath, L"r") != 0)
+		fp = NULL;
+#else
+	char path[1024];
+	size_t length = wcstombs(path, pPath, sizeof(path));
+	if (length == (size_t)-1 || length == sizeof(path))
+		return false;
+	FILE* fp = fopen(path, "r");
+#endif
+	return ReadScene(fp, pScene);
+}
+
+
+bool LoadSceneUtf8(const char* pPath, SCENEPARAM* pScene)
+{
+#if defined(_WIN32)
+	//Ȃ 0 Ԃ
+	wchar_t path[1024];
+	if (MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, pPath, -1, path, 1024) == 0)
+		return false;
+	return LoadScene(path, pScene);
+#else
+	//POSIX ̃t@C̓oCgȂ̂ UTF-8 ̂܂܊J
+	return ReadScene(fopen(pPath, "r"), pScene);
+#endif
+}
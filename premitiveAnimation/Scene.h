@@ -0,0 +1,66 @@
+//-----------------------------------------------------------------------------
+// File: Scene.h
+//
+// Desc: Tunable parameters of the cube tracks. Defaults are built in and can
+//       be overridden by a scene file of the form
+//
+//           # name  key=value ...
+//           I1 x=-3 y=1.5 end=-1.9 speed=0.5
+//
+//       Keys that are not given keep their default value. A line
+//
+//           grid cols=40 rows=25 dx=7 dy=-4
+//
+//       repeats the logo cols x rows times, each copy offset by dx to the
+//       right and dy upwards, so one scene can hold hundreds of thousands of
+//       tracks. All copies move with the parameters of the named tracks.
+//-----------------------------------------------------------------------------
+#pragma once
+
+
+enum TRACKID
+{
+	TRACK_I1,
+	TRACK_I2,
+	TRACK_I3,
+	TRACK_K1,
+	TRACK_K2,
+	TRACK_K3,
+	TRACK_E1,
+	TRACK_E234,
+	TRACK_P1,
+	TRACK_P2,
+	TRACK_NUM
+};
+
+struct TRACKPARAM
+{
+	float x, y;    // Jnʒu (P2 ͉~ʂ̒S, E234 ͈ԏ̍s)
+	float end;     // ~W
+	float speed;   // ړx [/s] (P2 ͊px [rad/s])
+	float radius;  // P2 ̉~ʂ̔a
+};
+
+#define SCENE_LOGO_MAX 65536  // grid ŕׂ郍S̐ (gbN͂ TRACK_NUM {)
+
+struct SCENEPARAM
+{
+	TRACKPARAM track[TRACK_NUM];
+	int cols, rows;  // ׂ郍S̐ ( 1 x 1)
+	float dx, dy;    // ׂ̃S܂ł̂
+};
+
+
+extern const char* const g_trackName[TRACK_NUM];
+extern const SCENEPARAM g_defaultScene;
+
+// V[̃gbN̐BgbNԍ̓S̔ԍ * TRACK_NUM + TRACKID
+inline int SceneTrackCount(const SCENEPARAM* pScene)
+{
+	return pScene->cols * pScene->rows * TRACK_NUM;
+}
+
+// ǂ߂Ȃs false Ԃ pScene ͕ύXȂ
+bool LoadScene(const wchar_t* pPath, SCENEPARAM* pScene);
+// pPath  UTF-8 ̂ (P[ɂȂ)
+bool LoadSceneUtf8(const char* pPath, SCENEPARAM* pScene);
@@ -22,6 +22,18 @@
 #pragma warning( disable : 4996 ) // disable deprecated warning 
 #include <strsafe.h>
 #pragma warning( default : 4996 )
+#include <shellapi.h>
+#include <string.h>
+#include <float.h>
+#include "YuvConvert.h"
+#include "FrameSink.h"
+#include "Scene.h"
+#include "MemStats.h"
+#include "AnimSim.h"
+#include "MeshCache.h"
+#include "EventStream.h"
+#include "InputQueue.h"
+#include "AudioMix.h"
 
 
 
@@ -31,24 +43,286 @@
 //-----------------------------------------------------------------------------
 LPDIRECT3D9             g_pD3D = NULL; // Used to create the D3DDevice
 LPDIRECT3DDEVICE9       g_pd3dDevice = NULL; // Our rendering device
-LPDIRECT3DVERTEXBUFFER9 g_pVB = NULL; // Buffer to hold vertices
+LPDIRECT3DVERTEXBUFFER9 g_pVB[MESH_LOD_MAX] = { NULL }; // Buffer to hold vertices (L[u LOD )
 LPDIRECT3DVERTEXBUFFER9 g_pVB2 = NULL; // Buffer to hold vertices
 
+// L[ǔ` (-cubesize, -bevel, -subdiv)B_ MeshCache ؂
+MESHKEY g_cubeKey = DefaultMeshKey(MESH_CUBE);
+const MESH* g_pCubeMesh = NULL;
+const MESH* g_pSquareMesh = NULL;
+
 
 
 									  // A structure for our custom vertex type. We added a normal, and omitted the
 									  // color (which is provided by the material)
 struct CUSTOMVERTEX
 {
-	D3DXVECTOR3 position; // The 3D position for the vertex
+	float x, y, z; // The 3D position for the vertex
 	//D3DXVECTOR3 normal;   // The surface normal for the vertex
 };
 
 // Our custom FVF, which describes our custom vertex structure
 #define D3DFVF_CUSTOMVERTEX (D3DFVF_XYZ|D3DFVF_NORMAL)
 
+// _ MeshCache ̃bV̂܂ܓ]
+static_assert(sizeof(CUSTOMVERTEX) == sizeof(ANIMVERTEX), "vertex layout mismatch");
+
 float g_aspect = 1.6f;
 
+// obNobt@̃^CBÕt[ŕ`^CA
+// `ĂȂ^Cɂ͏܂Ȃ
+#define TILE_W 64
+#define TILE_H 32
+UINT g_bbWidth, g_bbHeight;
+int g_tilesX, g_tilesY;
+BYTE* g_pTileDrawn[2] = { NULL, NULL };  // [g_tileCur] ̃t[
+int g_tileCur = 0;
+D3DRECT* g_pClearRects = NULL;
+bool g_clearAll = true;                  // ̃t[͑Ŝ
+D3DXMATRIXA16 g_matViewProj;
+
+// YUV 4:2:0 Lv` (-yuv ŗL)
+#define YUV_THREAD_MAX 4
+bool g_captureYUV = false;
+LPDIRECT3DSURFACE9 g_pCapture[2] = { NULL, NULL }; // GetRenderTargetData p
+LPDIRECT3DSURFACE9 g_pCaptureLocked = NULL;        // ϊ̖
+int g_captureIndex = 0;
+YUV420FRAME g_yuvFrame;
+void (*g_pfnYUVSink)(const YUV420FRAME*) = NULL;  // ϊIt[̎󂯎
+
+HANDLE g_hYUVThread[YUV_THREAD_MAX];
+HANDLE g_hYUVStart[YUV_THREAD_MAX];
+HANDLE g_hYUVDone = NULL;
+int g_numYUVThreads = 0;
+int* g_pYUVTiles = NULL;  // ϊ^C̔ԍ (ς^C)
+int g_yuvTileCount;
+bool g_yuvConvertAll = true;
+const BYTE* g_yuvSrc;
+int g_yuvPitch;
+volatile LONG g_yuvNextTile;
+volatile LONG g_yuvTilesLeft;
+volatile LONG g_yuvQuit = 0;
+
+// V[t@C (-scene <file>, XVꂽǂݒ)
+WCHAR g_scenePath[MAX_PATH] = L"scene.txt";
+SCENEPARAM* volatile g_pPendingScene = NULL;  // ĎXbhǂݍ񂾃V[
+HANDLE g_hSceneThread = NULL;
+HANDLE g_hSceneQuit = NULL;
+
+// p̃Cxg (-events <file> ŏo, -replay <file> œǂŕ\)
+WCHAR g_eventsPath[MAX_PATH] = L"";
+WCHAR g_replayPath[MAX_PATH] = L"";
+EVENTWRITER* g_pEventWriter = NULL;
+EVENTREADER* g_pEventReader = NULL;
+const EVFRAME* g_pNextEvent = NULL;  // ǂ񂾂܂ɂȂĂȂR[h
+unsigned int g_eventFrame = 0;
+
+// o (-export <file>  I420 ̐f[^o)
+#define EXPORT_INFLIGHT 4
+#define EXPORT_BUFFER_SIZE (8 * 1024 * 1024)
+WCHAR g_exportPath[MAX_PATH] = L"";
+FRAMESINK* g_pFrameSink = NULL;
+bool g_exportFailed = false;
+
+// ItCo (-frames ŌŒXebv, -sharded  NUMA m[hƂɕ)
+#define SHARD_MAX 64
+int g_fps = 60;
+int g_frameFirst = 0;
+int g_frameCount = 0;
+bool g_sharded = false;
+
+// Đx (-speed <x>)BĂV~[V݂͓̍Ȃ̂Ōʂ͕ςȂ
+double g_timeScale = 1.0;
+ANIMTICK g_seekTime = 0;  // -seek <ms>: [v̓rn߂ (ĕ\ʂ̉ʂɍ킹)
+PLAYCONTROL g_play;       // vAj[V̎߂ (ŕς)
+
+//  (Xy[Xňꎞ~,   S Ŏ̒iK, R ōŏ,  őx{Ɣ, 1 œ)B
+// EBhẼXbhtăL[ɓ, V~[Vt[̎钼OɎo
+INPUTQUEUE g_input;
+double g_inputSpeed = 1.0;       // EBhẼXbhŌɑx
+INPUTFRAME g_inputFrame;         // fĂ܂\ĂȂ (pCvĈȂƂ)
+INPUTSTATS g_inputStats;         // ͂ Present ܂
+
+//  (-audio ōĐ, -wav <file> ŏo)Blp`, gbN̒~, S̊ɍ킹Ė炷B
+// Ԃł͎v̎, -frames ̏oł̓t[̎ɕׂ
+#define WAVE_BUFFER_COUNT 8   // waveOut ɓnĂubN (5.3ms )
+#define AUDIO_LATENCY_MS 80   // t[͂܂ł waveOut ̃obt@̕
+bool g_audioOut = false;
+WCHAR g_wavPath[MAX_PATH] = L"";
+AUDIOMIXER* g_pAudio = NULL;
+AUDIOSTATS g_audioStats;       // Ƃ̒l (-stats)
+ULONGLONG g_audioStart;        // ̎Ԏ 0 ̎v
+ULONGLONG g_frameClock;        // t[̎Ƃ̎v
+HWAVEOUT g_hWaveOut = NULL;
+HANDLE g_hWaveDone = NULL;     // waveOut ubNԂ痧
+WAVEHDR g_waveHdr[WAVE_BUFFER_COUNT];
+short g_waveData[WAVE_BUFFER_COUNT][AUDIO_BLOCK * 2];
+int g_waveNext = 0;
+
+// v [ms]B\[NeXg͉z̎vɍւĉCɐi߂
+ULONGLONG TimeGetTime64();
+ULONGLONG (*g_pfnClockMs)() = TimeGetTime64;
+
+// \[NeXg (-soak <hours>)BEBhEo <hours> ԕV~[V,
+// 1 ԂƂ̒x, , lp`̂ -stats ̃t@C (Ȃ soak.txt) ɏ
+#define SOAK_HIST_US 10000   // x̃qXgO (1us , Ō̔ 10ms ȏ)
+#define SOAK_HOURS_MAX 10000
+double g_soakHours = 0;
+ULONGLONG g_soakClock = 0;
+
+// t[̃pCvC (-inflight <n>)Bʂ̃Xbh̃t[V~[V
+// Xbgɒu, `͂ɎoB̊ԂɑÕt[ YUV ɕϊ
+#define PIPE_DEPTH_MAX 8
+int g_pipeDepth = 1;                        // 1 Ȃ Render() ̒ŃV~[V
+ANIMSTATE* g_pPipeSlot = NULL;              // [g_pipeDepth] `҂t[̏
+HANDLE g_hPipeFree = NULL;                  // 󂢂ĂXbg̐ (Z}tH)
+HANDLE g_hPipeReady = NULL;                 // `҂Ăt[̐ (Z}tH)
+HANDLE g_hSimThread = NULL;
+volatile LONG g_pipeQuit = 0;
+volatile LONG g_pipeQueued = 0;
+int g_pipeRead = 0;                         // ɕ`悷Xbg
+long long g_pipeQueuedSum = 0;              // oƂɑ҂Ăt[̍v
+int g_pipeQueuedMax = 0;
+int g_pipeFrames = 0;
+double g_simStallMs = 0;     // Xbg󂩂ɃV~[V҂ (w)
+double g_renderStallMs = 0;  // t[͂ɕ`悪҂
+double g_encodeStallMs = 0;  // Õt[̕ϊI炸ɑ҂
+INPUTFRAME g_pipeInput[PIPE_DEPTH_MAX];  // Xbg̃t[Ŕf
+
+// v (-stats <file> ŏIɏo)
+WCHAR g_statsPath[MAX_PATH] = L"";
+DWORD g_statStart;
+int g_statFrames = 0;
+long long g_deviceBytes = 0;  // obNobt@ Z obt@
+double g_startupMs = 0;       // vZXJnŏ Present ܂
+bool g_startupOnly = false;   // -startup: ŏ̃t[\I
+
+// NUMA (f[^͕`Xbh̃m[hɒu, Xbh͂̃m[h̃RAɌŒ肷)B
+// 64 𒴂_vZbT̓vZbTO[vɕ̂, RA̓O[v̒̔ԍŎ
+#define CPU_MAX 64  // 1 O[ṽvZbT̏
+USHORT g_numaNode = 0;
+GROUP_AFFINITY g_nodeAffinity;  // m[h̃O[v, ̒ŎgRA (Mask  0 ȂŒ肵Ȃ)
+int g_nodeCpu[CPU_MAX];         // m[h̃RAB擪͕`Xbh
+int g_nodeCpuCount = 0;
+
+
+//-----------------------------------------------------------------------------
+// Name: SetNodeAffinity()
+// Desc: Pins a thread to core cpu of the node's group, or to the whole node
+//       when cpu is negative. Does nothing when the node is unknown.
+//-----------------------------------------------------------------------------
+VOID SetNodeAffinity(HANDLE hThread, int cpu)
+{
+	if (g_nodeAffinity.Mask == 0)
+		return;
+	GROUP_AFFINITY affinity = g_nodeAffinity;
+	if (cpu >= 0)
+		affinity.Mask = (KAFFINITY)1 << cpu;
+	SetThreadGroupAffinity(hThread, &affinity, NULL);
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: InitNuma()
+// Desc: Pins the render thread to the core it is running on and collects the
+//       other cores of the same NUMA node for the worker threads. The
+//       processor number and the masks are taken with their processor group,
+//       so a thread in group 1 of a machine with more than 64 logical
+//       processors finds its own node. A sharded export worker is started on
+//       its node by the coordinator.
+//-----------------------------------------------------------------------------
+VOID InitNuma()
+{
+	PROCESSOR_NUMBER processor;
+	GetCurrentProcessorNumberEx(&processor);
+	if (!GetNumaProcessorNodeEx(&processor, &g_numaNode))
+		g_numaNode = 0;
+
+	ZeroMemory(&g_nodeAffinity, sizeof(g_nodeAffinity));
+	if (!GetNumaNodeProcessorMaskEx(g_numaNode, &g_nodeAffinity))
+		return;
+	//vZX 1 ̃O[vɂƂ, ̃}XNӖ (̃O[vȂ 0 Ԃ)
+	DWORD_PTR processMask, systemMask;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) && processMask != 0 &&
+		g_nodeAffinity.Group == processor.Group)
+		g_nodeAffinity.Mask &= processMask;
+
+	//`Xbh̃RA̓m[h̎O[vɂƂ擪ɂ
+	int cpu = g_nodeAffinity.Group == processor.Group ? processor.Number : -1;
+	g_nodeCpuCount = 0;
+	if (cpu >= 0 && (g_nodeAffinity.Mask & ((KAFFINITY)1 << cpu)))
+		g_nodeCpu[g_nodeCpuCount++] = cpu;
+	for (int i = 0; i < CPU_MAX; i++) {
+		if ((g_nodeAffinity.Mask & ((KAFFINITY)1 << i)) && i != cpu)
+			g_nodeCpu[g_nodeCpuCount++] = i;
+	}
+
+	if (g_nodeCpuCount > 0)
+		SetNodeAffinity(GetCurrentThread(), g_nodeCpu[0]);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AllocOnNode() / FreeOnNode()
+// Desc: Zeroed pages on the render thread's node. Falls back to any node when
+//       the node has no free memory.
+//-----------------------------------------------------------------------------
+PVOID AllocOnNode(SIZE_T size)
+{
+	PVOID p = VirtualAllocExNuma(GetCurrentProcess(), NULL, size,
+		MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE, g_numaNode);
+	if (p == NULL)
+		p = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	return p;
+}
+
+VOID FreeOnNode(PVOID p)
+{
+	if (p != NULL)
+		VirtualFree(p, 0, MEM_RELEASE);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: TimeGetTime64()
+// Desc: timeGetTime() wraps around after 49.7 days; the wraps are counted
+//       into the upper half. Called by one thread at a time (the render
+//       thread, or the simulation thread when pipelined).
+//-----------------------------------------------------------------------------
+ULONGLONG TimeGetTime64()
+{
+	static DWORD s_last = 0;
+	static ULONGLONG s_wraps = 0;
+	DWORD now = timeGetTime();
+	if (now < s_last)
+		s_wraps += 0x100000000ULL;
+	s_last = now;
+	return s_wraps | now;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: PipeNowMs()
+// Desc: High resolution clock for the pipeline stall times
+//-----------------------------------------------------------------------------
+double PipeNowMs()
+{
+	static LARGE_INTEGER s_freq;
+	LARGE_INTEGER now;
+	if (s_freq.QuadPart == 0)
+		QueryPerformanceFrequency(&s_freq);
+	QueryPerformanceCounter(&now);
+	return now.QuadPart * 1000.0 / s_freq.QuadPart;
+}
+
+
+
 
 //-----------------------------------------------------------------------------
 // Name: InitD3D()
@@ -65,10 +339,14 @@ HRESULT InitD3D(HWND hWnd)
 	D3DPRESENT_PARAMETERS d3dpp;
 	ZeroMemory(&d3dpp, sizeof(d3dpp));
 	d3dpp.Windowed = TRUE;
-	d3dpp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+	//`ĂȂ^CÕt[̂܂܎c COPY ɂ
+	d3dpp.SwapEffect = D3DSWAPEFFECT_COPY;
 	d3dpp.BackBufferFormat = D3DFMT_UNKNOWN;
 	d3dpp.EnableAutoDepthStencil = TRUE;
 	d3dpp.AutoDepthStencilFormat = D3DFMT_D16;
+	//ôƂ͐҂Ȃ
+	if (g_frameCount > 0)
+		d3dpp.PresentationInterval = D3DPRESENT_INTERVAL_IMMEDIATE;
 
 	// Create the D3DDevice
 	if (FAILED(g_pD3D->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, hWnd,
@@ -77,6 +355,26 @@ HRESULT InitD3D(HWND hWnd)
 	{
 		return E_FAIL;
 	}
+
+	//obNobt@ 32bit Ƃ݂Ȃ
+	LPDIRECT3DSURFACE9 pBackBuffer;
+	if (FAILED(g_pd3dDevice->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &pBackBuffer)))
+		return E_FAIL;
+	D3DSURFACE_DESC desc;
+	pBackBuffer->GetDesc(&desc);
+	pBackBuffer->Release();
+	g_bbWidth = desc.Width;
+	g_bbHeight = desc.Height;
+	g_deviceBytes = (long long)desc.Width * desc.Height * (4 + 2);
+	MemStatAdd(MEMSYS_FRAMEBUFFER, g_deviceBytes);
+
+	g_tilesX = (desc.Width + TILE_W - 1) / TILE_W;
+	g_tilesY = (desc.Height + TILE_H - 1) / TILE_H;
+	for (int i = 0; i < 2; i++)
+		g_pTileDrawn[i] = new BYTE[g_tilesX * g_tilesY]();
+	//1 sɕԋ`͑Ă
+	g_pClearRects = new D3DRECT[g_tilesY * ((g_tilesX + 1) / 2)];
+	MemStatAdd(MEMSYS_FRAMEBUFFER, g_tilesX * g_tilesY * 2 + g_tilesY * ((g_tilesX + 1) / 2) * sizeof(D3DRECT));
 	
 
 	// Turn off culling
@@ -92,80 +390,467 @@ HRESULT InitD3D(HWND hWnd)
 
 
 
+//-----------------------------------------------------------------------------
+// Name: CreateFilledVB()
+// Desc: Creates a vertex buffer holding a prebuilt vertex table
+//-----------------------------------------------------------------------------
+HRESULT CreateFilledVB(const ANIMVERTEX* pData, UINT size, LPDIRECT3DVERTEXBUFFER9* ppVB)
+{
+	// Create the vertex buffer.
+	if (FAILED(g_pd3dDevice->CreateVertexBuffer(size,
+		D3DUSAGE_WRITEONLY, D3DFVF_CUSTOMVERTEX,
+		D3DPOOL_DEFAULT, ppVB, NULL)))
+	{
+		return E_FAIL;
+	}
+	MemStatAdd(MEMSYS_VERTEX, size);
+
+	// Copy the prebuilt vertices in one go.
+	void* pVertices;
+	if (FAILED((*ppVB)->Lock(0, size, &pVertices, 0)))
+		return E_FAIL;
+	memcpy(pVertices, pData, size);
+	(*ppVB)->Unlock();
+
+	return S_OK;
+}
+
+
+
+
 //-----------------------------------------------------------------------------
 // Name: InitGeometry()
 // Desc: Creates the scene geometry
 //-----------------------------------------------------------------------------
 HRESULT InitGeometry()
 {
-	// Create the vertex buffer.
-	if (FAILED(g_pd3dDevice->CreateVertexBuffer(50 * 2 * sizeof(CUSTOMVERTEX),
-		0, D3DFVF_CUSTOMVERTEX,
-		D3DPOOL_DEFAULT, &g_pVB, NULL)))
+	MESHKEY squareKey = { MESH_SQUARE, g_cubeKey.size, 0, 1 };
+	g_pCubeMesh = AcquireMesh(&g_cubeKey);
+	g_pSquareMesh = AcquireMesh(&squareKey);
+	if (g_pCubeMesh == NULL || g_pSquareMesh == NULL)
+		return E_FAIL;
+
+	for (int i = 0; i < g_pCubeMesh->lodCount; i++) {
+		const MESHLOD* pLod = &g_pCubeMesh->lod[i];
+		if (FAILED(CreateFilledVB(pLod->pVertices, pLod->vertexCount * sizeof(ANIMVERTEX), &g_pVB[i])))
+			return E_FAIL;
+	}
+	const MESHLOD* pSquare = &g_pSquareMesh->lod[0];
+	if (FAILED(CreateFilledVB(pSquare->pVertices, pSquare->vertexCount * sizeof(ANIMVERTEX), &g_pVB2)))
+		return E_FAIL;
+
+	return S_OK;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: YUVWorker()
+// Desc: Converts tiles of the captured frame until none are left. The thread
+//       that finishes the last tile hands the frame to the sink.
+//-----------------------------------------------------------------------------
+DWORD WINAPI YUVWorker(LPVOID param)
+{
+	HANDLE hStart = g_hYUVStart[(INT_PTR)param];
+	for (;;)
 	{
+		WaitForSingleObject(hStart, INFINITE);
+		if (g_yuvQuit)
+			break;
+
+		LONG tile;
+		while ((tile = InterlockedIncrement(&g_yuvNextTile) - 1) < g_yuvTileCount) {
+			int x = (g_pYUVTiles[tile] % g_tilesX) * TILE_W;
+			int y = (g_pYUVTiles[tile] / g_tilesX) * TILE_H;
+			int w = min(TILE_W, g_yuvFrame.width - x);
+			int h = min(TILE_H, g_yuvFrame.height - y);
+			ConvertTileToYUV420(g_yuvSrc, g_yuvPitch, x, y, w, h, &g_yuvFrame);
+
+			if (InterlockedDecrement(&g_yuvTilesLeft) == 0) {
+				if (g_pfnYUVSink != NULL)
+					g_pfnYUVSink(&g_yuvFrame);
+				SetEvent(g_hYUVDone);
+			}
+		}
+	}
+	return 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: InitCapture()
+// Desc: Creates the readback surfaces and the conversion threads
+//-----------------------------------------------------------------------------
+HRESULT InitCapture()
+{
+	LPDIRECT3DSURFACE9 pBackBuffer;
+	D3DSURFACE_DESC desc;
+	if (FAILED(g_pd3dDevice->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &pBackBuffer)))
+		return E_FAIL;
+	pBackBuffer->GetDesc(&desc);
+	pBackBuffer->Release();
+
+	//ϊ 32bit  XRGB ̂ݑΉ
+	if (desc.Format != D3DFMT_X8R8G8B8 && desc.Format != D3DFMT_A8R8G8B8)
 		return E_FAIL;
+
+	for (int i = 0; i < 2; i++) {
+		if (FAILED(g_pd3dDevice->CreateOffscreenPlainSurface(desc.Width, desc.Height,
+			desc.Format, D3DPOOL_SYSTEMMEM, &g_pCapture[i], NULL)))
+			return E_FAIL;
+		MemStatAdd(MEMSYS_FRAMEBUFFER, (long long)desc.Width * desc.Height * 4);
+	}
+	if (!AllocYUV420Frame(&g_yuvFrame, desc.Width, desc.Height, g_numaNode))
+		return E_OUTOFMEMORY;
+
+	g_pYUVTiles = new int[g_tilesX * g_tilesY];
+	MemStatAdd(MEMSYS_FRAMEBUFFER, g_tilesX * g_tilesY * sizeof(int));
+	g_yuvConvertAll = true;
+
+	//`Xbh̕cēm[h̃RAϊXbh𗧂Ă
+	int cpus = g_nodeCpuCount;
+	if (cpus == 0) {
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		cpus = (int)si.dwNumberOfProcessors;
+	}
+	g_numYUVThreads = max(1, min(YUV_THREAD_MAX, cpus - 1));
+
+	g_hYUVDone = CreateEvent(NULL, TRUE, TRUE, NULL);
+	for (int i = 0; i < g_numYUVThreads; i++) {
+		g_hYUVStart[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+		g_hYUVThread[i] = CreateThread(NULL, 0, YUVWorker, (LPVOID)(INT_PTR)i, CREATE_SUSPENDED, NULL);
+		//1 RAŒ肷B`Xbh̃RAȂ΃m[hœ
+		SetNodeAffinity(g_hYUVThread[i], g_nodeCpuCount > 1 ? g_nodeCpu[1 + i % (g_nodeCpuCount - 1)] : -1);
+		ResumeThread(g_hYUVThread[i]);
+	}
+
+	return S_OK;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: CaptureFrame()
+// Desc: Reads back the finished frame and starts converting it. Conversion
+//       runs on the worker threads while the next frame is being rendered.
+//       Only tiles that were cleared or drawn (pPrev, pCur) are converted;
+//       the rest of the YUV frame is still valid from the previous frame.
+//-----------------------------------------------------------------------------
+VOID CaptureFrame(const BYTE* pPrev, const BYTE* pCur)
+{
+	int tileCount = g_tilesX * g_tilesY;
+	bool changed = g_yuvConvertAll;
+	for (int i = 0; !changed && i < tileCount; i++)
+		changed = pPrev[i] || pCur[i];
+
+	if (changed) {
+		LPDIRECT3DSURFACE9 pBackBuffer;
+		if (FAILED(g_pd3dDevice->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &pBackBuffer)))
+			return;
+		HRESULT hr = g_pd3dDevice->GetRenderTargetData(pBackBuffer, g_pCapture[g_captureIndex]);
+		pBackBuffer->Release();
+		if (FAILED(hr)) {
+			//肱ڂ^ĈŎ͑Sϊ
+			g_yuvConvertAll = true;
+			return;
+		}
 	}
 
-	// Fill the vertex buffer. We are algorithmically generating a cylinder
-	// here, including the normals, which are used for lighting.
-	CUSTOMVERTEX* pVertices;
-	if (FAILED(g_pVB->Lock(0, 0, (void**)&pVertices, 0)))
+	//Õt[̕ϊI܂ő҂
+	double t0 = PipeNowMs();
+	WaitForSingleObject(g_hYUVDone, INFINITE);
+	g_encodeStallMs += PipeNowMs() - t0;
+	if (g_pCaptureLocked != NULL) {
+		g_pCaptureLocked->UnlockRect();
+		g_pCaptureLocked = NULL;
+	}
+
+	//ʂςĂȂΕϊς݂̃t[̂܂ܓn
+	if (!changed) {
+		if (g_pfnYUVSink != NULL)
+			g_pfnYUVSink(&g_yuvFrame);
+		return;
+	}
+
+	D3DLOCKED_RECT lr;
+	if (FAILED(g_pCapture[g_captureIndex]->LockRect(&lr, NULL, D3DLOCK_READONLY))) {
+		g_yuvConvertAll = true;
+		return;
+	}
+	g_pCaptureLocked = g_pCapture[g_captureIndex];
+	g_yuvSrc = (const BYTE*)lr.pBits;
+	g_yuvPitch = lr.Pitch;
+
+	g_yuvTileCount = 0;
+	for (int i = 0; i < tileCount; i++) {
+		if (g_yuvConvertAll || pPrev[i] || pCur[i])
+			g_pYUVTiles[g_yuvTileCount++] = i;
+	}
+	g_yuvConvertAll = false;
+
+	//c[J[ɏEĂǂ悤ɁA^Cԍ͍Ōɖ߂
+	InterlockedExchange(&g_yuvTilesLeft, g_yuvTileCount);
+	ResetEvent(g_hYUVDone);
+	InterlockedExchange(&g_yuvNextTile, 0);
+	for (int i = 0; i < g_numYUVThreads; i++)
+		SetEvent(g_hYUVStart[i]);
+
+	g_captureIndex = 1 - g_captureIndex;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: WriteYUVToSink()
+// Desc: YUV sink that appends the planes to the export file without padding
+//-----------------------------------------------------------------------------
+VOID WriteYUVToSink(const YUV420FRAME* pFrame)
+{
+	int w = pFrame->width;
+	int h = pFrame->height;
+	for (int j = 0; j < h; j++)
+		WriteFrameSink(g_pFrameSink, pFrame->pY + j * pFrame->pitchY, w);
+	for (int j = 0; j < (h + 1) / 2; j++)
+		WriteFrameSink(g_pFrameSink, pFrame->pU + j * pFrame->pitchUV, (w + 1) / 2);
+	for (int j = 0; j < (h + 1) / 2; j++)
+		WriteFrameSink(g_pFrameSink, pFrame->pV + j * pFrame->pitchUV, (w + 1) / 2);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: InitExport()
+// Desc: Opens the export file and connects it to the YUV capture
+//-----------------------------------------------------------------------------
+HRESULT InitExport()
+{
+	char path[MAX_PATH * 3];
+	WideCharToMultiByte(CP_UTF8, 0, g_exportPath, -1, path, sizeof(path), NULL, NULL);
+	g_pFrameSink = OpenFrameSink(path, EXPORT_INFLIGHT, EXPORT_BUFFER_SIZE, g_numaNode);
+	if (g_pFrameSink == NULL)
 		return E_FAIL;
-	
-	float len = 0.1f;
-	pVertices[0].position = D3DXVECTOR3(-len, -len, -len);
-	pVertices[1].position = D3DXVECTOR3(-len, len, -len);
-	pVertices[2].position = D3DXVECTOR3(len, -len, -len);
-	pVertices[3].position = D3DXVECTOR3(len, len, -len);
-	pVertices[4].position = D3DXVECTOR3(len, -len, len);
-	pVertices[5].position = D3DXVECTOR3(len, len, len);
-	pVertices[6].position = D3DXVECTOR3(-len, -len, len);
-	pVertices[7].position = D3DXVECTOR3(-len, len, len);
-	pVertices[8].position = D3DXVECTOR3(-len, -len, -len);
-	pVertices[9].position = D3DXVECTOR3(-len, len, -len);
-	pVertices[10].position = D3DXVECTOR3(len, len, -len);
-	pVertices[11].position = D3DXVECTOR3(len, len, len);
-	pVertices[12].position = D3DXVECTOR3(-len, len, len);
-	pVertices[13].position = D3DXVECTOR3(-len, len, -len);
-	pVertices[14].position = D3DXVECTOR3(-len, -len, -len);
-	pVertices[15].position = D3DXVECTOR3(len, -len, -len);
-	pVertices[16].position = D3DXVECTOR3(len, -len, len);
-	pVertices[17].position = D3DXVECTOR3(-len, -len, len);
-	pVertices[18].position = D3DXVECTOR3(-len, -len, -len);
-
-	pVertices[19].position = D3DXVECTOR3(-len, -len, 0);
-	pVertices[20].position = D3DXVECTOR3(-len, len, 0);
-	pVertices[21].position = D3DXVECTOR3(len, len, 0);
-	pVertices[22].position = D3DXVECTOR3(len, -len, 0);
-	pVertices[23].position = D3DXVECTOR3(-len, -len, 0);
-	g_pVB->Unlock();
+
+	g_pfnYUVSink = WriteYUVToSink;
+	return S_OK;
+}
 
 
 
 
-	// Create the vertex buffer.
-	if (FAILED(g_pd3dDevice->CreateVertexBuffer(50 * 2 * sizeof(CUSTOMVERTEX),
-		0, D3DFVF_CUSTOMVERTEX,
-		D3DPOOL_DEFAULT, &g_pVB2, NULL)))
+//-----------------------------------------------------------------------------
+// Name: CleanupCapture()
+// Desc: Stops the conversion threads and releases the capture resources
+//-----------------------------------------------------------------------------
+VOID CleanupCapture()
+{
+	if (g_hYUVDone != NULL) {
+		WaitForSingleObject(g_hYUVDone, INFINITE);
+		g_yuvQuit = 1;
+		for (int i = 0; i < g_numYUVThreads; i++)
+			SetEvent(g_hYUVStart[i]);
+		WaitForMultipleObjects(g_numYUVThreads, g_hYUVThread, TRUE, INFINITE);
+		for (int i = 0; i < g_numYUVThreads; i++) {
+			CloseHandle(g_hYUVThread[i]);
+			CloseHandle(g_hYUVStart[i]);
+		}
+		CloseHandle(g_hYUVDone);
+		g_hYUVDone = NULL;
+	}
+
+	if (g_pCaptureLocked != NULL)
+		g_pCaptureLocked->UnlockRect();
+
+	for (int i = 0; i < 2; i++) {
+		if (g_pCapture[i] != NULL) {
+			D3DSURFACE_DESC desc;
+			g_pCapture[i]->GetDesc(&desc);
+			MemStatAdd(MEMSYS_FRAMEBUFFER, -(long long)desc.Width * desc.Height * 4);
+			g_pCapture[i]->Release();
+			g_pCapture[i] = NULL;
+		}
+	}
+
+	FreeYUV420Frame(&g_yuvFrame);
+
+	if (g_pYUVTiles != NULL) {
+		MemStatAdd(MEMSYS_FRAMEBUFFER, -(long long)(g_tilesX * g_tilesY * sizeof(int)));
+		delete[] g_pYUVTiles;
+		g_pYUVTiles = NULL;
+	}
+
+	//Ō̃t[܂ŏIĂ
+	if (g_pFrameSink != NULL) {
+		if (!CloseFrameSink(g_pFrameSink))
+			g_exportFailed = true;
+		g_pFrameSink = NULL;
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: SceneWatcher()
+// Desc: Waits for changes in the directory of the scene file and reloads it.
+//       The new scene is only published; Render() picks it up between frames.
+//-----------------------------------------------------------------------------
+DWORD WINAPI SceneWatcher(LPVOID)
+{
+	WCHAR dir[MAX_PATH];
+	LPWSTR pFilePart;
+	if (GetFullPathNameW(g_scenePath, MAX_PATH, dir, &pFilePart) == 0 || pFilePart == NULL)
+		return 0;
+	*pFilePart = L'\0';
+
+	HANDLE hChange = FindFirstChangeNotification(dir, FALSE,
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+	if (hChange == INVALID_HANDLE_VALUE)
+		return 0;
+
+	HANDLE handles[2] = { hChange, g_hSceneQuit };
+	while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0)
 	{
-		return E_FAIL;
+		//GfB^I܂ŏ҂
+		Sleep(100);
+
+		SCENEPARAM* pScene = new SCENEPARAM(g_defaultScene);
+		MemStatAdd(MEMSYS_CACHE, sizeof(SCENEPARAM));
+		if (LoadScene(g_scenePath, pScene))
+			pScene = (SCENEPARAM*)InterlockedExchangePointer((PVOID volatile*)&g_pPendingScene, pScene);
+		if (pScene != NULL) {
+			MemStatAdd(MEMSYS_CACHE, -(long long)sizeof(SCENEPARAM));
+			delete pScene;
+		}
+
+		FindNextChangeNotification(hChange);
 	}
 
-	// Fill the vertex buffer. We are algorithmically generating a cylinder
-	// here, including the normals, which are used for lighting.
-	CUSTOMVERTEX* pVertices2;
-	if (FAILED(g_pVB2->Lock(0, 0, (void**)&pVertices2, 0)))
+	FindCloseChangeNotification(hChange);
+	return 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: WaveOutWrite()
+// Desc: Called by the mixer thread with each block. Waits until waveOut has
+//       returned the oldest of its buffers, which paces the mixer to the
+//       sound card.
+//-----------------------------------------------------------------------------
+bool WaveOutWrite(void*, const short* pSamples, int frames)
+{
+	WAVEHDR* pHdr = &g_waveHdr[g_waveNext];
+	while (pHdr->dwFlags & WHDR_INQUEUE)
+		WaitForSingleObject(g_hWaveDone, 100);
+	memcpy(pHdr->lpData, pSamples, frames * 4);
+	pHdr->dwBufferLength = frames * 4;
+	if (waveOutWrite(g_hWaveOut, pHdr, sizeof(WAVEHDR)) != MMSYSERR_NOERROR)
+		return false;
+	g_waveNext = (g_waveNext + 1) % WAVE_BUFFER_COUNT;
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: InitAudio()
+// Desc: Opens the -wav file or the sound card for real-time playback
+//-----------------------------------------------------------------------------
+HRESULT InitAudio()
+{
+	if (g_wavPath[0] != L'\0') {
+		char path[MAX_PATH * 3];
+		WideCharToMultiByte(CP_UTF8, 0, g_wavPath, -1, path, sizeof(path), NULL, NULL);
+		g_pAudio = OpenAudioWav(path, AUDIO_RATE);
+		return g_pAudio != NULL ? S_OK : E_FAIL;
+	}
+	if (!g_audioOut)
+		return S_OK;
+
+	WAVEFORMATEX format = { WAVE_FORMAT_PCM, 2, AUDIO_RATE, AUDIO_RATE * 4, 4, 16, 0 };
+	g_hWaveDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (g_hWaveDone == NULL ||
+		waveOutOpen(&g_hWaveOut, WAVE_MAPPER, &format, (DWORD_PTR)g_hWaveDone, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR) {
+		g_hWaveOut = NULL;
 		return E_FAIL;
+	}
+	for (int i = 0; i < WAVE_BUFFER_COUNT; i++) {
+		g_waveHdr[i].lpData = (LPSTR)g_waveData[i];
+		g_waveHdr[i].dwBufferLength = sizeof(g_waveData[i]);
+		g_waveHdr[i].dwFlags = 0;
+		waveOutPrepareHeader(g_hWaveOut, &g_waveHdr[i], sizeof(WAVEHDR));
+	}
+	g_pAudio = OpenAudioStream(WaveOutWrite, NULL, AUDIO_RATE, AUDIO_LATENCY_MS);
+	return g_pAudio != NULL ? S_OK : E_FAIL;
+}
 
-	pVertices2[0].position = D3DXVECTOR3(-len, -len, 0);
-	pVertices2[1].position = D3DXVECTOR3(-len, len, 0);
-	pVertices2[2].position = D3DXVECTOR3(len, len, 0);
-	pVertices2[3].position = D3DXVECTOR3(len, -len, 0);
-	pVertices2[4].position = D3DXVECTOR3(-len, -len, 0);
-	
-	g_pVB2->Unlock();
 
-	return S_OK;
+
+
+//-----------------------------------------------------------------------------
+// Name: CleanupAudio()
+// Desc: Called after the simulation thread has stopped, so no more cues come
+//-----------------------------------------------------------------------------
+VOID CleanupAudio()
+{
+	if (g_pAudio != NULL) {
+		GetAudioStats(g_pAudio, &g_audioStats);
+		CloseAudio(g_pAudio);
+		g_pAudio = NULL;
+	}
+	if (g_hWaveOut != NULL) {
+		waveOutReset(g_hWaveOut);
+		for (int i = 0; i < WAVE_BUFFER_COUNT; i++)
+			waveOutUnprepareHeader(g_hWaveOut, &g_waveHdr[i], sizeof(WAVEHDR));
+		waveOutClose(g_hWaveOut);
+		g_hWaveOut = NULL;
+	}
+	if (g_hWaveDone != NULL) {
+		CloseHandle(g_hWaveDone);
+		g_hWaveDone = NULL;
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: StopPipeline()
+// Desc: Wakes the simulation thread if it waits for a slot and lets it end
+//-----------------------------------------------------------------------------
+VOID StopPipeline()
+{
+	if (g_hSimThread != NULL) {
+		InterlockedExchange(&g_pipeQuit, 1);
+		ReleaseSemaphore(g_hPipeFree, 1, NULL);
+		WaitForSingleObject(g_hSimThread, INFINITE);
+		CloseHandle(g_hSimThread);
+		g_hSimThread = NULL;
+	}
+	if (g_hPipeFree != NULL) {
+		CloseHandle(g_hPipeFree);
+		g_hPipeFree = NULL;
+	}
+	if (g_hPipeReady != NULL) {
+		CloseHandle(g_hPipeReady);
+		g_hPipeReady = NULL;
+	}
+	if (g_pPipeSlot != NULL) {
+		for (int i = 0; i < g_pipeDepth; i++)
+			AnimFree(&g_pPipeSlot[i]);
+		MemStatAdd(MEMSYS_CACHE, -(long long)(g_pipeDepth * sizeof(ANIMSTATE)));
+		FreeOnNode(g_pPipeSlot);
+		g_pPipeSlot = NULL;
+	}
 }
 
 
@@ -177,14 +862,62 @@ HRESULT InitGeometry()
 //-----------------------------------------------------------------------------
 VOID Cleanup()
 {
-	if (g_pVB != NULL)
-		g_pVB->Release();
+	StopPipeline();
+	CleanupAudio();
+	CleanupCapture();
+
+	if (g_pEventWriter != NULL) {
+		CloseEventWriter(g_pEventWriter);
+		g_pEventWriter = NULL;
+	}
+	if (g_pEventReader != NULL) {
+		CloseEventReader(g_pEventReader);
+		g_pEventReader = NULL;
+		g_pNextEvent = NULL;
+	}
+
+	if (g_hSceneThread != NULL) {
+		SetEvent(g_hSceneQuit);
+		WaitForSingleObject(g_hSceneThread, INFINITE);
+		CloseHandle(g_hSceneThread);
+		CloseHandle(g_hSceneQuit);
+		g_hSceneThread = NULL;
+	}
+	if (g_pPendingScene != NULL) {
+		MemStatAdd(MEMSYS_CACHE, -(long long)sizeof(SCENEPARAM));
+		delete g_pPendingScene;
+		g_pPendingScene = NULL;
+	}
 
-	if (g_pVB2 != NULL)
+	for (int i = 0; i < MESH_LOD_MAX; i++) {
+		if (g_pVB[i] != NULL) {
+			MemStatAdd(MEMSYS_VERTEX, -(long long)(g_pCubeMesh->lod[i].vertexCount * sizeof(ANIMVERTEX)));
+			g_pVB[i]->Release();
+			g_pVB[i] = NULL;
+		}
+	}
+
+	if (g_pVB2 != NULL) {
+		MemStatAdd(MEMSYS_VERTEX, -(long long)(g_pSquareMesh->lod[0].vertexCount * sizeof(ANIMVERTEX)));
 		g_pVB2->Release();
+	}
 
-	if (g_pd3dDevice != NULL)
+	ReleaseMesh(g_pCubeMesh);
+	ReleaseMesh(g_pSquareMesh);
+	g_pCubeMesh = g_pSquareMesh = NULL;
+
+	if (g_pd3dDevice != NULL) {
+		MemStatAdd(MEMSYS_FRAMEBUFFER, -g_deviceBytes);
 		g_pd3dDevice->Release();
+	}
+
+	if (g_pClearRects != NULL) {
+		MemStatAdd(MEMSYS_FRAMEBUFFER, -(long long)(g_tilesX * g_tilesY * 2 + g_tilesY * ((g_tilesX + 1) / 2) * sizeof(D3DRECT)));
+		delete[] g_pTileDrawn[0];
+		delete[] g_pTileDrawn[1];
+		delete[] g_pClearRects;
+		g_pClearRects = NULL;
+	}
 
 	if (g_pD3D != NULL)
 		g_pD3D->Release();
@@ -228,6 +961,9 @@ VOID SetupMatrices()
 	//ˉeϊs̐
 	D3DXMatrixPerspectiveFovLH(&matProj, D3DX_PI / 4, g_aspect, 1.0f, 100.0f);
 	g_pd3dDevice->SetTransform(D3DTS_PROJECTION, &matProj);
+
+	//`^C߂̂Ɏg
+	g_matViewProj = matView * matProj;
 	
 }
 
@@ -279,52 +1015,323 @@ VOID SetupLights()
 
 
 
+//-----------------------------------------------------------------------------
+// Name: MsSinceProcessStart()
+// Desc: Time since the process was created, for the startup measurement
+//-----------------------------------------------------------------------------
+double MsSinceProcessStart()
+{
+	FILETIME creation, exitTime, kernel, user, now;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user))
+		return 0;
+	GetSystemTimePreciseAsFileTime(&now);
+
+	ULARGE_INTEGER t0, t1;
+	t0.LowPart = creation.dwLowDateTime;
+	t0.HighPart = creation.dwHighDateTime;
+	t1.LowPart = now.dwLowDateTime;
+	t1.HighPart = now.dwHighDateTime;
+	return (t1.QuadPart - t0.QuadPart) / 10000.0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: MarkDrawn()
+// Desc: Marks the tiles covered by a box of the cube size x cube size x depth in
+//       the current frame's tile mask. The screen rectangle of the eight
+//       corners is used, widened by a pixel for the edge pixels.
+//-----------------------------------------------------------------------------
+VOID MarkDrawn(const D3DXMATRIX* pWorld, float depth)
+{
+	D3DXMATRIXA16 mat = *pWorld * g_matViewProj;
+	float x0 = 1, x1 = -1, y0 = 1, y1 = -1;
+	for (int i = 0; i < 8; i++) {
+		float len = g_cubeKey.size;
+		D3DXVECTOR3 v((i & 1) ? len : -len, (i & 2) ? len : -len, (i & 4) ? depth : -depth);
+		D3DXVECTOR4 p;
+		D3DXVec3Transform(&p, &v, &mat);
+		//J̌ɉ_ΉʑŜƂ݂Ȃ
+		if (p.w <= 0) {
+			x0 = y0 = -1;
+			x1 = y1 = 1;
+			break;
+		}
+		x0 = min(x0, p.x / p.w);
+		x1 = max(x1, p.x / p.w);
+		y0 = min(y0, p.y / p.w);
+		y1 = max(y1, p.y / p.w);
+	}
+	if (x1 < -1 || x0 > 1 || y1 < -1 || y0 > 1)
+		return;
+
+	int px0 = max(0, (int)((x0 + 1) * 0.5f * g_bbWidth) - 1);
+	int px1 = min((int)g_bbWidth - 1, (int)((x1 + 1) * 0.5f * g_bbWidth) + 1);
+	int py0 = max(0, (int)((1 - y1) * 0.5f * g_bbHeight) - 1);
+	int py1 = min((int)g_bbHeight - 1, (int)((1 - y0) * 0.5f * g_bbHeight) + 1);
+
+	BYTE* pDrawn = g_pTileDrawn[g_tileCur];
+	for (int ty = py0 / TILE_H; ty <= py1 / TILE_H; ty++)
+		for (int tx = px0 / TILE_W; tx <= px1 / TILE_W; tx++)
+			pDrawn[ty * g_tilesX + tx] = 1;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ClearDrawnTiles()
+// Desc: Starts a new tile mask and clears only the tiles drawn in the last
+//       frame. Every other tile still holds the clear color and depth from
+//       before, so it is not written again. Runs of tiles in a row are merged
+//       into one rectangle.
+//-----------------------------------------------------------------------------
+VOID ClearDrawnTiles()
+{
+	const BYTE* pPrev = g_pTileDrawn[g_tileCur];
+	g_tileCur = 1 - g_tileCur;
+	ZeroMemory(g_pTileDrawn[g_tileCur], g_tilesX * g_tilesY);
+
+	if (g_clearAll) {
+		g_pd3dDevice->Clear(0, NULL, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER,
+			D3DCOLOR_XRGB(0, 0, 0), 1.0f, 0);
+		g_clearAll = false;
+		return;
+	}
+
+	DWORD count = 0;
+	for (int ty = 0; ty < g_tilesY; ty++) {
+		const BYTE* pRow = pPrev + ty * g_tilesX;
+		for (int tx = 0; tx < g_tilesX; tx++) {
+			if (!pRow[tx])
+				continue;
+			int start = tx;
+			while (tx + 1 < g_tilesX && pRow[tx + 1])
+				tx++;
+			D3DRECT* r = &g_pClearRects[count++];
+			r->x1 = start * TILE_W;
+			r->y1 = ty * TILE_H;
+			r->x2 = min((tx + 1) * TILE_W, (int)g_bbWidth);
+			r->y2 = min((ty + 1) * TILE_H, (int)g_bbHeight);
+		}
+	}
+	if (count > 0)
+		g_pd3dDevice->Clear(count, g_pClearRects, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER,
+			D3DCOLOR_XRGB(0, 0, 0), 1.0f, 0);
+}
+
+
+
+
 //-----------------------------------------------------------------------------
 // Name: Render()
 // Desc: Draws the scene
 //-----------------------------------------------------------------------------
 
 
-float I1 = -3;
-float I2 = 1.5;
-float I3 = -3;
-float K1 = 1.5;
-float k2X = -1.3;
-float k3X = -1.1;
-float k2Y = 0;
-float k3Y = 0.2;
-float e1 = 1.5;
-float e234 = 0.5;
-float p1 = 1.5;
-float p2 = D3DX_PI/2;
-
-float i1_r = 0;
-float i2_r = 0;
-float i3_r = 0;
-float k1_r = 0;
-float k2_r = 0;
-float k3_r = 0;
-float e1_r = 0;
-float e2_r = 0;
-float e3_r = 0;
-float e4_r = 0;
-float p1_r = 0;
-float p2_r = 0;
-
-float pretime;
-int indexMax = 1000;
-float squarePos[1000][3];
-int index = 0;
-bool compFlag[12];
-float endTime;
-bool endGet = false;
+ANIMTICK g_animTime;        // Aj[V̎ [ms]
+ANIMSTATE* g_pAnim = NULL;  // gbN, L[u, ulp` (`Xbh̃m[hɒu)
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ApplyPendingScene()
+// Desc: Swaps in a scene loaded by the watcher thread. Called at the start of
+//       a frame; only tracks whose parameters changed are restarted, and the
+//       stamps that were already placed stay where they are.
+//-----------------------------------------------------------------------------
+VOID ApplyPendingScene()
+{
+	SCENEPARAM* pScene = (SCENEPARAM*)InterlockedExchangePointer((PVOID volatile*)&g_pPendingScene, NULL);
+	if (pScene == NULL)
+		return;
+
+	AnimApplyScene(g_pAnim, pScene);
+	MemStatAdd(MEMSYS_CACHE, -(long long)sizeof(SCENEPARAM));
+	delete pScene;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ReplayEvents()
+// Desc: Replaces the simulation with the records of an event stream. Every
+//       record up to g_animTime is applied; a record from the future is kept
+//       until its time comes. The stream may still be growing, in which case
+//       the frame simply shows the latest record that has arrived.
+//-----------------------------------------------------------------------------
+VOID ReplayEvents()
+{
+	for (;;) {
+		if (g_pNextEvent == NULL)
+			g_pNextEvent = ReadEventFrame(g_pEventReader);
+		if (g_pNextEvent == NULL || EventTime(g_pNextEvent) > g_animTime)
+			break;
+		ApplyEventFrame(g_pAnim, g_pNextEvent);
+		g_pNextEvent = NULL;
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: UpdateScene()
+// Desc: Advances the animation to g_animTime. AnimUpdate sub-steps with a
+//       fixed step, so a long jump (-speed) gives the same state as many
+//       short ones.
+//-----------------------------------------------------------------------------
+VOID UpdateScene()
+{
+	if (g_pEventReader != NULL)
+		ReplayEvents();
+	else {
+		AnimUpdate(g_pAnim, g_animTime);
+		if (g_pEventWriter != NULL)
+			WriteEventFrame(g_pEventWriter, g_pAnim, g_eventFrame++);
+	}
+
+	if (g_pAudio != NULL)
+		ScheduleAudio(g_pAudio, g_pAnim, g_animTime, (double)(g_frameClock - g_audioStart));
+}
+
+
+//-----------------------------------------------------------------------------
+// Name: FrameTime()
+// Desc: Animation time of an export frame. Only depends on the frame number,
+//       so every process computes the same sequence of time steps.
+//-----------------------------------------------------------------------------
+ANIMTICK FrameTime(int frame)
+{
+	return (ANIMTICK)frame * 1000 / g_fps;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: PlayTime()
+// Desc: Animation time of a real time frame, from the (replaceable) clock.
+//       The queued inputs are applied first, so they take effect exactly at
+//       the start of this frame.
+//-----------------------------------------------------------------------------
+ANIMTICK PlayTime(INPUTFRAME* pInput)
+{
+	ULONGLONG clock = g_pfnClockMs();
+	DrainInput(&g_input, &g_play, g_pEventReader == NULL ? g_pAnim : NULL, clock, pInput);
+	g_frameClock = clock;
+	return PlayControlTime(&g_play, clock);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: SimWorker()
+// Desc: Simulates frames ahead of the render thread. Each frame waits for a
+//       free slot, which bounds how far ahead it can get, and the finished
+//       state is copied into the slot. Only the parts Render() draws are
+//       copied. Offline export simulates exactly the exported frames; in real
+//       time each frame takes the clock when its simulation starts.
+//-----------------------------------------------------------------------------
+DWORD WINAPI SimWorker(LPVOID)
+{
+	for (int frame = 0; g_frameCount == 0 || frame < g_frameCount; frame++) {
+		double t0 = PipeNowMs();
+		WaitForSingleObject(g_hPipeFree, INFINITE);
+		g_simStallMs += PipeNowMs() - t0;
+		if (g_pipeQuit)
+			break;
+
+		if (g_frameCount > 0)
+			g_animTime = FrameTime(g_frameFirst + frame);
+		else
+			g_animTime = PlayTime(&g_pipeInput[frame % g_pipeDepth]);
+		ApplyPendingScene();
+		UpdateScene();
+
+		//ʂȂ΂̃t[͉`Ȃ
+		ANIMSTATE* pSlot = &g_pPipeSlot[frame % g_pipeDepth];
+		if (!AnimCopyFrame(pSlot, g_pAnim)) {
+			pSlot->cubeCount = 0;
+			pSlot->stampCount = 0;
+		}
+
+		InterlockedIncrement(&g_pipeQueued);
+		ReleaseSemaphore(g_hPipeReady, 1, NULL);
+	}
+	return 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: StartPipeline()
+// Desc: Starts simulating ahead when -inflight is more than one. Called after
+//       the animation has been seeked to its first frame.
+//-----------------------------------------------------------------------------
+HRESULT StartPipeline()
+{
+	if (g_pipeDepth <= 1)
+		return S_OK;
+
+	g_pPipeSlot = (ANIMSTATE*)AllocOnNode(g_pipeDepth * sizeof(ANIMSTATE));
+	if (g_pPipeSlot == NULL)
+		return E_OUTOFMEMORY;
+	MemStatAdd(MEMSYS_CACHE, g_pipeDepth * sizeof(ANIMSTATE));
+
+	g_hPipeFree = CreateSemaphore(NULL, g_pipeDepth, g_pipeDepth, NULL);
+	g_hPipeReady = CreateSemaphore(NULL, 0, g_pipeDepth, NULL);
+	g_hSimThread = CreateThread(NULL, 0, SimWorker, NULL, CREATE_SUSPENDED, NULL);
+	if (g_hPipeFree == NULL || g_hPipeReady == NULL || g_hSimThread == NULL) {
+		StopPipeline();
+		return E_FAIL;
+	}
+	SetNodeAffinity(g_hSimThread, -1);
+	ResumeThread(g_hSimThread);
+	return S_OK;
+}
+
+
 
 
+//-----------------------------------------------------------------------------
+// Name: Render()
+// Desc: Draws the next frame: the one in the oldest slot of the pipeline, or
+//       without a pipeline the state simulated right here
+//-----------------------------------------------------------------------------
 VOID Render()
 {
-	// Clear the backbuffer and the zbuffer
-	g_pd3dDevice->Clear(0, NULL, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER,
-		D3DCOLOR_XRGB(0, 0, 0), 1.0f, 0);
+	const ANIMSTATE* a = g_pAnim;
+	INPUTFRAME input;
+	if (g_hSimThread != NULL) {
+		double t0 = PipeNowMs();
+		WaitForSingleObject(g_hPipeReady, INFINITE);
+		g_renderStallMs += PipeNowMs() - t0;
+
+		//o_ő҂Ăt[ (̃t[܂)
+		int queued = (int)InterlockedDecrement(&g_pipeQueued) + 1;
+		g_pipeQueuedSum += queued;
+		g_pipeQueuedMax = max(g_pipeQueuedMax, queued);
+		g_pipeFrames++;
+		a = &g_pPipeSlot[g_pipeRead];
+		input = g_pipeInput[g_pipeRead];
+		ZeroMemory(&g_pipeInput[g_pipeRead], sizeof(INPUTFRAME));
+		g_pipeRead = (g_pipeRead + 1) % g_pipeDepth;
+	}
+	else {
+		ApplyPendingScene();
+		UpdateScene();
+		input = g_inputFrame;
+		ZeroMemory(&g_inputFrame, sizeof(INPUTFRAME));
+	}
+
+	// Clear the backbuffer and the zbuffer where the last frame drew
+	ClearDrawnTiles();
 
 
 	// Begin the scene
@@ -340,336 +1347,493 @@ VOID Render()
 		D3DXMATRIXA16 matWorld, moveMat, rotateMat;
 
 
+		const TRACKPARAM* t = a->scene.track;
+
 		g_pd3dDevice->SetStreamSource(0, g_pVB2, 0, sizeof(CUSTOMVERTEX));
 		//ŏ̈ʒu̎lp``
-		D3DXMatrixTranslation(&moveMat, -3, 1.5, 0.0);
+		D3DXMatrixTranslation(&moveMat, t[TRACK_I1].x, t[TRACK_I1].y, 0.0);
 		g_pd3dDevice->SetTransform(D3DTS_WORLD, &moveMat);
-		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 4);
+		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, g_pSquareMesh->lod[0].primCount);
+		MarkDrawn(&moveMat, 0);
 
 		/*
 		D3DXMatrixTranslation(&moveMat, -2.5, 1.5, 0.0);
 		g_pd3dDevice->SetTransform(D3DTS_WORLD, &moveMat);
-		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 4);
+		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, g_pSquareMesh->lod[0].primCount);
 		*/
-		D3DXMatrixTranslation(&moveMat, -3, -1.5, 0.0);
+		D3DXMatrixTranslation(&moveMat, t[TRACK_I3].x, t[TRACK_I3].y, 0.0);
 		g_pd3dDevice->SetTransform(D3DTS_WORLD, &moveMat);
-		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 4);
+		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, g_pSquareMesh->lod[0].primCount);
+		MarkDrawn(&moveMat, 0);
 
-		D3DXMatrixTranslation(&moveMat, -1.3, 1.5, 0.0);
+		D3DXMatrixTranslation(&moveMat, t[TRACK_K1].x, t[TRACK_K1].y, 0.0);
 		g_pd3dDevice->SetTransform(D3DTS_WORLD, &moveMat);
-		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 4);
+		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, g_pSquareMesh->lod[0].primCount);
+		MarkDrawn(&moveMat, 0);
 
 		/*
 		D3DXMatrixTranslation(&moveMat, -1.3, 0, 0.0);
 		g_pd3dDevice->SetTransform(D3DTS_WORLD, &moveMat);
-		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 4);
+		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, g_pSquareMesh->lod[0].primCount);
 		*/
 
-		D3DXMatrixTranslation(&moveMat, 0.5, 1.5, 0.0);
+		D3DXMatrixTranslation(&moveMat, t[TRACK_E1].x, t[TRACK_E1].y, 0.0);
 		g_pd3dDevice->SetTransform(D3DTS_WORLD, &moveMat);
-		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 4);
+		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, g_pSquareMesh->lod[0].primCount);
+		MarkDrawn(&moveMat, 0);
 
 		/*
 		D3DXMatrixTranslation(&moveMat, 0.5, 0, 0.0);
 		g_pd3dDevice->SetTransform(D3DTS_WORLD, &moveMat);
-		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 4);
+		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, g_pSquareMesh->lod[0].primCount);
 
 		D3DXMatrixTranslation(&moveMat, 0.5, -1.5, 0.0);
 		g_pd3dDevice->SetTransform(D3DTS_WORLD, &moveMat);
-		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 4);
+		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, g_pSquareMesh->lod[0].primCount);
 		*/
-		D3DXMatrixTranslation(&moveMat, 2.3, 1.5, 0.0);
+		D3DXMatrixTranslation(&moveMat, t[TRACK_P1].x, t[TRACK_P1].y, 0.0);
 		g_pd3dDevice->SetTransform(D3DTS_WORLD, &moveMat);
-		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 4);
+		g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, g_pSquareMesh->lod[0].primCount);
+		MarkDrawn(&moveMat, 0);
 
-		for (int i = 0; i < index; i++) {
-			D3DXMatrixRotationZ(&rotateMat, squarePos[i][2]);
-			D3DXMatrixTranslation(&moveMat, squarePos[i][0], squarePos[i][1], 0.0);
+		for (int i = 0; i < a->stampCount; i++) {
+			const ANIMSTAMP* pStamp = &a->stamp[i];
+			D3DXMatrixRotationZ(&rotateMat, pStamp->angle);
+			D3DXMatrixTranslation(&moveMat, pStamp->x, pStamp->y, 0.0);
 			matWorld = rotateMat * moveMat;
 			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 4);
+			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, g_pSquareMesh->lod[0].primCount);
+			MarkDrawn(&matWorld, 0);
 		}
 
 
 
 		// Render the vertex buffer contents
-		g_pd3dDevice->SetStreamSource(0, g_pVB, 0, sizeof(CUSTOMVERTEX));
 		g_pd3dDevice->SetFVF(D3DFVF_CUSTOMVERTEX);
 
-
-
-		if (I1 <= -1.9) {
-			D3DXMatrixRotationY(&rotateMat, -(timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, I1, 1.5, 0.0);
-			I1 += 0.5*(float)(timeGetTime() - pretime) / 1000.0;
-			matWorld = rotateMat * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)i1_r +(int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = I1;
-				squarePos[index][1] = 1.5;
-				squarePos[index][2] = 0;
-				index++;
-				i1_r = -(float)(timeGetTime() / 250.0);
+		int lodCur = -1;
+		for (int i = 0; i < a->cubeCount; i++) {
+			const D3DXMATRIX* pWorld = (const D3DXMATRIX*)&a->cube[i];
+			//ʏ̕ɍׂ̌`g
+			D3DXVECTOR3 center(pWorld->m[3][0], pWorld->m[3][1], pWorld->m[3][2]);
+			D3DXVECTOR4 c;
+			D3DXVec3Transform(&c, &center, &g_matViewProj);
+			float pixels = (c.w > 0) ? g_cubeKey.size * g_matViewProj.m[1][1] * g_bbHeight / c.w : 1e9f;
+			int lod = SelectMeshLod(g_pCubeMesh, pixels);
+			if (lod != lodCur) {
+				g_pd3dDevice->SetStreamSource(0, g_pVB[lod], 0, sizeof(CUSTOMVERTEX));
+				lodCur = lod;
 			}
+			g_pd3dDevice->SetTransform(D3DTS_WORLD, pWorld);
+			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, g_pCubeMesh->lod[lod].primCount);
+			MarkDrawn(pWorld, g_cubeKey.size);
 		}
-		else if (!compFlag[0]) { compFlag[0] = true; }
 
-		if (I2 >= -1.5) {
-			D3DXMatrixRotationX(&rotateMat, -(timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, -2.5, I2, 0.0);
-			I2 -= 0.5*(float)(timeGetTime() - pretime) / 1000.0;
-			matWorld = rotateMat * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)i2_r + (int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = -2.5;
-				squarePos[index][1] = I2;
-				squarePos[index][2] = 0;
-				index++;
-				i2_r = -(float)(timeGetTime() / 250.0);
-			}
-		}
-		else if (!compFlag[1]) { compFlag[1] = true; }
+		// End the scene
+		g_pd3dDevice->EndScene();
+	}
 
-		if (I3 <= -1.9) {
-			D3DXMatrixRotationY(&rotateMat, -(timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, I3, -1.5, 0.0);
-			I3 += 0.5*(float)(timeGetTime() - pretime) / 1000.0;
-			matWorld = rotateMat * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)i3_r + (int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = I3;
-				squarePos[index][1] = -1.5;
-				squarePos[index][2] = 0;
-				index++;
-				i3_r = -(float)(timeGetTime() / 250.0);
-			}
-		}
-		else if (!compFlag[2]) { compFlag[2] = true; }
+	if (g_captureYUV)
+		CaptureFrame(g_pTileDrawn[1 - g_tileCur], g_pTileDrawn[g_tileCur]);
 
-		if (K1 >= -1.7) {
-			D3DXMatrixRotationX(&rotateMat, -(timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, -1.3, K1, 0.0);
-			K1 -= 0.5*(float)(timeGetTime() - pretime) / 1000.0;
-			matWorld = rotateMat * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)k1_r + (int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = -1.3;
-				squarePos[index][1] = K1;
-				squarePos[index][2] = 0;
-				index++;
-				k1_r = -(float)(timeGetTime() / 250.0);
-			}
-		}
-		else if (!compFlag[3]) { compFlag[3] = true; }
-
-		D3DXMATRIXA16 rotateMat2;
-		if (k2X <= 0) {
-			D3DXMatrixRotationZ(&rotateMat2, D3DX_PI / 4);
-			D3DXMatrixRotationY(&rotateMat, -(timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, k2X, k2Y, 0.0);
-			k2Y += 0.5*(float)(timeGetTime() - pretime) / (sqrtf(2)*1000.0);
-			k2X += 0.5*(float)(timeGetTime() - pretime) / (sqrtf(2)*1000.0);
-			matWorld = rotateMat * rotateMat2 * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)k2_r + (int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = k2X;
-				squarePos[index][1] = k2Y;
-				squarePos[index][2] = D3DX_PI / 4;
-				index++;
-				k2_r = -(float)(timeGetTime() / 250.0);
-			}
-		}
-		else if (!compFlag[4]) { compFlag[4] = true; }
-
-		if (k3X<=0) {
-			D3DXMatrixRotationZ(&rotateMat2, -D3DX_PI / 3);
-			D3DXMatrixRotationY(&rotateMat, (timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, k3X, k3Y, 0.0);
-			k3Y -= sqrtf(3)*0.5*(float)(timeGetTime() - pretime) / 2000.0;
-			k3X += 0.5*(float)(timeGetTime() - pretime) / 2000.0;
-			matWorld = rotateMat * rotateMat2 * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)k3_r - (int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = k3X;
-				squarePos[index][1] = k3Y;
-				squarePos[index][2] = -D3DX_PI / 3;
-				index++;
-				k3_r = (float)(timeGetTime() / 250.0);
-			}
-		}
-		else if (!compFlag[5]) { compFlag[5] = true; }
+	//̃t[̃Xbg͂ǂ܂Ȃ̂Ŏ̃V~[Vɉ
+	if (g_hSimThread != NULL)
+		ReleaseSemaphore(g_hPipeFree, 1, NULL);
 
-		if (e1 >= -1.5) {
-			D3DXMatrixRotationX(&rotateMat, -(timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, 0.5, e1, 0.0);
-			e1 -= 0.5*(float)(timeGetTime() - pretime) / 1000.0;
-			matWorld = rotateMat * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)e1_r + (int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = 0.5;
-				squarePos[index][1] = e1;
-				squarePos[index][2] = 0;
-				index++;
-				e1_r = -(float)(timeGetTime() / 250.0);
-			}
-		}
-		else if (!compFlag[6]) { compFlag[6] = true; }
+	// Present the backbuffer contents to the display
+	g_pd3dDevice->Present(NULL, NULL, NULL, NULL);
+	RecordInputLatency(&g_inputStats, &input, InputClockUs());
+	if (g_statFrames == 0)
+		g_startupMs = MsSinceProcessStart();
+	g_statFrames++;
+}
 
-		if (e234 <= 1.8) {
-			D3DXMatrixRotationY(&rotateMat, -(timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, e234, 1.5, 0.0);
-			matWorld = rotateMat * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)e2_r + (int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = e234;
-				squarePos[index][1] = 1.5;
-				squarePos[index][2] = 0;
-				index++;
-				e2_r = -(float)(timeGetTime() / 250.0);
-			}
 
 
-			D3DXMatrixRotationY(&rotateMat, -(timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, e234, 0, 0.0);
-			matWorld = rotateMat * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)e3_r + (int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = e234;
-				squarePos[index][1] = 0;
-				squarePos[index][2] = 0;
-				index++;
-				e3_r = -(float)(timeGetTime() / 250.0);
-			}
 
+//-----------------------------------------------------------------------------
+// Name: RunExport()
+// Desc: Renders frames [g_frameFirst, g_frameFirst + g_frameCount) with a
+//       fixed time step. A shard that starts later seeks to its first frame
+//       instead of simulating the frames before it.
+//-----------------------------------------------------------------------------
+VOID RunExport()
+{
+	if (!AnimSeek(g_pAnim, FrameTime(g_frameFirst))) {
+		g_exportFailed = true;
+		return;
+	}
+	if (FAILED(StartPipeline()))
+		g_pipeDepth = 1;
+	for (int i = g_frameFirst; i < g_frameFirst + g_frameCount; i++) {
+		if (g_hSimThread == NULL)
+			g_animTime = FrameTime(i);
+		Render();
+	}
+}
 
-			D3DXMatrixRotationY(&rotateMat, -(timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, e234, -1.5, 0.0);
-			e234 += 0.5*(float)(timeGetTime() - pretime) / 1000.0;
-			matWorld = rotateMat * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)e4_r + (int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = e234;
-				squarePos[index][1] = -1.5;
-				squarePos[index][2] = 0;
-				index++;
-				e4_r = -(float)(timeGetTime() / 250.0);
-			}
-		}
-		else{ compFlag[7] = true; compFlag[8] = true; compFlag[9] = true;}
 
-		if (p1 >= -1.7) {
-			D3DXMatrixRotationX(&rotateMat, -(timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, 2.3, p1, 0.0);
-			p1 -= 0.5*(float)(timeGetTime() - pretime) / 1000.0;
-			matWorld = rotateMat * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)p1_r + (int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = 2.3;
-				squarePos[index][1] = p1;
-				squarePos[index][2] = 0;
-				index++;
-				p1_r = -(float)(timeGetTime() / 250.0);
-			}
-		}
-		else if (!compFlag[10]) { compFlag[10] = true; }
-
-		if (cos(p2)>=-0.01) {
-			D3DXMatrixRotationZ(&rotateMat, p2);
-			D3DXMatrixRotationX(&rotateMat2, -(timeGetTime() / 250.0));
-			D3DXMatrixTranslation(&moveMat, 0.85*cos(p2) + 2.3, 0.85*sin(p2) + 0.75, 0.0);
-			p2 -= 0.5*(float)(timeGetTime() - pretime) / 1000.0;
-			matWorld = rotateMat2 * rotateMat * moveMat;
-			g_pd3dDevice->SetTransform(D3DTS_WORLD, &matWorld);
-			g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 18);
-
-			if (abs((int)p2_r + (int)(timeGetTime() / 250.0)) >= D3DX_PI / 2 && index<indexMax) {
-				squarePos[index][0] = 0.85*cos(p2) + 2.3;
-				squarePos[index][1] = 0.85*sin(p2) + 0.75;
-				squarePos[index][2] = p2;
-				index++;
-				p2_r = -(float)(timeGetTime() / 250.0);
-			}
+
+
+//-----------------------------------------------------------------------------
+// Name: ExportAudio()
+// Desc: Writes the sound of the exported frames to the -wav file. Simulating
+//       is cheap next to drawing, so the frame times are simply run once
+//       more (also for a sharded export, whose workers only draw). The file
+//       starts at the first frame and is as long as the exported video.
+//-----------------------------------------------------------------------------
+bool ExportAudio()
+{
+	char path[MAX_PATH * 3];
+	WideCharToMultiByte(CP_UTF8, 0, g_wavPath, -1, path, sizeof(path), NULL, NULL);
+	AUDIOMIXER* pAudio = OpenAudioWav(path, AUDIO_RATE);
+	if (pAudio == NULL)
+		return false;
+	ANIMSTATE* a = new ANIMSTATE();
+
+	SCENEPARAM scene = g_defaultScene;
+	LoadScene(g_scenePath, &scene);
+	ANIMTICK first = FrameTime(g_frameFirst);
+	if (!AnimInit(a, &scene, 0) || !AnimSeek(a, first)) {
+		CloseAudio(pAudio);
+		AnimFree(a);
+		delete a;
+		return false;
+	}
+	SyncAudio(pAudio, a, first, 0);
+	for (int i = g_frameFirst + 1; i <= g_frameFirst + g_frameCount; i++) {
+		AnimUpdate(a, FrameTime(i));
+		ScheduleAudio(pAudio, a, FrameTime(i), (double)(FrameTime(i) - first));
+	}
+
+	CloseAudio(pAudio);
+	AnimFree(a);
+	delete a;
+	return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ConcatShards()
+// Desc: Joins the shard outputs in timeline order into the export file
+//-----------------------------------------------------------------------------
+bool ConcatShards(WCHAR (*pParts)[MAX_PATH], int count)
+{
+	char path[MAX_PATH * 3];
+	WideCharToMultiByte(CP_UTF8, 0, g_exportPath, -1, path, sizeof(path), NULL, NULL);
+	FRAMESINK* pSink = OpenFrameSink(path, EXPORT_INFLIGHT, EXPORT_BUFFER_SIZE);
+	if (pSink == NULL)
+		return false;
+
+	BYTE* pBuffer = (BYTE*)VirtualAlloc(NULL, EXPORT_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	bool ok = pBuffer != NULL;
+	if (ok)
+		MemStatAdd(MEMSYS_EXPORT, EXPORT_BUFFER_SIZE);
+	for (int i = 0; ok && i < count; i++) {
+		HANDLE hFile = CreateFile(pParts[i], GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (hFile == INVALID_HANDLE_VALUE) {
+			ok = false;
+			break;
 		}
-		else if (!compFlag[11]) { compFlag[11] = true; }
+		DWORD read;
+		while (ok && ReadFile(hFile, pBuffer, EXPORT_BUFFER_SIZE, &read, NULL) && read > 0)
+			ok = WriteFrameSink(pSink, pBuffer, read);
+		CloseHandle(hFile);
+	}
+
+	if (pBuffer != NULL) {
+		MemStatAdd(MEMSYS_EXPORT, -EXPORT_BUFFER_SIZE);
+		VirtualFree(pBuffer, 0, MEM_RELEASE);
+	}
+	return CloseFrameSink(pSink) && ok;
+}
+
 
-		pretime = timeGetTime();
 
 
-		int count = 0;
-		for (int i = 0; i < 12; i++) {
-			if (!compFlag[i]) { break; }
-			else { count++; }
+//-----------------------------------------------------------------------------
+// Name: RunShardedExport()
+// Desc: Coordinator. Splits the timeline into one contiguous shard per NUMA
+//       node, runs each shard in a worker process pinned to that node and
+//       joins the parts. Returns the process exit code.
+//-----------------------------------------------------------------------------
+INT RunShardedExport()
+{
+	ULONG highest = 0;
+	GetNumaHighestNodeNumber(&highest);
+	int nodes = (int)highest + 1;
+	int shards = min(min(nodes, SHARD_MAX), g_frameCount);
+
+	WCHAR exe[MAX_PATH];
+	GetModuleFileName(NULL, exe, MAX_PATH);
+
+	static WCHAR parts[SHARD_MAX][MAX_PATH];
+	PROCESS_INFORMATION pi[SHARD_MAX];
+	int launched = 0;
+	bool ok = true;
+	for (int i = 0; i < shards; i++) {
+		int first = (int)((LONGLONG)g_frameCount * i / shards);
+		int last = (int)((LONGLONG)g_frameCount * (i + 1) / shards);
+		StringCchPrintfW(parts[i], MAX_PATH, L"%s.part%d", g_exportPath, i);
+
+		//GςIvVׂ͂ă[J[ɂn (V[hȂ̏oƓGɂ)
+		WCHAR cmd[MAX_PATH * 5];
+		StringCchPrintfW(cmd, MAX_PATH * 5,
+			L"\"%s\" -export \"%s\" -scene \"%s\" -fps %d -first %d -frames %d -cubesize %.9g -bevel %.9g -subdiv %d%s%s%s",
+			exe, parts[i], g_scenePath, g_fps, g_frameFirst + first, last - first,
+			g_cubeKey.size, g_cubeKey.bevel, g_cubeKey.subdiv,
+			g_replayPath[0] != L'\0' ? L" -replay \"" : L"", g_replayPath, g_replayPath[0] != L'\0' ? L"\"" : L"");
+
+		STARTUPINFOW si;
+		ZeroMemory(&si, sizeof(si));
+		si.cb = sizeof(si);
+		if (!CreateProcess(exe, cmd, NULL, NULL, FALSE, CREATE_SUSPENDED, NULL, NULL, &si, &pi[i])) {
+			ok = false;
+			break;
 		}
-		if (count >= 12) {
-			
-			if (!endGet) { endTime = timeGetTime(); endGet = true; }
-			
-			if ((timeGetTime() - endTime) > 1000 * 5) {
-				I1 = -3;
-				I2 = 1.5;
-				I3 = -3;
-				K1 = 1.5;
-				k2X = -1.3;
-				k3X = -1.1;
-				k2Y = 0;
-				k3Y = 0.2;
-				e1 = 1.5;
-				e234 = 0.5;
-				p1 = 1.5;
-				p2 = D3DX_PI / 2;
-				i1_r = 0;
-				i2_r = 0;
-				i3_r = 0;
-				k1_r = 0;
-				k2_r = 0;
-				k3_r = 0;
-				e1_r = 0;
-				e2_r = 0;
-				e3_r = 0;
-				e4_r = 0;
-				p1_r = 0;
-				p2_r = 0;
-				for (int i = 0; i < 12; i++) {
-					compFlag[i] = false;
-				}
-				for (int i = 0; i < 1000; i++) {
-					squarePos[i][0] = 0;
-					squarePos[i][1] = 0;
-					squarePos[i][2] = 0;
-				}
-				index = 0;
-				endGet = false;
+
+		//[J[̍ŏ̃Xbh̃m[hœB[J[ InitNuma ͂m[h߂
+		//(vZX̃}XN̓O[v 0 ɂȂ̂, O[vtŃXbhɐݒ肷)
+		GROUP_AFFINITY affinity;
+		if (GetNumaNodeProcessorMaskEx((USHORT)(i % nodes), &affinity) && affinity.Mask != 0)
+			SetThreadGroupAffinity(pi[i].hThread, &affinity, NULL);
+		ResumeThread(pi[i].hThread);
+		launched++;
+	}
+
+	for (int i = 0; i < launched; i++) {
+		DWORD code = 1;
+		WaitForSingleObject(pi[i].hProcess, INFINITE);
+		GetExitCodeProcess(pi[i].hProcess, &code);
+		if (code != 0)
+			ok = false;
+		CloseHandle(pi[i].hThread);
+		CloseHandle(pi[i].hProcess);
+	}
+
+	if (ok)
+		ok = ConcatShards(parts, launched);
+	for (int i = 0; i < launched; i++)
+		DeleteFile(parts[i]);
+
+	return ok ? 0 : 1;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: SoakClock()
+//-----------------------------------------------------------------------------
+ULONGLONG SoakClock()
+{
+	return g_soakClock;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: SoakPercentile()
+// Desc: Latency [us] below which the given fraction of the hour's frames lie
+//-----------------------------------------------------------------------------
+int SoakPercentile(const int* pHist, int count, double fraction)
+{
+	long long need = (long long)(count * fraction + 0.5);
+	long long sum = 0;
+	for (int i = 0; i < SOAK_HIST_US; i++) {
+		sum += pHist[i];
+		if (sum >= need && sum > 0)
+			return i;
+	}
+	return SOAK_HIST_US;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: SoakDrift()
+// Desc: Largest difference between the stepped state and the state AnimSeek
+//       rebuilds for the same time from the schedule. Both must agree
+//       exactly however long the animation has been running.
+//-----------------------------------------------------------------------------
+float SoakDrift(ANIMSTATE* pRef)
+{
+	if (!AnimInit(pRef, &g_pAnim->scene, g_pAnim->startTime) || !AnimSeek(pRef, g_pAnim->time))
+		return FLT_MAX;
+
+	float drift = 0;
+	if (pRef->stampCount != g_pAnim->stampCount || pRef->cubeCount != g_pAnim->cubeCount)
+		return FLT_MAX;
+	for (int i = 0; i < g_pAnim->stampCount; i++) {
+		drift = max(drift, fabsf(pRef->stamp[i].x - g_pAnim->stamp[i].x));
+		drift = max(drift, fabsf(pRef->stamp[i].y - g_pAnim->stamp[i].y));
+		drift = max(drift, fabsf(pRef->stamp[i].angle - g_pAnim->stamp[i].angle));
+	}
+	for (int i = 0; i < g_pAnim->cubeCount; i++) {
+		for (int j = 0; j < 16; j++)
+			drift = max(drift, fabsf((&pRef->cube[i].m[0][0])[j] - (&g_pAnim->cube[i].m[0][0])[j]));
+	}
+	return drift;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: RunSoak()
+// Desc: Runs g_soakHours of uptime with a virtual clock at g_fps frames per
+//       second and writes one line per hour: how long UpdateScene took (the
+//       real time, in percentiles), the smallest and largest frame step of
+//       the animation time, the memory in use, and the drift of the stepped
+//       state against AnimSeek, checked whenever the logo is complete.
+//
+//       Unless -seek is given the animation starts so that the run is
+//       centered on 2^32 ms (49.7 days), where a 32-bit time would wrap,
+//       and the virtual clock itself is started just below its own wrap.
+//-----------------------------------------------------------------------------
+INT RunSoak()
+{
+	ULONGLONG span = (ULONGLONG)(g_soakHours * 3600000.0);
+	if (g_seekTime == 0 && span / 2 < 0x100000000ULL)
+		g_seekTime = 0x100000000ULL - span / 2;
+	ULONGLONG clockStart = 0xFFFFFFFFULL - 1000;
+	g_soakClock = clockStart;
+	g_pfnClockMs = SoakClock;
+	InitPlayControl(&g_play, g_seekTime, clockStart, g_timeScale);
+	if (g_pEventReader == NULL && !AnimSeek(g_pAnim, g_seekTime))
+		return 1;
+
+	ANIMSTATE* pRef = (ANIMSTATE*)AllocOnNode(sizeof(ANIMSTATE));
+	if (pRef == NULL)
+		return 1;
+	int* pHist = new int[SOAK_HIST_US + 1];
+
+	static char text[SOAK_HOURS_MAX * 160 + 1024];
+	size_t n = 0;
+	StringCchPrintfA(text, sizeof(text),
+		"soak %.1f h at %d fps, animation time %llu .. %llu ms\n"
+		"hour  frames  p50_us  p99_us  p999_us  max_us  dt_min  dt_max  memory  drift  checks  loops\n",
+		g_soakHours, g_fps, g_seekTime, g_seekTime + (ANIMTICK)(span * g_timeScale));
+
+	long long memStart = -1;
+	float driftMax = 0;
+	bool endGet = g_pAnim->endGet;
+	ULONGLONG frame = 0;
+	for (int hour = 0; (ULONGLONG)hour * 3600000 < span; hour++) {
+		ZeroMemory(pHist, (SOAK_HIST_US + 1) * sizeof(int));
+		int frames = 0, checks = 0, maxUs = 0;
+		unsigned int loops = g_pAnim->loopCount;
+		ANIMTICK dtMin = ~0ULL, dtMax = 0;
+		float drift = 0;
+		ULONGLONG hourEnd = min(span, (ULONGLONG)(hour + 1) * 3600000);
+
+		for (;; frame++) {
+			ULONGLONG elapsed = frame * 1000 / g_fps;
+			if (elapsed >= hourEnd)
+				break;
+			g_soakClock = clockStart + elapsed;
+
+			ANIMTICK prev = g_animTime;
+			double t0 = PipeNowMs();
+			g_animTime = PlayTime(&g_inputFrame);
+			UpdateScene();
+			int us = (int)((PipeNowMs() - t0) * 1000.0);
+			pHist[min(us, SOAK_HIST_US)]++;
+			maxUs = max(maxUs, us);
+			if (frame > 0) {
+				dtMin = min(dtMin, g_animTime - prev);
+				dtMax = max(dtMax, g_animTime - prev);
 			}
+			frames++;
+
+			//SƂ AnimSeek Ɣׂ
+			if (g_pAnim->endGet && !endGet && g_pEventReader == NULL) {
+				drift = max(drift, SoakDrift(pRef));
+				checks++;
+			}
+			endGet = g_pAnim->endGet;
 		}
-		
-		// End the scene
-		g_pd3dDevice->EndScene();
+
+		MEMSTAT stats[MEMSYS_NUM];
+		GetMemStats(stats);
+		long long mem = 0;
+		for (int i = 0; i < MEMSYS_NUM; i++)
+			mem += stats[i].live;
+		if (memStart < 0)
+			memStart = mem;
+		driftMax = max(driftMax, drift);
+
+		n = strlen(text);
+		StringCchPrintfA(text + n, sizeof(text) - n,
+			"%4d  %6d  %6d  %6d  %7d  %6d  %6llu  %6llu  %+6lld  %.3g  %6d  %5u\n",
+			hour, frames, SoakPercentile(pHist, frames, 0.5), SoakPercentile(pHist, frames, 0.99),
+			SoakPercentile(pHist, frames, 0.999), maxUs, dtMin, dtMax, mem - memStart, drift, checks,
+			g_pAnim->loopCount - loops);
 	}
+	n = strlen(text);
+	StringCchPrintfA(text + n, sizeof(text) - n, "\ndrift max %.3g\n\n", driftMax);
+	n = strlen(text);
+	FormatMemStats(text + n, sizeof(text) - n);
+	OutputDebugStringA(text);
+
+	delete[] pHist;
+	AnimFree(pRef);
+	FreeOnNode(pRef);
+
+	HANDLE hFile = CreateFile(g_statsPath[0] != L'\0' ? g_statsPath : L"soak.txt", GENERIC_WRITE, 0, NULL,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return 1;
+	DWORD written;
+	WriteFile(hFile, text, (DWORD)strlen(text), &written, NULL);
+	CloseHandle(hFile);
+	return driftMax == 0 ? 0 : 1;
+}
 
-	// Present the backbuffer contents to the display
-	g_pd3dDevice->Present(NULL, NULL, NULL, NULL);
+
+
+
+//-----------------------------------------------------------------------------
+// Name: WriteStats()
+// Desc: Writes the frame rate and the memory use of each subsystem to the
+//       -stats file and the debugger output
+//-----------------------------------------------------------------------------
+VOID WriteStats()
+{
+	char text[2048];
+	DWORD elapsed = timeGetTime() - g_statStart;
+	StringCchPrintfA(text, sizeof(text),
+		"startup %.2f ms\nframes %d\ntime %lu ms\nfps %.1f\nstamps %d / %d\n\n",
+		g_startupMs, g_statFrames, elapsed, elapsed > 0 ? g_statFrames * 1000.0 / elapsed : 0.0, g_pAnim->stampCount, g_pAnim->stampCapacity);
+	size_t n = strlen(text);
+	StringCchPrintfA(text + n, sizeof(text) - n,
+		"inflight %d\nqueued avg %.2f max %d\nstall sim %.1f ms render %.1f ms encode %.1f ms\n\n",
+		g_pipeDepth, g_pipeFrames > 0 ? (double)g_pipeQueuedSum / g_pipeFrames : 0.0, g_pipeQueuedMax,
+		g_simStallMs, g_renderStallMs, g_encodeStallMs);
+	n = strlen(text);
+	StringCchPrintfA(text + n, sizeof(text) - n,
+		"input %u dropped %u\nlatency avg %.2f ms max %.2f ms\n\n",
+		g_inputStats.count, g_input.dropped.load(),
+		g_inputStats.count > 0 ? g_inputStats.sumUs / 1000.0 / g_inputStats.count : 0.0, g_inputStats.maxUs / 1000.0);
+	n = strlen(text);
+	StringCchPrintfA(text + n, sizeof(text) - n,
+		"audio cues %u late %u dropped %u samples %lld\n\n",
+		g_audioStats.cues, g_audioStats.late, g_audioStats.dropped, g_audioStats.samples);
+	n = strlen(text);
+	FormatMemStats(text + n, sizeof(text) - n);
+	OutputDebugStringA(text);
+
+	HANDLE hFile = CreateFile(g_statsPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return;
+	DWORD written;
+	WriteFile(hFile, text, (DWORD)strlen(text), &written, NULL);
+	CloseHandle(hFile);
 }
 
 
@@ -694,6 +1858,34 @@ LRESULT WINAPI MsgProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		height = (lParam >> 16) & 0xFFFF;
 		g_aspect = width / height;
 		break;
+
+	case WM_KEYDOWN:
+		//ςȂ̌JԂ͖
+		if (lParam & (1 << 30))
+			break;
+		switch (wParam)
+		{
+		case VK_SPACE:
+			PushInput(&g_input, INPUT_PAUSE, 0);
+			return 0;
+		case VK_RIGHT:
+		case 'S':
+			PushInput(&g_input, INPUT_SKIP, 0);
+			return 0;
+		case 'R':
+			PushInput(&g_input, INPUT_RESTART, 0);
+			return 0;
+		case VK_UP:
+		case VK_DOWN:
+		case '1':
+			if (wParam == '1')
+				g_inputSpeed = 1.0;
+			else
+				g_inputSpeed = max(1.0 / INPUT_SPEED_MAX, min(INPUT_SPEED_MAX, g_inputSpeed * (wParam == VK_UP ? 2.0 : 0.5)));
+			PushInput(&g_input, INPUT_SPEED, (float)g_inputSpeed);
+			return 0;
+		}
+		break;
 	}
 
 	return DefWindowProc(hWnd, msg, wParam, lParam);
@@ -708,9 +1900,103 @@ LRESULT WINAPI MsgProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 //-----------------------------------------------------------------------------
 INT WINAPI wWinMain(HINSTANCE hInst, HINSTANCE, LPWSTR, INT)
 {
-	pretime = timeGetTime();
-	for (int i = 0; i<12; i++) {
-		compFlag[i] = false;
+	int argc;
+	LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+	for (int i = 1; i < argc; i++) {
+		if (wcscmp(argv[i], L"-yuv") == 0)
+			g_captureYUV = true;
+		else if (wcscmp(argv[i], L"-export") == 0 && i + 1 < argc) {
+			StringCchCopyW(g_exportPath, MAX_PATH, argv[++i]);
+			g_captureYUV = true;
+		}
+		else if (wcscmp(argv[i], L"-scene") == 0 && i + 1 < argc)
+			StringCchCopyW(g_scenePath, MAX_PATH, argv[++i]);
+		else if (wcscmp(argv[i], L"-fps") == 0 && i + 1 < argc)
+			g_fps = max(1, _wtoi(argv[++i]));
+		else if (wcscmp(argv[i], L"-first") == 0 && i + 1 < argc)
+			g_frameFirst = max(0, _wtoi(argv[++i]));
+		else if (wcscmp(argv[i], L"-frames") == 0 && i + 1 < argc)
+			g_frameCount = max(0, _wtoi(argv[++i]));
+		else if (wcscmp(argv[i], L"-sharded") == 0)
+			g_sharded = true;
+		else if (wcscmp(argv[i], L"-stats") == 0 && i + 1 < argc)
+			StringCchCopyW(g_statsPath, MAX_PATH, argv[++i]);
+		else if (wcscmp(argv[i], L"-startup") == 0)
+			g_startupOnly = true;
+		else if (wcscmp(argv[i], L"-cubesize") == 0 && i + 1 < argc)
+			g_cubeKey.size = max(0.001f, (float)_wtof(argv[++i]));
+		else if (wcscmp(argv[i], L"-bevel") == 0 && i + 1 < argc)
+			g_cubeKey.bevel = max(0.0f, (float)_wtof(argv[++i]));
+		else if (wcscmp(argv[i], L"-subdiv") == 0 && i + 1 < argc)
+			g_cubeKey.subdiv = max(1, min(MESH_SUBDIV_MAX, _wtoi(argv[++i])));
+		else if (wcscmp(argv[i], L"-speed") == 0 && i + 1 < argc)
+			g_timeScale = max(0.0, _wtof(argv[++i]));
+		else if (wcscmp(argv[i], L"-events") == 0 && i + 1 < argc)
+			StringCchCopyW(g_eventsPath, MAX_PATH, argv[++i]);
+		else if (wcscmp(argv[i], L"-replay") == 0 && i + 1 < argc)
+			StringCchCopyW(g_replayPath, MAX_PATH, argv[++i]);
+		else if (wcscmp(argv[i], L"-seek") == 0 && i + 1 < argc)
+			g_seekTime = (ANIMTICK)max(0LL, _wtoi64(argv[++i]));
+		else if (wcscmp(argv[i], L"-soak") == 0 && i + 1 < argc)
+			g_soakHours = max(0.0, min((double)SOAK_HOURS_MAX, _wtof(argv[++i])));
+		else if (wcscmp(argv[i], L"-inflight") == 0 && i + 1 < argc)
+			g_pipeDepth = max(1, min(PIPE_DEPTH_MAX, _wtoi(argv[++i])));
+		else if (wcscmp(argv[i], L"-audio") == 0)
+			g_audioOut = true;
+		else if (wcscmp(argv[i], L"-wav") == 0 && i + 1 < argc)
+			StringCchCopyW(g_wavPath, MAX_PATH, argv[++i]);
+	}
+	LocalFree(argv);
+
+	//ItCo͏o悪Kv
+	if (g_frameCount > 0 && g_exportPath[0] == L'\0')
+		return 1;
+	if (g_frameCount > 0 && g_sharded) {
+		INT result = RunShardedExport();
+		if (result == 0 && g_wavPath[0] != L'\0' && !ExportAudio())
+			result = 1;
+		return result;
+	}
+
+	InitNuma();
+	g_pAnim = (ANIMSTATE*)AllocOnNode(sizeof(ANIMSTATE));
+	if (g_pAnim == NULL)
+		return 1;
+	MemStatAdd(MEMSYS_TRACKS, sizeof(ANIMSTATE));
+
+	//V[t@CΓǂݍŊĎ (o͌ʂςȂ悤ĎȂ)
+	SCENEPARAM scene = g_defaultScene;
+	if (LoadScene(g_scenePath, &scene) && g_frameCount == 0) {
+		g_hSceneQuit = CreateEvent(NULL, TRUE, FALSE, NULL);
+		g_hSceneThread = CreateThread(NULL, 0, SceneWatcher, NULL, 0, NULL);
+		SetNodeAffinity(g_hSceneThread, -1);
+	}
+	if (!AnimInit(g_pAnim, &scene, 0))
+		return 1;
+	InitInputQueue(&g_input);
+
+	//Cxg̏oƍĐ (Đ͎ł̓V~[VȂ)
+	char path[MAX_PATH * 3];
+	if (g_replayPath[0] != L'\0') {
+		WideCharToMultiByte(CP_UTF8, 0, g_replayPath, -1, path, sizeof(path), NULL, NULL);
+		g_pEventReader = OpenEventReader(path);
+		if (g_pEventReader == NULL)
+			return 1;
+	}
+	else if (g_eventsPath[0] != L'\0') {
+		WideCharToMultiByte(CP_UTF8, 0, g_eventsPath, -1, path, sizeof(path), NULL, NULL);
+		g_pEventWriter = OpenEventWriter(path);
+		if (g_pEventWriter == NULL)
+			return 1;
+	}
+
+	if (g_soakHours > 0) {
+		INT result = RunSoak();
+		Cleanup();
+		AnimFree(g_pAnim);
+		MemStatAdd(MEMSYS_TRACKS, -(long long)sizeof(ANIMSTATE));
+		FreeOnNode(g_pAnim);
+		return result;
 	}
 
 	UNREFERENCED_PARAMETER(hInst);
@@ -735,28 +2021,80 @@ INT WINAPI wWinMain(HINSTANCE hInst, HINSTANCE, LPWSTR, INT)
 		// Create the geometry
 		if (SUCCEEDED(InitGeometry()))
 		{
-			// Show the window
-			ShowWindow(hWnd, SW_SHOWDEFAULT);
-			UpdateWindow(hWnd);
-
-			// Enter the message loop
-			MSG msg;
-			ZeroMemory(&msg, sizeof(msg));
-			while (msg.message != WM_QUIT)
+			//Lv`gȂł͕\s
+			if (g_captureYUV && (FAILED(InitCapture()) ||
+				(g_exportPath[0] != L'\0' && FAILED(InitExport()))))
 			{
-				if (PeekMessage(&msg, NULL, 0U, 0U, PM_REMOVE))
-				{
-					TranslateMessage(&msg);
-					DispatchMessage(&msg);
+				CleanupCapture();
+				g_captureYUV = false;
+				g_exportFailed = true;
+			}
+
+			if (g_frameCount > 0)
+			{
+				//ItCo̓EBhE\ɏI
+				g_statStart = timeGetTime();
+				if (g_captureYUV)
+					RunExport();
+				if (g_wavPath[0] != L'\0' && !ExportAudio())
+					g_exportFailed = true;
+				DestroyWindow(hWnd);
+			}
+			else
+			{
+				// Show the window
+				ShowWindow(hWnd, SW_SHOWDEFAULT);
+				UpdateWindow(hWnd);
+
+				// Enter the message loop
+				g_statStart = timeGetTime();
+				InitPlayControl(&g_play, g_seekTime, g_pfnClockMs(), g_timeScale);
+				g_inputSpeed = g_timeScale;
+				if (g_pEventReader == NULL && !AnimSeek(g_pAnim, g_seekTime))
+					DestroyWindow(hWnd);
+				//oȂĂ\͑
+				if (SUCCEEDED(InitAudio()) && g_pAudio != NULL) {
+					g_audioStart = g_pfnClockMs();
+					SyncAudio(g_pAudio, g_pAnim, g_seekTime, 0);
 				}
 				else
-					Render();
+					CleanupAudio();
+				if (FAILED(StartPipeline()))
+					g_pipeDepth = 1;
+				MSG msg;
+				ZeroMemory(&msg, sizeof(msg));
+				while (msg.message != WM_QUIT)
+				{
+					if (PeekMessage(&msg, NULL, 0U, 0U, PM_REMOVE))
+					{
+						TranslateMessage(&msg);
+						DispatchMessage(&msg);
+					}
+					else
+					{
+						if (g_hSimThread == NULL)
+							g_animTime = PlayTime(&g_inputFrame);
+						Render();
+						if (g_startupOnly)
+							DestroyWindow(hWnd);
+					}
+				}
 			}
 		}
+		else
+			g_exportFailed = true;
 	}
+	else
+		g_exportFailed = true;
+
+	if (g_statsPath[0] != L'\0')
+		WriteStats();
 
 	UnregisterClass(L"IKEP_logo", wc.hInstance);
-	return 0;
+	AnimFree(g_pAnim);
+	MemStatAdd(MEMSYS_TRACKS, -(long long)sizeof(ANIMSTATE));
+	FreeOnNode(g_pAnim);
+	return (g_frameCount > 0 && g_exportFailed) ? 1 : 0;
 }
 
 
@@ -0,0 +1,249 @@
+//-----------------------------------------------------------------------------
+// File: YuvConvert.cpp
+//
+// Desc: X8R8G8B8 -> I420 conversion. Full 16-pixel spans of each row pair go
+//       through an AVX2 kernel when the CPU supports it; tile edges, odd rows
+//       and older CPUs use the scalar path, which gives identical results.
+//-----------------------------------------------------------------------------
+#include "YuvConvert.h"
+#include "MemStats.h"
+#include <stdlib.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+
+#if defined(__GNUC__)
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define AVX2_TARGET
+#endif
+
+
+//-----------------------------------------------------------------------------
+// Name: DetectAVX2()
+// Desc: Checks both the CPU feature bit and that the OS saves YMM registers
+//-----------------------------------------------------------------------------
+static bool DetectAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return false;
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+static const bool s_hasAVX2 = DetectAVX2();
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: AllocYUV420Frame() / FreeYUV420Frame()
+// Desc: Planes are allocated as one block with 32 byte aligned rows. On
+//       Windows the block is placed on the given NUMA node; elsewhere the
+//       pages land on the node of the thread that first writes them.
+//-----------------------------------------------------------------------------
+bool AllocYUV420Frame(YUV420FRAME* pFrame, int width, int height, int node)
+{
+	pFrame->width = width;
+	pFrame->height = height;
+	pFrame->pitchY = (width + 31) & ~31;
+	pFrame->pitchUV = ((width + 1) / 2 + 31) & ~31;
+
+	size_t sizeY = (size_t)pFrame->pitchY * height;
+	size_t sizeUV = (size_t)pFrame->pitchUV * ((height + 1) / 2);
+	void* p;
+#if defined(_WIN32)
+	if (node >= 0)
+		p = VirtualAllocExNuma(GetCurrentProcess(), NULL, sizeY + sizeUV * 2,
+			MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE, (DWORD)node);
+	else
+		p = VirtualAlloc(NULL, sizeY + sizeUV * 2, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	(void)node;
+	if (posix_memalign(&p, 32, sizeY + sizeUV * 2) != 0)
+		p = NULL;
+#endif
+	if (p == NULL)
+		return false;
+
+	MemStatAdd(MEMSYS_FRAMEBUFFER, (long long)(sizeY + sizeUV * 2));
+
+	pFrame->pY = (unsigned char*)p;
+	pFrame->pU = pFrame->pY + sizeY;
+	pFrame->pV = pFrame->pU + sizeUV;
+	return true;
+}
+
+void FreeYUV420Frame(YUV420FRAME* pFrame)
+{
+	if (pFrame->pY != NULL) {
+		MemStatAdd(MEMSYS_FRAMEBUFFER, -((long long)pFrame->pitchY * pFrame->height +
+			(long long)pFrame->pitchUV * ((pFrame->height + 1) / 2) * 2));
+#if defined(_WIN32)
+		VirtualFree(pFrame->pY, 0, MEM_RELEASE);
+#else
+		free(pFrame->pY);
+#endif
+	}
+	pFrame->pY = pFrame->pU = pFrame->pV = NULL;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Scalar path (BT.601, 8 bit fixed point)
+//-----------------------------------------------------------------------------
+static inline unsigned char PixelToY(const unsigned char* p)
+{
+	return (unsigned char)(((66 * p[2] + 129 * p[1] + 25 * p[0] + 128) >> 8) + 16);
+}
+
+static void ConvertRegionScalar(const unsigned char* pSrc, int srcPitch,
+	int x0, int y0, int x1, int y1, YUV420FRAME* pDst)
+{
+	for (int j = y0; j < y1; j += 2) {
+		//sE̒[͓fd˂Ďg
+		int j1 = (j + 1 < y1) ? j + 1 : j;
+		const unsigned char* pRow0 = pSrc + j * srcPitch;
+		const unsigned char* pRow1 = pSrc + j1 * srcPitch;
+		unsigned char* pY0 = pDst->pY + j * pDst->pitchY;
+		unsigned char* pY1 = pDst->pY + j1 * pDst->pitchY;
+
+		for (int i = x0; i < x1; i += 2) {
+			int i1 = (i + 1 < x1) ? i + 1 : i;
+			const unsigned char* p00 = pRow0 + i * 4;
+			const unsigned char* p01 = pRow0 + i1 * 4;
+			const unsigned char* p10 = pRow1 + i * 4;
+			const unsigned char* p11 = pRow1 + i1 * 4;
+
+			pY0[i] = PixelToY(p00);
+			pY0[i1] = PixelToY(p01);
+			pY1[i] = PixelToY(p10);
+			pY1[i1] = PixelToY(p11);
+
+			int b = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+			int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+			int r = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+			int uv = (j / 2) * pDst->pitchUV + i / 2;
+			pDst->pU[uv] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			pDst->pV[uv] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// AVX2 path: 16 pixels x 2 rows per iteration
+//-----------------------------------------------------------------------------
+AVX2_TARGET static inline __m128i Luma16AVX2(__m256i p0, __m256i p1, __m256i kY)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i round = _mm256_set1_epi32(128);
+
+	//hadd ŉf̕т̂܂ܕۂ
+	__m256i s0 = _mm256_hadd_epi32(
+		_mm256_madd_epi16(_mm256_unpacklo_epi8(p0, zero), kY),
+		_mm256_madd_epi16(_mm256_unpackhi_epi8(p0, zero), kY));
+	__m256i s1 = _mm256_hadd_epi32(
+		_mm256_madd_epi16(_mm256_unpacklo_epi8(p1, zero), kY),
+		_mm256_madd_epi16(_mm256_unpackhi_epi8(p1, zero), kY));
+	s0 = _mm256_srai_epi32(_mm256_add_epi32(s0, round), 8);
+	s1 = _mm256_srai_epi32(_mm256_add_epi32(s1, round), 8);
+
+	__m256i y16 = _mm256_add_epi16(_mm256_packs_epi32(s0, s1), _mm256_set1_epi16(16));
+	__m256i y8 = _mm256_packus_epi16(y16, y16);
+	y8 = _mm256_permutevar8x32_epi32(y8, _mm256_setr_epi32(0, 4, 1, 5, 0, 0, 0, 0));
+	return _mm256_castsi256_si128(y8);
+}
+
+// 2x2 ubN 4 ̕ (16bit)
+AVX2_TARGET static inline __m256i Average2x2AVX2(__m256i r0, __m256i r1)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(r0, zero), _mm256_unpacklo_epi8(r1, zero));
+	__m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(r0, zero), _mm256_unpackhi_epi8(r1, zero));
+	lo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+	hi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+	__m256i q = _mm256_unpacklo_epi64(lo, hi);
+	return _mm256_srli_epi16(_mm256_add_epi16(q, _mm256_set1_epi16(2)), 2);
+}
+
+AVX2_TARGET static inline void Chroma8AVX2(__m256i qa, __m256i qb, __m256i k, unsigned char* pOut)
+{
+	__m256i m = _mm256_hadd_epi32(_mm256_madd_epi16(qa, k), _mm256_madd_epi16(qb, k));
+	m = _mm256_permutevar8x32_epi32(m, _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7));
+	m = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(m, _mm256_set1_epi32(128)), 8),
+		_mm256_set1_epi32(128));
+	__m128i w = _mm_packs_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+	_mm_storel_epi64((__m128i*)pOut, _mm_packus_epi16(w, w));
+}
+
+AVX2_TARGET static void ConvertRowPairAVX2(const unsigned char* pRow0, const unsigned char* pRow1,
+	unsigned char* pY0, unsigned char* pY1, unsigned char* pU, unsigned char* pV, int count)
+{
+	const __m256i kY = _mm256_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0, 25, 129, 66, 0, 25, 129, 66, 0);
+	const __m256i kU = _mm256_setr_epi16(112, -74, -38, 0, 112, -74, -38, 0, 112, -74, -38, 0, 112, -74, -38, 0);
+	const __m256i kV = _mm256_setr_epi16(-18, -94, 112, 0, -18, -94, 112, 0, -18, -94, 112, 0, -18, -94, 112, 0);
+
+	for (int n = 0; n < count; n++) {
+		__m256i a0 = _mm256_loadu_si256((const __m256i*)(pRow0 + n * 64));
+		__m256i b0 = _mm256_loadu_si256((const __m256i*)(pRow0 + n * 64 + 32));
+		__m256i a1 = _mm256_loadu_si256((const __m256i*)(pRow1 + n * 64));
+		__m256i b1 = _mm256_loadu_si256((const __m256i*)(pRow1 + n * 64 + 32));
+
+		_mm_storeu_si128((__m128i*)(pY0 + n * 16), Luma16AVX2(a0, b0, kY));
+		_mm_storeu_si128((__m128i*)(pY1 + n * 16), Luma16AVX2(a1, b1, kY));
+
+		__m256i qa = Average2x2AVX2(a0, a1);
+		__m256i qb = Average2x2AVX2(b0, b1);
+		Chroma8AVX2(qa, qb, kU, pU + n * 8);
+		Chroma8AVX2(qa, qb, kV, pV + n * 8);
+	}
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: ConvertTileToYUV420()
+// Desc: Converts one tile. pSrc points to the top-left of the whole frame.
+//-----------------------------------------------------------------------------
+void ConvertTileToYUV420(const unsigned char* pSrc, int srcPitch,
+	int x, int y, int w, int h, YUV420FRAME* pDst)
+{
+	int simdW = 0;
+	if (s_hasAVX2 && w >= 16 && h >= 2) {
+		simdW = w & ~15;
+		int rows = h & ~1;
+		for (int j = y; j < y + rows; j += 2) {
+			ConvertRowPairAVX2(pSrc + j * srcPitch + x * 4, pSrc + (j + 1) * srcPitch + x * 4,
+				pDst->pY + j * pDst->pitchY + x, pDst->pY + (j + 1) * pDst->pitchY + x,
+				pDst->pU + (j / 2) * pDst->pitchUV + x / 2, pDst->pV + (j / 2) * pDst->pitchUV + x / 2,
+				simdW / 16);
+		}
+		//̍ŏIs
+		if (rows < h)
+			ConvertRegionScalar(pSrc, srcPitch, x, y + rows, x + simdW, y + h, pDst);
+	}
+	//E[̎c
+	if (simdW < w)
+		ConvertRegionScalar(pSrc, srcPitch, x + simdW, y, x + w, y + h, pDst);
+}
@@ -0,0 +1,29 @@
+//-----------------------------------------------------------------------------
+// File: YuvConvert.h
+//
+// Desc: Color conversion from the X8R8G8B8 framebuffer to planar YUV 4:2:0
+//       (I420, BT.601 limited range) for video encoders. Conversion works on
+//       rectangular tiles so that several threads can share one frame.
+//-----------------------------------------------------------------------------
+#pragma once
+
+
+struct YUV420FRAME
+{
+	unsigned char* pY;
+	unsigned char* pU;
+	unsigned char* pV;
+	int width;
+	int height;
+	int pitchY;
+	int pitchUV;
+};
+
+
+// node ͊mې NUMA m[h (-1 Ȃw肵Ȃ)
+bool AllocYUV420Frame(YUV420FRAME* pFrame, int width, int height, int node = -1);
+void FreeYUV420Frame(YUV420FRAME* pFrame);
+
+// ^C (x, y, w, h) ϊBx  y ͋ł邱
+void ConvertTileToYUV420(const unsigned char* pSrc, int srcPitch,
+	int x, int y, int w, int h, YUV420FRAME* pDst);